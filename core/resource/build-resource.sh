@@ -0,0 +1,13 @@
+cd vkk/core/shaders
+glslangValidator -V -DFORMAT=rgba8   mipmap.comp -o mipmap_rgba8_comp.spv
+glslangValidator -V -DFORMAT=rgba16f mipmap.comp -o mipmap_rgba16f_comp.spv
+glslangValidator -V -DFORMAT=rgba32f mipmap.comp -o mipmap_rgba32f_comp.spv
+glslangValidator -V -DFORMAT=r32f    mipmap.comp -o mipmap_r32f_comp.spv
+cd ../../..
+
+# shaders
+bfs $1 blobSet vkk/core/shaders/mipmap_rgba8_comp.spv
+bfs $1 blobSet vkk/core/shaders/mipmap_rgba16f_comp.spv
+bfs $1 blobSet vkk/core/shaders/mipmap_rgba32f_comp.spv
+bfs $1 blobSet vkk/core/shaders/mipmap_r32f_comp.spv
+rm vkk/core/shaders/*.spv
@@ -92,9 +92,12 @@ vkk_auxImage_newDepth(vkk_engine_t* engine,
 	}
 
 	// memory is uninitialized
+	// depth/MSAA buffers are render targets which should
+	// remain resident under memory pressure
 	self->memory = vkk_memoryManager_allocImage(engine->mm,
 	                                            self->image,
-	                                            1, 1);
+	                                            1, 1,
+	                                            VKK_MEMORY_PRIORITY_HIGH);
 	if(self->memory == NULL)
 	{
 		goto fail_alloc;
@@ -203,9 +206,12 @@ vkk_auxImage_newMSAA(vkk_engine_t* engine,
 	}
 
 	// memory is uninitialized
+	// depth/MSAA buffers are render targets which should
+	// remain resident under memory pressure
 	self->memory = vkk_memoryManager_allocImage(engine->mm,
 	                                            self->image,
-	                                            1, 1);
+	                                            1, 1,
+	                                            VKK_MEMORY_PRIORITY_HIGH);
 	if(self->memory == NULL)
 	{
 		goto fail_alloc;
@@ -71,6 +71,22 @@ vkk_buffer_new(vkk_engine_t* engine,
 	// buf may be NULL
 	ASSERT(engine);
 
+	return vkk_buffer_newPriority(engine, update, usage,
+	                              VKK_MEMORY_PRIORITY_DEFAULT,
+	                              size, buf);
+}
+
+vkk_buffer_t*
+vkk_buffer_newPriority(vkk_engine_t* engine,
+                       vkk_updateMode_e update,
+                       vkk_bufferUsage_e usage,
+                       vkk_memoryPriority_e priority,
+                       size_t size,
+                       const void* buf)
+{
+	// buf may be NULL
+	ASSERT(engine);
+
 	uint32_t count = 1;
 	if(update == VKK_UPDATE_MODE_ASYNCHRONOUS)
 	{
@@ -139,9 +155,46 @@ vkk_buffer_new(vkk_engine_t* engine,
 		               VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 	}
 
+	// small uniform/vertex/index buffers are suballocated
+	// from shared buffers to reduce the number of VkBuffers
+	if((usage != VKK_BUFFER_USAGE_STORAGE) &&
+	   (size > 0) && (size <= VKK_MEMORY_SHARED_SIZE))
+	{
+		self->shared = 1;
+	}
+
+	// uniform buffers and vertex/index buffers which are
+	// updated by the CPU prefer device local host visible
+	// memory to reduce the GPU read latency without a
+	// staging copy
+	vkk_memoryClass_e mclass = VKK_MEMORY_CLASS_UPLOAD;
+	if((usage == VKK_BUFFER_USAGE_UNIFORM) ||
+	   ((usage != VKK_BUFFER_USAGE_STORAGE) &&
+	    (update != VKK_UPDATE_MODE_STATIC)))
+	{
+		mclass = VKK_MEMORY_CLASS_DYNAMIC;
+	}
+
 	int i;
 	for(i = 0; i < count; ++i)
 	{
+		if(self->shared)
+		{
+			// memory is initialized
+			self->memory[i] = vkk_memoryManager_allocShared(engine->mm,
+			                                                mclass,
+			                                                priority,
+			                                                b_info.usage,
+			                                                size, buf);
+			if(self->memory[i] == NULL)
+			{
+				goto fail_alloc;
+			}
+
+			self->buffer[i] = self->memory[i]->chunk->buffer;
+			continue;
+		}
+
 		if(vkCreateBuffer(engine->device, &b_info, NULL,
 		                  &self->buffer[i]) != VK_SUCCESS)
 		{
@@ -154,8 +207,9 @@ vkk_buffer_new(vkk_engine_t* engine,
 			// local memory is uninitialized
 			self->memory[i] = vkk_memoryManager_allocBuffer(engine->mm,
 			                                                self->buffer[i],
-			                                                1, size,
-			                                                NULL);
+			                                                VKK_MEMORY_CLASS_DEVICE,
+			                                                priority,
+			                                                size, NULL, 1);
 			if(self->memory[i] == NULL)
 			{
 				goto fail_alloc;
@@ -168,7 +222,8 @@ vkk_buffer_new(vkk_engine_t* engine,
 				if(vkk_xferManager_blitStorage(engine->xfer,
 				                               VKK_XFER_MODE_WRITE,
 				                               self, 0, size,
-				                               (void*) buf) == 0)
+				                               (void*) buf,
+				                               NULL) == 0)
 				{
 					goto fail_alloc;
 				}
@@ -176,7 +231,8 @@ vkk_buffer_new(vkk_engine_t* engine,
 			else
 			{
 				if(vkk_xferManager_fillStorage(engine->xfer, self,
-				                               0, size, 0) == 0)
+				                               0, size, 0,
+				                               NULL) == 0)
 				{
 					goto fail_alloc;
 				}
@@ -187,8 +243,9 @@ vkk_buffer_new(vkk_engine_t* engine,
 			// memory is initialized
 			self->memory[i] = vkk_memoryManager_allocBuffer(engine->mm,
 			                                                self->buffer[i],
-			                                                0, size,
-			                                                buf);
+			                                                mclass,
+			                                                priority,
+			                                                size, buf, 1);
 			if(self->memory[i] == NULL)
 			{
 				goto fail_alloc;
@@ -207,9 +264,12 @@ vkk_buffer_new(vkk_engine_t* engine,
 		for(j = 0; j <= i; ++j)
 		{
 			vkk_memoryManager_free(engine->mm, &self->memory[j]);
-			vkDestroyBuffer(engine->device,
-			                self->buffer[j],
-			                NULL);
+			if(self->shared == 0)
+			{
+				vkDestroyBuffer(engine->device,
+				                self->buffer[j],
+				                NULL);
+			}
 		}
 		FREE(self->memory);
 	}
@@ -238,7 +298,20 @@ vkk_memoryType_e vkk_buffer_memoryType(vkk_buffer_t* self)
 {
 	ASSERT(self);
 
-	return self->memory[0]->chunk->pool->type;
+	return self->memory[0]->chunk->type;
+}
+
+VkDeviceSize vkk_buffer_offset(vkk_buffer_t* self,
+                               uint32_t idx)
+{
+	ASSERT(self);
+
+	if(self->shared)
+	{
+		return self->memory[idx]->offset;
+	}
+
+	return 0;
 }
 
 size_t vkk_buffer_size(vkk_buffer_t* self)
@@ -258,7 +331,24 @@ int vkk_buffer_fillStorage(vkk_buffer_t* self,
 	vkk_engine_t* engine = self->engine;
 
 	return vkk_xferManager_fillStorage(engine->xfer, self,
-	                                   offset, size, data);
+	                                   offset, size, data,
+	                                   NULL);
+}
+
+int vkk_buffer_fillStorageAsync(vkk_buffer_t* self,
+                                size_t offset,
+                                size_t size,
+                                uint32_t data,
+                                uint64_t* _ticket)
+{
+	ASSERT(vkk_buffer_checkStorage(self));
+	ASSERT(_ticket);
+
+	vkk_engine_t* engine = self->engine;
+
+	return vkk_xferManager_fillStorage(engine->xfer, self,
+	                                   offset, size, data,
+	                                   _ticket);
 }
 
 int vkk_buffer_copyStorage(vkk_buffer_t* src,
@@ -290,7 +380,7 @@ vkk_buffer_readStorage(vkk_buffer_t* self,
 	return vkk_xferManager_blitStorage(engine->xfer,
 	                                   VKK_XFER_MODE_READ,
 	                                   self, offset, size,
-	                                   data);
+	                                   data, NULL);
 }
 
 int
@@ -307,5 +397,24 @@ vkk_buffer_writeStorage(vkk_buffer_t* self,
 	return vkk_xferManager_blitStorage(engine->xfer,
 	                                   VKK_XFER_MODE_WRITE,
 	                                   self, offset, size,
-	                                   (void*) data);
+	                                   (void*) data, NULL);
+}
+
+int
+vkk_buffer_writeStorageAsync(vkk_buffer_t* self,
+                             size_t offset, size_t size,
+                             const void* data,
+                             uint64_t* _ticket)
+{
+	ASSERT(vkk_buffer_checkStorage(self));
+	ASSERT(data);
+	ASSERT(_ticket);
+
+	vkk_engine_t* engine = self->engine;
+
+	// cast away const since blitStorage is read/write
+	return vkk_xferManager_blitStorage(engine->xfer,
+	                                   VKK_XFER_MODE_WRITE,
+	                                   self, offset, size,
+	                                   (void*) data, _ticket);
 }
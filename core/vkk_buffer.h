@@ -39,6 +39,17 @@ typedef struct vkk_buffer_s
 	size_t            size;
 	VkBuffer*         buffer;
 	vkk_memory_t**    memory;
+
+	// shared buffers are suballocated from a VkBuffer
+	// owned by the memory chunk at the memory offset
+	int shared;
+
+	// pending async xfer ticket (or zero)
+	uint64_t xfer_ticket;
 } vkk_buffer_t;
 
+// protected
+VkDeviceSize vkk_buffer_offset(vkk_buffer_t* self,
+                               uint32_t idx);
+
 #endif
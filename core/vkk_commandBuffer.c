@@ -42,6 +42,19 @@ vkk_commandBuffer_new(vkk_engine_t* engine,
 {
 	ASSERT(engine);
 
+	return vkk_commandBuffer_newFamily(engine, cb_count,
+	                                   secondary,
+	                                   engine->queue_family_index);
+}
+
+vkk_commandBuffer_t*
+vkk_commandBuffer_newFamily(vkk_engine_t* engine,
+                            uint32_t cb_count,
+                            int secondary,
+                            uint32_t queue_family_index)
+{
+	ASSERT(engine);
+
 	vkk_commandBuffer_t* self;
 	self = (vkk_commandBuffer_t*)
 	       CALLOC(1, sizeof(vkk_commandBuffer_t));
@@ -68,7 +81,7 @@ vkk_commandBuffer_new(vkk_engine_t* engine,
 		.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
 		.pNext            = NULL,
 		.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-		.queueFamilyIndex = engine->queue_family_index
+		.queueFamilyIndex = queue_family_index
 	};
 
 	if(vkCreateCommandPool(engine->device, &cpc_info, NULL,
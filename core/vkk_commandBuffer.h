@@ -42,6 +42,10 @@ typedef struct vkk_commandBuffer_s
 vkk_commandBuffer_t* vkk_commandBuffer_new(vkk_engine_t* engine,
                                            uint32_t cb_count,
                                            int secondary);
+vkk_commandBuffer_t* vkk_commandBuffer_newFamily(vkk_engine_t* engine,
+                                                 uint32_t cb_count,
+                                                 int secondary,
+                                                 uint32_t queue_family_index);
 void                 vkk_commandBuffer_delete(vkk_commandBuffer_t** _self);
 VkCommandBuffer      vkk_commandBuffer_get(vkk_commandBuffer_t* self,
                                            uint32_t index);
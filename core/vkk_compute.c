@@ -32,6 +32,7 @@
 #include "vkk_computePipeline.h"
 #include "vkk_compute.h"
 #include "vkk_engine.h"
+#include "vkk_image.h"
 #include "vkk_pipelineLayout.h"
 #include "vkk_uniformSetFactory.h"
 #include "vkk_uniformSet.h"
@@ -65,7 +66,7 @@ vkk_compute_updateUniformBufferRef(vkk_compute_t* self,
 	VkDescriptorBufferInfo db_info =
 	{
 		.buffer  = ua->buffer->buffer[0],
-		.offset  = 0,
+		.offset  = vkk_buffer_offset(ua->buffer, 0),
 		.range   = ua->buffer->size
 	};
 
@@ -396,6 +397,8 @@ void vkk_compute_bindUniformSets(vkk_compute_t* self,
 	ASSERT(self->cp);
 	ASSERT(us_array);
 
+	vkk_engine_t* engine = self->engine;
+
 	double ts = vkk_compute_tsCurrent(self);
 
 	if(us_count > VKK_ENGINE_MAX_USF_COUNT)
@@ -419,6 +422,24 @@ void vkk_compute_bindUniformSets(vkk_compute_t* self,
 			vkk_uniformAttachment_t* ua;
 			ua = &(us_array[i]->ua_array[j]);
 
+			// wait for pending async xfers on first use
+			if(((ua->type == VKK_UNIFORM_TYPE_STORAGE)    ||
+			    (ua->type == VKK_UNIFORM_TYPE_STORAGE_REF)) &&
+			   ua->buffer->xfer_ticket)
+			{
+				vkk_xferManager_wait(engine->xfer,
+				                     ua->buffer->xfer_ticket);
+				ua->buffer->xfer_ticket = 0;
+			}
+			else if(((ua->type == VKK_UNIFORM_TYPE_IMAGE) ||
+			         (ua->type == VKK_UNIFORM_TYPE_IMAGE_REF)) &&
+			        ua->image->xfer_ticket)
+			{
+				vkk_xferManager_wait(engine->xfer,
+				                     ua->image->xfer_ticket);
+				ua->image->xfer_ticket = 0;
+			}
+
 			if(ts != 0.0)
 			{
 				if((ua->type == VKK_UNIFORM_TYPE_BUFFER)     ||
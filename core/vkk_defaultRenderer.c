@@ -1336,6 +1336,9 @@ void vkk_defaultRenderer_end(vkk_renderer_t* base)
 
 	vkk_engine_t* engine = base->engine;
 
+	// submit the batched uploads once per frame
+	vkk_xferManager_flush(engine->xfer);
+
 	VkSemaphore semaphore_acquire;
 	VkSemaphore semaphore_submit;
 	vkk_defaultRenderer_endSemaphore(base,
@@ -1347,6 +1350,11 @@ void vkk_defaultRenderer_end(vkk_renderer_t* base)
 	cb = vkk_commandBuffer_get(self->cmd_buffers,
 	                           self->swapchain_frame);
 	vkCmdEndRenderPass(cb);
+
+	// record the async readbacks after the frame has
+	// rendered the images
+	double ts = self->ts_array[self->swapchain_frame];
+	vkk_xferManager_recordReadbacks(engine->xfer, cb, ts);
 	vkEndCommandBuffer(cb);
 
 	VkFence sc_fence;
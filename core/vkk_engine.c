@@ -21,6 +21,7 @@
  *
  */
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -43,6 +44,7 @@
 #include "vkk_imageStreamRenderer.h"
 #include "vkk_image.h"
 #include "vkk_memoryManager.h"
+#include "vkk_mipmapPipeline.h"
 #include "vkk_pipelineLayout.h"
 #include "vkk_secondaryRenderer.h"
 #include "vkk_uniformSet.h"
@@ -53,6 +55,72 @@
 * private                                                  *
 ***********************************************************/
 
+static int
+vkk_engine_hasInstanceExtensions(uint32_t count,
+                                 const char** names)
+{
+	ASSERT(count > 0);
+	ASSERT(names);
+
+	uint32_t pCount = 0;
+	if(vkEnumerateInstanceExtensionProperties(NULL, &pCount,
+	                                          NULL) != VK_SUCCESS)
+	{
+		LOGE("vkEnumerateInstanceExtensionProperties failed");
+		return 0;
+	}
+
+	VkExtensionProperties* properties;
+	properties = (VkExtensionProperties*)
+	             CALLOC(pCount, sizeof(VkExtensionProperties));
+	if(properties == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	if(vkEnumerateInstanceExtensionProperties(NULL, &pCount,
+	                                          properties) != VK_SUCCESS)
+	{
+		LOGE("vkEnumerateInstanceExtensionProperties failed");
+		goto fail_properties;
+	}
+
+	// check for enabled extensions
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		int found = 0;
+		int j;
+		for(j = 0; j < pCount; ++j)
+		{
+			if(strcmp(names[i],
+			          properties[j].extensionName) == 0)
+			{
+				found = 1;
+				break;
+			}
+		}
+
+		if(found == 0)
+		{
+			LOGW("%s not found", names[i]);
+			goto fail_enabled;
+		}
+	}
+
+	FREE(properties);
+
+	// success
+	return 1;
+
+	// failure
+	fail_enabled:
+	fail_properties:
+		FREE(properties);
+	return 0;
+}
+
 static int
 vkk_engine_hasDeviceExtensions(vkk_engine_t* self,
                                uint32_t count,
@@ -104,7 +172,7 @@ vkk_engine_hasDeviceExtensions(vkk_engine_t* self,
 
 		if(found == 0)
 		{
-			LOGE("%s not found", names[i]);
+			LOGW("%s not found", names[i]);
 			goto fail_enabled;
 		}
 	}
@@ -236,8 +304,8 @@ vkk_engine_newInstance(vkk_engine_t* self,
 	ASSERT(app_name);
 	ASSERT(app_version);
 
-	uint32_t    extension_count   = 2;
-	const char* extension_names[] =
+	uint32_t    extension_count    = 2;
+	const char* extension_names[3] =
 	{
 		"VK_KHR_surface",
 		#ifdef ANDROID
@@ -247,6 +315,19 @@ vkk_engine_newInstance(vkk_engine_t* self,
 		#endif
 	};
 
+	// optional physical device properties extension which
+	// is required to query the memory budget
+	const char* properties2_names[] =
+	{
+		VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
+	};
+
+	if(vkk_engine_hasInstanceExtensions(1, properties2_names))
+	{
+		extension_names[extension_count++] = properties2_names[0];
+		self->has_physical_device_properties2 = 1;
+	}
+
 	uint32_t av = VK_MAKE_VERSION(app_version->major,
 	                              app_version->minor,
 	                              app_version->patch);
@@ -395,6 +476,11 @@ static int vkk_engine_getPhysicalDevice(vkk_engine_t* self)
 		self->max_anisotropy = pdp.limits.maxSamplerAnisotropy;
 	}
 
+	// query block-compressed texture formats
+	self->texture_compression_bc   = pdf.textureCompressionBC;
+	self->texture_compression_etc2 = pdf.textureCompressionETC2;
+	self->texture_compression_astc = pdf.textureCompressionASTC_LDR;
+
 	// query MSAA sample count
 	VkSampleCountFlags scf;
 	scf = pdp.limits.framebufferColorSampleCounts &
@@ -416,7 +502,7 @@ static int vkk_engine_newDevice(vkk_engine_t* self)
 	ASSERT(self);
 
 	uint32_t    extension_count   = 1;
-	const char* extension_names[] =
+	const char* extension_names[5] =
 	{
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
@@ -428,6 +514,78 @@ static int vkk_engine_newDevice(vkk_engine_t* self)
 		return 0;
 	}
 
+	// optional dedicated allocation extensions
+	const char* dedicated_names[] =
+	{
+		VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+		VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME
+	};
+
+	if(vkk_engine_hasDeviceExtensions(self, 2,
+	                                  dedicated_names))
+	{
+		extension_names[extension_count++] = dedicated_names[0];
+		extension_names[extension_count++] = dedicated_names[1];
+		self->has_dedicated_allocation = 1;
+	}
+
+	// optional memory budget extension
+	const char* budget_names[] =
+	{
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+	};
+
+	if(self->has_physical_device_properties2 &&
+	   vkk_engine_hasDeviceExtensions(self, 1, budget_names))
+	{
+		extension_names[extension_count++] = budget_names[0];
+		self->has_memory_budget = 1;
+	}
+
+	// optional memory priority extension which also
+	// requires the memoryPriority feature
+	const char* priority_names[] =
+	{
+		VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME
+	};
+
+	VkPhysicalDeviceMemoryPriorityFeaturesEXT pdmp_features =
+	{
+		.sType          = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PRIORITY_FEATURES_EXT,
+		.pNext          = NULL,
+		.memoryPriority = VK_FALSE
+	};
+
+	if(self->has_physical_device_properties2 &&
+	   vkk_engine_hasDeviceExtensions(self, 1, priority_names))
+	{
+		PFN_vkGetPhysicalDeviceFeatures2KHR getPhysicalDeviceFeatures2;
+		getPhysicalDeviceFeatures2 =
+			(PFN_vkGetPhysicalDeviceFeatures2KHR)
+			vkGetInstanceProcAddr(self->instance,
+			                      "vkGetPhysicalDeviceFeatures2KHR");
+		if(getPhysicalDeviceFeatures2)
+		{
+			VkPhysicalDeviceFeatures2KHR pdf2 =
+			{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR,
+				.pNext = &pdmp_features,
+			};
+			getPhysicalDeviceFeatures2(self->physical_device,
+			                           &pdf2);
+		}
+		else
+		{
+			LOGW("vkGetInstanceProcAddr failed");
+		}
+
+		if(pdmp_features.memoryPriority)
+		{
+			extension_names[extension_count++] = priority_names[0];
+			self->has_memory_priority = 1;
+		}
+	}
+
 	uint32_t qfp_count;
 	vkGetPhysicalDeviceQueueFamilyProperties(self->physical_device,
 	                                         &qfp_count,
@@ -494,38 +652,75 @@ static int vkk_engine_newDevice(vkk_engine_t* self)
 		goto fail_select_qfp;
 	}
 
+	// select a dedicated transfer queue family (e.g. DMA
+	// engine) such that uploads may overlap rendering
+	self->transfer_family_index = self->queue_family_index;
+	for(i = 0; i < qfp_count; ++i)
+	{
+		VkQueueFlags flags = qfp[i].queueFlags;
+		if((flags & VK_QUEUE_TRANSFER_BIT)         &&
+		   ((flags & VK_QUEUE_GRAPHICS_BIT) == 0) &&
+		   ((flags & VK_QUEUE_COMPUTE_BIT)  == 0) &&
+		   (qfp[i].queueCount > 0))
+		{
+			LOGI("transfer queue family=%i", i);
+			self->transfer_family_index = i;
+			self->has_transfer_queue    = 1;
+			break;
+		}
+	}
+
 	float queue_priority[2] =
 	{
 		1.0f, 0.5f
 	};
-	VkDeviceQueueCreateInfo dqc_info =
-	{
-		.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-		.pNext            = NULL,
-		.flags            = 0,
-		.queueFamilyIndex = self->queue_family_index,
-		.queueCount       = queue_count,
-		.pQueuePriorities = queue_priority
+	VkDeviceQueueCreateInfo dqc_info[2] =
+	{
+		{
+			.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			.pNext            = NULL,
+			.flags            = 0,
+			.queueFamilyIndex = self->queue_family_index,
+			.queueCount       = queue_count,
+			.pQueuePriorities = queue_priority
+		},
+		{
+			.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			.pNext            = NULL,
+			.flags            = 0,
+			.queueFamilyIndex = self->transfer_family_index,
+			.queueCount       = 1,
+			.pQueuePriorities = &queue_priority[1]
+		},
 	};
 
+	// enable the optional features (if supported)
 	VkPhysicalDeviceFeatures pdf =
 	{
-		.samplerAnisotropy = VK_TRUE,
+		.samplerAnisotropy          = self->max_anisotropy ?
+		                              VK_TRUE : VK_FALSE,
+		.textureCompressionBC       = self->texture_compression_bc ?
+		                              VK_TRUE : VK_FALSE,
+		.textureCompressionETC2     = self->texture_compression_etc2 ?
+		                              VK_TRUE : VK_FALSE,
+		.textureCompressionASTC_LDR = self->texture_compression_astc ?
+		                              VK_TRUE : VK_FALSE,
 	};
 
+	// enable the memoryPriority feature (if supported)
 	VkDeviceCreateInfo dc_info =
 	{
 		.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-		.pNext                   = NULL,
+		.pNext                   = self->has_memory_priority ?
+		                           &pdmp_features : NULL,
 		.flags                   = 0,
-		.queueCreateInfoCount    = 1,
-		.pQueueCreateInfos       = &dqc_info,
+		.queueCreateInfoCount    = self->has_transfer_queue ? 2 : 1,
+		.pQueueCreateInfos       = dqc_info,
 		.enabledLayerCount       = 0,
 		.ppEnabledLayerNames     = NULL,
 		.enabledExtensionCount   = extension_count,
 		.ppEnabledExtensionNames = extension_names,
-		.pEnabledFeatures        = self->max_anisotropy ?
-		                           &pdf : NULL
+		.pEnabledFeatures        = &pdf
 	};
 
 	if(vkCreateDevice(self->physical_device, &dc_info,
@@ -554,6 +749,17 @@ static int vkk_engine_newDevice(vkk_engine_t* self)
 		                 &(self->queue[VKK_QUEUE_BACKGROUND]));
 	}
 
+	if(self->has_transfer_queue)
+	{
+		vkGetDeviceQueue(self->device,
+		                 self->transfer_family_index, 0,
+		                 &(self->queue[VKK_QUEUE_TRANSFER]));
+	}
+	else
+	{
+		self->queue[VKK_QUEUE_TRANSFER] = self->queue[VKK_QUEUE_BACKGROUND];
+	}
+
 	FREE(qfp);
 
 	// success
@@ -780,6 +986,33 @@ vkk_engine_importShaderModule(vkk_engine_t* self,
 	return NULL;
 }
 
+static int
+vkk_engine_compressedFeature(vkk_engine_t* self,
+                             vkk_imageFormat_e format)
+{
+	ASSERT(self);
+
+	if((format == VKK_IMAGE_FORMAT_BC1RGBA) ||
+	   (format == VKK_IMAGE_FORMAT_BC3RGBA) ||
+	   (format == VKK_IMAGE_FORMAT_BC7RGBA))
+	{
+		return self->texture_compression_bc;
+	}
+	else if((format == VKK_IMAGE_FORMAT_ETC2RGB) ||
+	        (format == VKK_IMAGE_FORMAT_ETC2RGBA))
+	{
+		return self->texture_compression_etc2;
+	}
+	else if((format == VKK_IMAGE_FORMAT_ASTC4X4) ||
+	        (format == VKK_IMAGE_FORMAT_ASTC8X8))
+	{
+		return self->texture_compression_astc;
+	}
+
+	// uncompressed formats
+	return 1;
+}
+
 static void vkk_engine_initImageUsage(vkk_engine_t* self)
 {
 	ASSERT(self);
@@ -792,22 +1025,36 @@ static void vkk_engine_initImageUsage(vkk_engine_t* self)
 		vkGetPhysicalDeviceFormatProperties(self->physical_device,
 		                                    format, &fp);
 
-		// check for texture caps
+		// compressed formats require the device feature
 		VkFormatFeatureFlags flags = fp.optimalTilingFeatures;
+		if(vkk_engine_compressedFeature(self, i) == 0)
+		{
+			flags = 0;
+		}
+
+		// check for texture caps
 		if((flags & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) &&
 		   (flags & VK_FORMAT_FEATURE_TRANSFER_DST_BIT))
 		{
 			self->image_caps_array[i].texture = 1;
 		}
 
-		// check for mipmap caps
-		if((flags & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) &&
-		   (flags & VK_FORMAT_FEATURE_BLIT_SRC_BIT)      &&
-		   (flags & VK_FORMAT_FEATURE_BLIT_DST_BIT)      &&
-		   (flags & VK_FORMAT_FEATURE_TRANSFER_SRC_BIT)  &&
-		   (flags & VK_FORMAT_FEATURE_TRANSFER_DST_BIT))
+		// check for mipmap caps (blit chain or pre-compressed
+		// mip levels) where the compute path is checked by
+		// vkk_engine_imageCaps since it may be disabled
+		if(vkk_util_imageCompressed(i))
+		{
+			self->image_caps_array[i].mipmap =
+				self->image_caps_array[i].texture;
+		}
+		else if((flags & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) &&
+		        (flags & VK_FORMAT_FEATURE_BLIT_SRC_BIT)      &&
+		        (flags & VK_FORMAT_FEATURE_BLIT_DST_BIT)      &&
+		        (flags & VK_FORMAT_FEATURE_TRANSFER_SRC_BIT)  &&
+		        (flags & VK_FORMAT_FEATURE_TRANSFER_DST_BIT))
 		{
 			self->image_caps_array[i].mipmap = 1;
+			self->image_blit_array[i]        = 1;
 		}
 
 		// check for linear filtering
@@ -938,6 +1185,9 @@ vkk_engine_destructBuffer(vkk_engine_t* self, int wait,
 	vkk_buffer_t* buffer = *_buffer;
 	if(buffer)
 	{
+		// wait for pending async xfers
+		vkk_xferManager_wait(self->xfer, buffer->xfer_ticket);
+
 		if(wait)
 		{
 			vkk_engine_rendererWaitForTimestamp(self, buffer->ts);
@@ -954,9 +1204,12 @@ vkk_engine_destructBuffer(vkk_engine_t* self, int wait,
 		for(i = 0; i < count; ++i)
 		{
 			vkk_memoryManager_free(self->mm, &buffer->memory[i]);
-			vkDestroyBuffer(self->device,
-			                buffer->buffer[i],
-			                NULL);
+			if(buffer->shared == 0)
+			{
+				vkDestroyBuffer(self->device,
+				                buffer->buffer[i],
+				                NULL);
+			}
 		}
 		FREE(buffer->memory);
 		FREE(buffer->buffer);
@@ -975,6 +1228,12 @@ vkk_engine_destructImage(vkk_engine_t* self, int wait,
 	vkk_image_t* image = *_image;
 	if(image)
 	{
+		// wait for pending async readbacks and xfers (the
+		// readbacks which are recorded into a frame update
+		// the image timestamp)
+		vkk_xferManager_waitReadbacks(self->xfer, image);
+		vkk_xferManager_wait(self->xfer, image->xfer_ticket);
+
 		if(wait)
 		{
 			vkk_engine_rendererWaitForTimestamp(self, image->ts);
@@ -984,6 +1243,8 @@ vkk_engine_destructImage(vkk_engine_t* self, int wait,
 			vkk_engine_queueWaitIdle(self, VKK_QUEUE_FOREGROUND);
 		}
 
+		vkk_mipmapPipeline_deleteImage(self->mipmap_pipeline,
+		                               image);
 		vkDestroyImageView(self->device, image->image_view,
 		                   NULL);
 		vkk_memoryManager_free(self->mm, &image->memory);
@@ -1205,6 +1466,157 @@ vkk_engine_runDestructFn(int tid, void* owner, void* task)
 	vkk_object_delete(&object);
 }
 
+static void
+vkk_engine_mipmapBlit(vkk_engine_t* self,
+                      vkk_image_t* image,
+                      VkCommandBuffer cb,
+                      uint32_t level,
+                      uint32_t x, uint32_t y,
+                      uint32_t w, uint32_t h)
+{
+	ASSERT(self);
+	ASSERT(image);
+
+	// transition the mip level to a src for blitting
+	vkk_util_imageMemoryBarrier(image, cb,
+	                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	                            level, 1);
+
+	// transition the sub mip levels to dst for blitting
+	vkk_util_imageMemoryBarrier(image, cb,
+	                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                            level + 1,
+	                            image->mip_levels - level - 1);
+
+	VkFormat format = vkk_util_imageFormat(image->format);
+
+	VkFormatProperties fp;
+	vkGetPhysicalDeviceFormatProperties(self->physical_device,
+	                                    format, &fp);
+
+	VkFilter filter = VK_FILTER_NEAREST;
+	if(fp.optimalTilingFeatures &
+	   VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
+	{
+		filter = VK_FILTER_LINEAR;
+	}
+
+	// the region [x0,x1)x[y0,y1) is the affected region of
+	// the previous mip level and the depth is not a region
+	uint32_t x0 = x;
+	uint32_t y0 = y;
+	uint32_t x1 = x + w;
+	uint32_t y1 = y + h;
+
+	int i;
+	for(i = level + 1; i < image->mip_levels; ++i)
+	{
+		// mip level size (enforce the minimum size)
+		uint32_t sw = image->width  >> (i - 1);
+		uint32_t sh = image->height >> (i - 1);
+		uint32_t sd = image->depth  >> (i - 1);
+		uint32_t dw = image->width  >> i;
+		uint32_t dh = image->height >> i;
+		uint32_t dd = image->depth  >> i;
+		sw = (sw == 0) ? 1 : sw;
+		sh = (sh == 0) ? 1 : sh;
+		sd = (sd == 0) ? 1 : sd;
+		dw = (dw == 0) ? 1 : dw;
+		dh = (dh == 0) ? 1 : dh;
+		dd = (dd == 0) ? 1 : dd;
+
+		// the dst region covers every texel which samples
+		// the src region and the src region is expanded to
+		// the texels sampled by the dst region
+		uint32_t dx0 = x0/2;
+		uint32_t dy0 = y0/2;
+		uint32_t dx1 = (x1 + 1)/2;
+		uint32_t dy1 = (y1 + 1)/2;
+		dx1 = (dx1 > dw) ? dw : dx1;
+		dy1 = (dy1 > dh) ? dh : dy1;
+
+		// the last column/row of the dst level folds in the
+		// extra texel of an odd sized src level so the blit
+		// scale is sw/dw rather than 2 and the region is
+		// expanded to the full level to match the scale of
+		// a full level blit
+		if(sw != 2*dw)
+		{
+			dx0 = 0;
+			dx1 = dw;
+		}
+		if(sh != 2*dh)
+		{
+			dy0 = 0;
+			dy1 = dh;
+		}
+
+		uint32_t sx1 = (dx1 == dw) ? sw : 2*dx1;
+		uint32_t sy1 = (dy1 == dh) ? sh : 2*dy1;
+
+		VkImageBlit ib =
+		{
+			.srcSubresource =
+			{
+				.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel       = i - 1,
+				.baseArrayLayer = 0,
+				.layerCount     = 1
+			},
+			.srcOffsets =
+			{
+				{
+					.x = (int32_t) (2*dx0),
+					.y = (int32_t) (2*dy0),
+					.z = 0,
+				},
+				{
+					.x = (int32_t) sx1,
+					.y = (int32_t) sy1,
+					.z = (int32_t) sd,
+				}
+			},
+			.dstSubresource =
+			{
+				.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel       = i,
+				.baseArrayLayer = 0,
+				.layerCount     = 1
+			},
+			.dstOffsets =
+			{
+				{
+					.x = (int32_t) dx0,
+					.y = (int32_t) dy0,
+					.z = 0,
+				},
+				{
+					.x = (int32_t) dx1,
+					.y = (int32_t) dy1,
+					.z = (int32_t) dd,
+				}
+			}
+		};
+
+		vkCmdBlitImage(cb,
+		               image->image,
+		               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		               image->image,
+		               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		               1, &ib, filter);
+
+		// transition the mip level i to a src for blitting
+		vkk_util_imageMemoryBarrier(image, cb,
+		                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		                            i, 1);
+
+		x0 = dx0;
+		y0 = dy0;
+		x1 = dx1;
+		y1 = dy1;
+	}
+}
+
 /***********************************************************
 * public                                                   *
 ***********************************************************/
@@ -1253,6 +1665,163 @@ void vkk_engine_memoryInfo(vkk_engine_t* self,
 	ASSERT(info);
 
 	vkk_memoryManager_memoryInfo(self->mm, verbose, type, info);
+
+	// the xfer buffers are also included in the slots or
+	// dedicated memory
+	vkk_xferManager_memoryInfo(self->xfer, type, info);
+	if(verbose)
+	{
+		LOGI("MEMINFO: xfer count_xfer=%" PRIu64
+		     ", size_xfer=%" PRIu64,
+		     (uint64_t) info->count_xfer,
+		     (uint64_t) info->size_xfer);
+	}
+}
+
+void vkk_engine_trimMemory(vkk_engine_t* self)
+{
+	ASSERT(self);
+
+	// release the cached xfer buffers first such that
+	// their empty chunks are also released
+	vkk_xferManager_trim(self->xfer);
+	vkk_memoryManager_trim(self->mm);
+}
+
+void vkk_engine_memoryBudget(vkk_engine_t* self,
+                             vkk_memoryType_e type,
+                             vkk_memoryBudget_t* budget)
+{
+	ASSERT(self);
+	ASSERT(budget);
+
+	vkk_memoryManager_budget(self->mm, type, budget);
+}
+
+void vkk_engine_memorySoftCap(vkk_engine_t* self,
+                              vkk_memoryType_e type,
+                              size_t soft_cap)
+{
+	ASSERT(self);
+
+	vkk_memoryManager_softCap(self->mm, type, soft_cap);
+}
+
+void vkk_engine_memoryXferCap(vkk_engine_t* self,
+                              size_t cap)
+{
+	ASSERT(self);
+
+	vkk_xferManager_readbackCap(self->xfer, cap);
+}
+
+void vkk_engine_memoryEvictFn(vkk_engine_t* self,
+                              void* priv,
+                              vkk_engine_evictFn evict_fn)
+{
+	// priv and evict_fn may be NULL
+	ASSERT(self);
+
+	vkk_memoryManager_evictFn(self->mm, priv, evict_fn);
+}
+
+void vkk_engine_memoryStats(vkk_engine_t* self,
+                            vkk_memoryType_e type,
+                            vkk_memoryStats_t* stats)
+{
+	ASSERT(self);
+	ASSERT(stats);
+
+	vkk_memoryManager_stats(self->mm, type, stats);
+}
+
+int vkk_engine_memoryStatsDump(vkk_engine_t* self,
+                               const char* fname)
+{
+	ASSERT(self);
+	ASSERT(fname);
+
+	return vkk_memoryManager_statsDump(self->mm, fname);
+}
+
+int vkk_engine_pollTicket(vkk_engine_t* self,
+                          uint64_t ticket)
+{
+	ASSERT(self);
+
+	return vkk_xferManager_poll(self->xfer, ticket);
+}
+
+void vkk_engine_waitTicket(vkk_engine_t* self,
+                           uint64_t ticket)
+{
+	ASSERT(self);
+
+	vkk_xferManager_wait(self->xfer, ticket);
+}
+
+int vkk_engine_pollReadback(vkk_engine_t* self,
+                            vkk_readback_t* readback)
+{
+	ASSERT(self);
+
+	return vkk_xferManager_pollReadback(self->xfer, readback);
+}
+
+const void*
+vkk_engine_mapReadback(vkk_engine_t* self,
+                       vkk_readback_t* readback)
+{
+	ASSERT(self);
+
+	return vkk_xferManager_mapReadback(self->xfer, readback);
+}
+
+void vkk_engine_deleteReadback(vkk_engine_t* self,
+                               vkk_readback_t** _readback)
+{
+	ASSERT(self);
+
+	vkk_xferManager_deleteReadback(self->xfer, _readback);
+}
+
+void vkk_engine_beginUploads(vkk_engine_t* self)
+{
+	ASSERT(self);
+
+	vkk_xferManager_beginBatch(self->xfer);
+}
+
+uint64_t vkk_engine_endUploads(vkk_engine_t* self)
+{
+	ASSERT(self);
+
+	return vkk_xferManager_endBatch(self->xfer);
+}
+
+void vkk_engine_mipmapCompute(vkk_engine_t* self,
+                              int enable)
+{
+	ASSERT(self);
+
+	self->mipmap_pipeline->enable = enable;
+}
+
+void vkk_engine_mipmapTimer(vkk_engine_t* self, int enable)
+{
+	ASSERT(self);
+
+	vkk_mipmapPipeline_timer(self->mipmap_pipeline, enable);
+}
+
+double vkk_engine_mipmapElapsed(vkk_engine_t* self,
+                                uint32_t* _count)
+{
+	ASSERT(self);
+	ASSERT(_count);
+
+	return vkk_mipmapPipeline_elapsed(self->mipmap_pipeline,
+	                                  _count);
 }
 
 void vkk_engine_imageCaps(vkk_engine_t* self,
@@ -1263,6 +1832,15 @@ void vkk_engine_imageCaps(vkk_engine_t* self,
 	ASSERT(caps);
 
 	*caps = self->image_caps_array[format];
+
+	// formats without blit support may only be mipmapped
+	// by compute (2D images only) when it is enabled
+	if((caps->mipmap == 0) && caps->texture &&
+	   vkk_mipmapPipeline_supported(self->mipmap_pipeline,
+	                                format))
+	{
+		caps->mipmap = 1;
+	}
 }
 
 float vkk_engine_maxAnisotropy(vkk_engine_t* self)
@@ -1624,6 +2202,12 @@ vkk_engine_t* vkk_engine_new(vkk_platform_t* platform,
 		goto fail_samplers;
 	}
 
+	self->mipmap_pipeline = vkk_mipmapPipeline_new(self);
+	if(self->mipmap_pipeline == NULL)
+	{
+		goto fail_mipmap_pipeline;
+	}
+
 	vkk_engine_initImageUsage(self);
 
 	if(vkk_engine_noDisplay())
@@ -1654,6 +2238,8 @@ vkk_engine_t* vkk_engine_new(vkk_platform_t* platform,
 	fail_jobq_destruct:
 		vkk_defaultRenderer_delete(&self->renderer);
 	fail_renderer:
+		vkk_mipmapPipeline_delete(&self->mipmap_pipeline);
+	fail_mipmap_pipeline:
 		cc_map_delete(&self->samplers);
 	fail_samplers:
 		cc_map_delete(&self->shader_modules);
@@ -1705,6 +2291,7 @@ void vkk_engine_delete(vkk_engine_t** _self)
 		cc_jobq_finish(self->jobq_destruct);
 		vkk_defaultRenderer_delete(&self->renderer);
 		cc_jobq_delete(&self->jobq_destruct);
+		vkk_mipmapPipeline_delete(&self->mipmap_pipeline);
 
 		cc_mapIter_t* miter = cc_map_head(self->samplers);
 		while(miter)
@@ -1751,15 +2338,22 @@ void vkk_engine_shutdown(vkk_engine_t* self)
 	ASSERT(self);
 
 	vkk_engine_rendererLock(self);
-	if(self->shutdown == 0)
+	int shutdown = self->shutdown;
+	if(shutdown == 0)
 	{
 		vkDeviceWaitIdle(self->device);
 		self->shutdown = 1;
 		vkk_engine_rendererSignal(self);
 		vkk_memoryManager_shutdown(self->mm);
-		vkk_xferManager_shutdown(self->xfer);
 	}
 	vkk_engine_rendererUnlock(self);
+
+	// the xfer manager submits upload batches while locked
+	// so it must not be locked while the renderer is locked
+	if(shutdown == 0)
+	{
+		vkk_xferManager_shutdown(self->xfer);
+	}
 }
 
 void vkk_engine_deviceWaitIdle(vkk_engine_t* self)
@@ -1791,117 +2385,48 @@ void vkk_engine_mipmapImage(vkk_engine_t* self,
 	ASSERT(image);
 	ASSERT(cb != VK_NULL_HANDLE);
 
-	// transition the base mip level to a src for blitting
-	vkk_util_imageMemoryBarrier(image, cb,
-	                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-	                            0, 1);
+	vkk_engine_mipmapRegion(self, image, cb, 0, 0, 0,
+	                        image->width, image->height);
+}
 
-	// transition the sub mip levels to dst for blitting
-	vkk_util_imageMemoryBarrier(image, cb,
-	                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-	                            1, image->mip_levels - 1);
+void vkk_engine_mipmapRegion(vkk_engine_t* self,
+                             vkk_image_t* image,
+                             VkCommandBuffer cb,
+                             uint32_t level,
+                             uint32_t x, uint32_t y,
+                             uint32_t w, uint32_t h)
+{
+	ASSERT(self);
+	ASSERT(image);
+	ASSERT(cb != VK_NULL_HANDLE);
+	ASSERT(level < image->mip_levels);
+	ASSERT(w && h);
 
-	int i;
-	uint32_t w = image->width;
-	uint32_t h = image->height;
-	uint32_t d = image->depth;
-	for(i = 1; i < image->mip_levels; ++i)
+	// check if there are sub mip levels to generate
+	if(level + 1 >= image->mip_levels)
 	{
-		VkImageBlit ib =
-		{
-			.srcSubresource =
-			{
-				.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel       = i - 1,
-				.baseArrayLayer = 0,
-				.layerCount     = 1
-			},
-			.srcOffsets =
-			{
-				{
-					.x = 0,
-					.y = 0,
-					.z = 0,
-				},
-				{
-					.x = (uint32_t) (w >> (i - 1)),
-					.y = (uint32_t) (h >> (i - 1)),
-					.z = (uint32_t) (d >> (i - 1)),
-				}
-			},
-			.dstSubresource =
-			{
-				.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel       = i,
-				.baseArrayLayer = 0,
-				.layerCount     = 1
-			},
-			.dstOffsets =
-			{
-				{
-					.x = 0,
-					.y = 0,
-					.z = 0,
-				},
-				{
-					.x = (uint32_t) (w >> i),
-					.y = (uint32_t) (h >> i),
-					.z = (uint32_t) (d >> i),
-				}
-			}
-		};
-
-		// enforce the minimum size
-		if(ib.srcOffsets[1].x == 0)
-		{
-			ib.srcOffsets[1].x = 1;
-		}
-		if(ib.srcOffsets[1].y == 0)
-		{
-			ib.srcOffsets[1].y = 1;
-		}
-		if(ib.srcOffsets[1].z == 0)
-		{
-			ib.srcOffsets[1].z = 1;
-		}
-		if(ib.dstOffsets[1].x == 0)
-		{
-			ib.dstOffsets[1].x = 1;
-		}
-		if(ib.dstOffsets[1].y == 0)
-		{
-			ib.dstOffsets[1].y = 1;
-		}
-		if(ib.dstOffsets[1].z == 0)
-		{
-			ib.dstOffsets[1].z = 1;
-		}
-
-		VkFormat format = vkk_util_imageFormat(image->format);
-
-		VkFormatProperties fp;
-		vkGetPhysicalDeviceFormatProperties(self->physical_device,
-		                                    format, &fp);
-
-		VkFilter filter = VK_FILTER_NEAREST;
-		if(fp.optimalTilingFeatures &
-		   VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
-		{
-			filter = VK_FILTER_LINEAR;
-		}
+		return;
+	}
 
-		vkCmdBlitImage(cb,
-		               image->image,
-		               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-		               image->image,
-		               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		               1, &ib, filter);
+	// optionally measure the GPU time of the mip chain
+	int query;
+	query = vkk_mipmapPipeline_timerBegin(self->mipmap_pipeline,
+	                                      cb);
 
-		// transition the mip level i to a src for blitting
-		vkk_util_imageMemoryBarrier(image, cb,
-		                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-		                            i, 1);
+	// images with storage views are mipmapped by compute
+	if(image->mip_sets)
+	{
+		vkk_mipmapPipeline_record(self->mipmap_pipeline, image,
+		                          cb, level, x, y, w, h);
+	}
+	else
+	{
+		vkk_engine_mipmapBlit(self, image, cb, level,
+		                      x, y, w, h);
 	}
+
+	vkk_mipmapPipeline_timerEnd(self->mipmap_pipeline, cb,
+	                            query);
 }
 
 uint32_t vkk_engine_imageCount(vkk_engine_t* self)
@@ -1944,6 +2469,9 @@ int vkk_engine_queueSubmit(vkk_engine_t* self,
 		.pSignalSemaphores    = semaphore_submit
 	};
 
+	// flush the CPU writes to non-coherent memory
+	vkk_memoryManager_flush(self->mm);
+
 	vkk_engine_rendererLock(self);
 	if(self->shutdown)
 	{
@@ -2123,7 +2651,7 @@ vkk_engine_attachUniformBuffer(vkk_engine_t* self,
 		VkDescriptorBufferInfo db_info =
 		{
 			.buffer  = ua->buffer->buffer[idx],
-			.offset  = 0,
+			.offset  = vkk_buffer_offset(ua->buffer, idx),
 			.range   = ua->buffer->size
 		};
 
@@ -78,9 +78,12 @@ typedef struct vkk_object_s
 	};
 } vkk_object_t;
 
+// the transfer queue is the background queue unless the
+// device exposes a dedicated transfer queue family
 #define VKK_QUEUE_FOREGROUND 0
 #define VKK_QUEUE_BACKGROUND 1
-#define VKK_QUEUE_COUNT      2
+#define VKK_QUEUE_TRANSFER   2
+#define VKK_QUEUE_COUNT      3
 
 typedef struct vkk_engine_s
 {
@@ -137,10 +140,23 @@ typedef struct vkk_engine_s
 	// device capabilities
 	float    max_anisotropy;
 	uint32_t msaa_sample_count;
+	int      texture_compression_bc;
+	int      texture_compression_etc2;
+	int      texture_compression_astc;
+
+	// instance extensions
+	int has_physical_device_properties2;
+
+	// device extensions
+	int has_dedicated_allocation;
+	int has_memory_budget;
+	int has_memory_priority;
 
 	// device state
 	VkDevice device;
 	uint32_t queue_family_index;
+	uint32_t transfer_family_index;
+	int      has_transfer_queue;
 	VkQueue  queue[VKK_QUEUE_COUNT];
 
 	// memory manager
@@ -157,9 +173,15 @@ typedef struct vkk_engine_s
 	// samplers
 	cc_map_t* samplers;
 
+	// compute mipmap generation
+	struct vkk_mipmapPipeline_s* mipmap_pipeline;
+
 	// image capabilities
 	vkk_imageCaps_t image_caps_array[VKK_IMAGE_FORMAT_COUNT];
 
+	// formats which support the blit chain mipmap path
+	int image_blit_array[VKK_IMAGE_FORMAT_COUNT];
+
 	// default renderer
 	int             shutdown;
 	vkk_renderer_t* renderer;
@@ -186,6 +208,12 @@ int           vkk_engine_recreate(vkk_engine_t* self);
 void             vkk_engine_mipmapImage(vkk_engine_t* self,
                                         vkk_image_t* image,
                                         VkCommandBuffer cb);
+void             vkk_engine_mipmapRegion(vkk_engine_t* self,
+                                         vkk_image_t* image,
+                                         VkCommandBuffer cb,
+                                         uint32_t level,
+                                         uint32_t x, uint32_t y,
+                                         uint32_t w, uint32_t h);
 uint32_t         vkk_engine_imageCount(vkk_engine_t* self);
 int              vkk_engine_queueSubmit(vkk_engine_t* self,
                                         uint32_t queue,
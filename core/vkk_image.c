@@ -31,6 +31,7 @@
 #include "vkk_memoryChunk.h"
 #include "vkk_memoryManager.h"
 #include "vkk_memoryPool.h"
+#include "vkk_mipmapPipeline.h"
 #include "vkk_util.h"
 
 /***********************************************************
@@ -76,51 +77,58 @@ vkk_image_t* vkk_image_new(vkk_engine_t* engine,
 	// pixels may be NULL for image rendering
 	ASSERT(engine);
 
-	// check if mipmapped images are a power-of-two
-	// and compute the mip_levels
-	uint32_t mip_levels = 1;
-	if(mipmap)
-	{
-		uint32_t w = 1;
-		uint32_t h = 1;
-		uint32_t d = 1;
-		uint32_t n = 1;
-		uint32_t m = 1;
-		uint32_t o = 1;
-
-		while(w < width)
-		{
-			w *= 2;
-			n += 1;
-		}
+	return vkk_image_newPriority(engine, width, height, depth,
+	                             format, mipmap, stage,
+	                             VKK_MEMORY_PRIORITY_DEFAULT,
+	                             pixels);
+}
 
-		while(h < height)
-		{
-			h *= 2;
-			m += 1;
-		}
+vkk_image_t*
+vkk_image_newPriority(vkk_engine_t* engine,
+                      uint32_t width,
+                      uint32_t height,
+                      uint32_t depth,
+                      vkk_imageFormat_e format,
+                      int mipmap,
+                      vkk_stage_e stage,
+                      vkk_memoryPriority_e priority,
+                      const void* pixels)
+{
+	// pixels may be NULL for image rendering
+	ASSERT(engine);
 
-		while(d < depth)
-		{
-			d *= 2;
-			o += 1;
-		}
+	// compressed images are 2D textures whose pixels are
+	// pre-compressed by the app
+	if(vkk_util_imageCompressed(format) &&
+	   ((pixels == NULL) || (depth != 1)))
+	{
+		LOGE("invalid format=%i, depth=%u, pixels=%p",
+		     (int) format, depth, pixels);
+		return NULL;
+	}
 
-		if((w != width) || (h != height) || (d != depth))
-		{
-			LOGE("invalid w=%u, width=%u, h=%u, height=%u, d=%u, depth=%u",
-			     w, width, h, height, d, depth);
-			return NULL;
-		}
+	// the device may not support the compressed format
+	// (see vkk_engine_imageCaps)
+	if(vkk_util_imageCompressed(format) &&
+	   (engine->image_caps_array[format].texture == 0))
+	{
+		LOGE("unsupported format=%i", (int) format);
+		return NULL;
+	}
 
-		// get the maximum mip levels
-		if(m > n)
-		{
-			mip_levels = (m > o) ? m : o;
-		}
-		else
+	// compute the mip_levels where the size of each mip
+	// level is rounded down until the largest dimension
+	// reaches one
+	uint32_t mip_levels = 1;
+	if(mipmap)
+	{
+		uint32_t size = width;
+		size = (height > size) ? height : size;
+		size = (depth  > size) ? depth  : size;
+		while(size > 1)
 		{
-			mip_levels = (n > o) ? n : o;
+			size /= 2;
+			mip_levels += 1;
 		}
 	}
 
@@ -185,6 +193,26 @@ vkk_image_t* vkk_image_new(vkk_engine_t* engine,
 		usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 	}
 
+	// 2D images which are mipmapped by compute are also
+	// storage images
+	int mipmap_compute = 0;
+	if((mip_levels > 1) && (depth == 1) &&
+	   vkk_mipmapPipeline_supported(engine->mipmap_pipeline,
+	                                format))
+	{
+		usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		mipmap_compute = 1;
+	}
+	else if((mip_levels > 1) &&
+	        (vkk_util_imageCompressed(format) == 0) &&
+	        (engine->image_blit_array[format] == 0))
+	{
+		// the blit chain is invalid for this format (e.g. a
+		// 3D image or compute mipmaps are disabled)
+		LOGE("invalid format=%i, depth=%u", (int) format, depth);
+		goto fail_mipmap_blit;
+	}
+
 	VkImageCreateInfo i_info =
 	{
 		.sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -222,7 +250,8 @@ vkk_image_t* vkk_image_new(vkk_engine_t* engine,
 		vkk_memoryManager_allocImage(engine->mm,
 		                             self->image,
 		                             device_memory,
-		                             transient_memory);
+		                             transient_memory,
+		                             priority);
 	if(self->memory == NULL)
 	{
 		goto fail_alloc;
@@ -261,11 +290,20 @@ vkk_image_t* vkk_image_new(vkk_engine_t* engine,
 		goto fail_image_view;
 	}
 
+	if(mipmap_compute)
+	{
+		if(vkk_mipmapPipeline_newImage(engine->mipmap_pipeline,
+		                               self) == 0)
+		{
+			goto fail_mipmap;
+		}
+	}
+
 	// upload pixel data
 	if(pixels)
 	{
 		if(vkk_xferManager_writeImage(engine->xfer, self,
-		                              pixels) == 0)
+		                              pixels, NULL) == 0)
 		{
 			goto fail_upload;
 		}
@@ -280,6 +318,9 @@ vkk_image_t* vkk_image_new(vkk_engine_t* engine,
 
 	// failure
 	fail_upload:
+		vkk_mipmapPipeline_deleteImage(engine->mipmap_pipeline,
+		                               self);
+	fail_mipmap:
 		vkDestroyImageView(engine->device, self->image_view,
 		                   NULL);
 	fail_image_view:
@@ -288,6 +329,7 @@ vkk_image_t* vkk_image_new(vkk_engine_t* engine,
 		vkDestroyImage(engine->device,
 		               self->image, NULL);
 	fail_create_image:
+	fail_mipmap_blit:
 		FREE(self->layout_array);
 	fail_layout_array:
 		FREE(self);
@@ -324,7 +366,7 @@ vkk_memoryType_e vkk_image_memoryType(vkk_image_t* self)
 {
 	ASSERT(self);
 
-	return self->memory->chunk->pool->type;
+	return self->memory->chunk->type;
 }
 
 size_t vkk_image_size(vkk_image_t* self,
@@ -337,29 +379,11 @@ size_t vkk_image_size(vkk_image_t* self,
 	ASSERT(_height);
 	ASSERT(_depth);
 
-	size_t bpp[VKK_IMAGE_FORMAT_COUNT] =
-	{
-		4,  // VKK_IMAGE_FORMAT_RGBA8888
-		2,  // VKK_IMAGE_FORMAT_RGBA4444
-		16, // VKK_IMAGE_FORMAT_RGBAF32
-		8,  // VKK_IMAGE_FORMAT_RGBAF16
-		3,  // VKK_IMAGE_FORMAT_RGB888
-		2,  // VKK_IMAGE_FORMAT_RGB565
-		12, // VKK_IMAGE_FORMAT_RGBF32
-		6,  // VKK_IMAGE_FORMAT_RGBF16
-		2,  // VKK_IMAGE_FORMAT_RG88
-		8,  // VKK_IMAGE_FORMAT_RGF32
-		4,  // VKK_IMAGE_FORMAT_RGF16
-		1,  // VKK_IMAGE_FORMAT_R8
-		4,  // VKK_IMAGE_FORMAT_RF32
-		2,  // VKK_IMAGE_FORMAT_RF16
-	};
-
 	*_width  = self->width;
 	*_height = self->height;
 	*_depth  = self->depth;
-	return self->width*self->height*self->depth*
-	       bpp[self->format];
+	return vkk_util_imageSize(self->format, self->width,
+	                          self->height, self->depth);
 }
 
 int vkk_image_readPixels(vkk_image_t* self,
@@ -373,3 +397,87 @@ int vkk_image_readPixels(vkk_image_t* self,
 	return vkk_xferManager_readImage(engine->xfer,
 	                                 self, pixels);
 }
+
+vkk_readback_t* vkk_image_readPixelsAsync(vkk_image_t* self)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	return vkk_xferManager_readImageAsync(engine->xfer, self);
+}
+
+int vkk_image_writePixelsAsync(vkk_image_t* self,
+                               const void* pixels,
+                               uint64_t* _ticket)
+{
+	ASSERT(self);
+	ASSERT(pixels);
+	ASSERT(_ticket);
+
+	vkk_engine_t* engine = self->engine;
+
+	// the image may still be in use by a renderer
+	vkk_engine_rendererWaitForTimestamp(engine, self->ts);
+
+	return vkk_xferManager_writeImage(engine->xfer, self,
+	                                  pixels, _ticket);
+}
+
+int vkk_image_writeRegion(vkk_image_t* self,
+                          uint32_t x,
+                          uint32_t y,
+                          uint32_t w,
+                          uint32_t h,
+                          uint32_t level,
+                          const void* pixels)
+{
+	ASSERT(self);
+	ASSERT(pixels);
+
+	vkk_engine_t* engine = self->engine;
+
+	// validate the region of the mip level (the region is
+	// compared without computing x + w which may overflow)
+	uint32_t width  = 1;
+	uint32_t height = 1;
+	if(level < self->mip_levels)
+	{
+		width  = self->width  >> level;
+		height = self->height >> level;
+		width  = (width  == 0) ? 1 : width;
+		height = (height == 0) ? 1 : height;
+	}
+
+	if((level >= self->mip_levels) || (w == 0) || (h == 0) ||
+	   (x > width)  || (w > width  - x) ||
+	   (y > height) || (h > height - y))
+	{
+		LOGE("invalid level=%u, x=%u, y=%u, w=%u, h=%u"
+		     ", width=%u, height=%u, mip_levels=%u",
+		     level, x, y, w, h, width, height,
+		     self->mip_levels);
+		return 0;
+	}
+
+	// the region of a compressed image must be aligned to
+	// the block size except at the edges of the mip level
+	uint32_t bw;
+	uint32_t bh;
+	vkk_util_imageBlock(self->format, &bw, &bh);
+	if((x%bw) || (y%bh) ||
+	   ((w%bw) && (w != width  - x)) ||
+	   ((h%bh) && (h != height - y)))
+	{
+		LOGE("invalid x=%u, y=%u, w=%u, h=%u, bw=%u, bh=%u",
+		     x, y, w, h, bw, bh);
+		return 0;
+	}
+
+	// the image may still be in use by a renderer
+	vkk_engine_rendererWaitForTimestamp(engine, self->ts);
+
+	return vkk_xferManager_writeRegion(engine->xfer, self,
+	                                   level, x, y, w, h,
+	                                   pixels);
+}
@@ -44,6 +44,20 @@ typedef struct vkk_image_s
 	vkk_memory_t*     memory;
 	VkImageView       image_view;
 	VkSemaphore       semaphore;
+
+	// per level storage image views and descriptor sets
+	// for images which are mipmapped by compute (or NULL)
+	VkImageView*     mip_views;
+	VkDescriptorPool mip_pool;
+	VkDescriptorSet* mip_sets;
+
+	// pending async xfer ticket (or zero)
+	uint64_t xfer_ticket;
+
+	// pending async readback ticket (or zero) which is only
+	// waited on before the image is written or destroyed
+	// since readbacks and binds are ordered by the queue
+	uint64_t readback_ticket;
 } vkk_image_t;
 
 // protected
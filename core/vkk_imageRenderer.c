@@ -243,9 +243,12 @@ vkk_imageRenderer_newFramebuffer(vkk_renderer_t* base,
 
 	vkk_engine_t* engine = base->engine;
 
-	self->src_image = vkk_image_new(engine, width, height, 1,
-	                                format, 0, VKK_STAGE_FS,
-	                                NULL);
+	// render targets should remain resident
+	self->src_image = vkk_image_newPriority(engine, width, height,
+	                                        1, format, 0,
+	                                        VKK_STAGE_FS,
+	                                        VKK_MEMORY_PRIORITY_HIGH,
+	                                        NULL);
 	if(self->src_image == NULL)
 	{
 		return 0;
@@ -388,9 +388,12 @@ vkk_imageStreamRenderer_new(vkk_renderer_t* consumer,
 	int i;
 	for(i = 0; i < image_count; ++i)
 	{
-		self->images[i] = vkk_image_new(engine, width, height, 1,
-		                                format, mipmap, stage,
-		                                NULL);
+		// render targets should remain resident
+		self->images[i] = vkk_image_newPriority(engine, width,
+		                                        height, 1, format,
+		                                        mipmap, stage,
+		                                        VKK_MEMORY_PRIORITY_HIGH,
+		                                        NULL);
 		if(self->images[i] == NULL)
 		{
 			goto fail_image;
@@ -36,7 +36,8 @@
 
 vkk_memory_t*
 vkk_memory_new(vkk_memoryChunk_t* chunk,
-               VkDeviceSize offset)
+               VkDeviceSize offset,
+               VkDeviceSize size)
 {
 	ASSERT(chunk);
 
@@ -51,6 +52,7 @@ vkk_memory_new(vkk_memoryChunk_t* chunk,
 
 	self->chunk  = chunk;
 	self->offset = offset;
+	self->size   = size;
 
 	return self;
 }
@@ -39,10 +39,12 @@ typedef struct vkk_memory_s
 	vkk_memoryChunk_t* chunk;
 
 	VkDeviceSize offset;
+	VkDeviceSize size;
 } vkk_memory_t;
 
 vkk_memory_t* vkk_memory_new(vkk_memoryChunk_t* chunk,
-                             VkDeviceSize offset);
+                             VkDeviceSize offset,
+                             VkDeviceSize size);
 void          vkk_memory_delete(vkk_memory_t** _self);
 
 #endif
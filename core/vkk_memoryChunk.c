@@ -21,11 +21,13 @@
  *
  */
 
+#include <inttypes.h>
 #include <stdlib.h>
 
 #define LOG_TAG "vkk"
 #include "../../libcc/cc_log.h"
 #include "../../libcc/cc_memory.h"
+#include "../../libcc/cc_timestamp.h"
 #include "vkk_engine.h"
 #include "vkk_memory.h"
 #include "vkk_memoryChunk.h"
@@ -33,18 +35,669 @@
 #include "vkk_memoryPool.h"
 
 /***********************************************************
-* public                                                   *
+* private - TLSF                                           *
 ***********************************************************/
 
-vkk_memoryChunk_t*
-vkk_memoryChunk_new(vkk_memoryPool_t* pool,
-                    vkk_memoryInfo_t* info)
+static VkDeviceSize
+vkk_memoryChunk_alignUp(VkDeviceSize size,
+                        VkDeviceSize align)
 {
-	ASSERT(pool);
+	// align must be a power of two
+	return (size + align - 1) & ~(align - 1);
+}
+
+static void
+vkk_memoryChunk_mapping(VkDeviceSize size, int* _fl, int* _sl)
+{
+	ASSERT(size >= VKK_MEMORY_TLSF_ALIGN);
+	ASSERT(_fl);
+	ASSERT(_sl);
+
+	int fl = 63 - __builtin_clzll((unsigned long long) size);
+	*_fl = fl;
+	*_sl = (int) ((size >> (fl - VKK_MEMORY_TLSF_SL_LOG2)) &
+	              (VKK_MEMORY_TLSF_SL - 1));
+}
+
+static vkk_memoryBlock_t*
+vkk_memoryChunk_newBlock(vkk_memoryChunk_t* self,
+                         VkDeviceSize offset,
+                         VkDeviceSize size)
+{
+	ASSERT(self);
+
+	vkk_memoryBlock_t* block;
+	block = (vkk_memoryBlock_t*)
+	        CALLOC(1, sizeof(vkk_memoryBlock_t));
+	if(block == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	block->memory.chunk  = self;
+	block->memory.offset = offset;
+	block->memory.size   = size;
+	block->is_free       = 1;
+
+	return block;
+}
+
+static void
+vkk_memoryChunk_deleteBlock(vkk_memoryBlock_t** _block)
+{
+	ASSERT(_block);
+
+	vkk_memoryBlock_t* block = *_block;
+	if(block)
+	{
+		FREE(block);
+		*_block = NULL;
+	}
+}
+
+static void
+vkk_memoryChunk_insertBlock(vkk_memoryChunk_t* self,
+                            vkk_memoryBlock_t* block)
+{
+	ASSERT(self);
+	ASSERT(block);
+
+	int fl;
+	int sl;
+	vkk_memoryChunk_mapping(block->memory.size, &fl, &sl);
+
+	vkk_memoryBlock_t* head = self->blocks[fl][sl];
+	block->prev_free = NULL;
+	block->next_free = head;
+	if(head)
+	{
+		head->prev_free = block;
+	}
+	self->blocks[fl][sl] = block;
+
+	self->fl_bitmap     |= 1ULL << fl;
+	self->sl_bitmap[fl] |= 1U << sl;
+}
+
+static void
+vkk_memoryChunk_removeBlock(vkk_memoryChunk_t* self,
+                            vkk_memoryBlock_t* block)
+{
+	ASSERT(self);
+	ASSERT(block);
+
+	int fl;
+	int sl;
+	vkk_memoryChunk_mapping(block->memory.size, &fl, &sl);
+
+	if(block->prev_free)
+	{
+		block->prev_free->next_free = block->next_free;
+	}
+	else
+	{
+		self->blocks[fl][sl] = block->next_free;
+	}
+
+	if(block->next_free)
+	{
+		block->next_free->prev_free = block->prev_free;
+	}
+	block->prev_free = NULL;
+	block->next_free = NULL;
+
+	// update the bitmaps when the free list is empty
+	if(self->blocks[fl][sl] == NULL)
+	{
+		self->sl_bitmap[fl] &= ~(1U << sl);
+		if(self->sl_bitmap[fl] == 0)
+		{
+			self->fl_bitmap &= ~(1ULL << fl);
+		}
+	}
+}
+
+// debug functions only used by ASSERT
+#ifdef ASSERT_DEBUG
+
+static int
+vkk_memoryChunk_checkList(vkk_memoryChunk_t* self,
+                          vkk_memoryBlock_t* block)
+{
+	ASSERT(self);
+	ASSERT(block);
+
+	int fl;
+	int sl;
+	vkk_memoryChunk_mapping(block->memory.size, &fl, &sl);
+
+	if(((self->fl_bitmap & (1ULL << fl)) == 0) ||
+	   ((self->sl_bitmap[fl] & (1U << sl)) == 0))
+	{
+		LOGW("invalid fl=%i, sl=%i", fl, sl);
+		return 0;
+	}
+
+	vkk_memoryBlock_t* iter = self->blocks[fl][sl];
+	while(iter)
+	{
+		if(iter == block)
+		{
+			return 1;
+		}
+		iter = iter->next_free;
+	}
+
+	LOGW("invalid offset=%" PRIu64 ", size=%" PRIu64,
+	     (uint64_t) block->memory.offset,
+	     (uint64_t) block->memory.size);
+	return 0;
+}
+
+static int
+vkk_memoryChunk_checkBlocks(vkk_memoryChunk_t* self,
+                            vkk_memoryBlock_t* block)
+{
+	ASSERT(self);
+	ASSERT(block);
+
+	// find the first block of the chunk
+	while(block->prev)
+	{
+		block = block->prev;
+	}
+
+	// the blocks must tile the chunk without overlap, free
+	// blocks must be fully coalesced and must be found in
+	// the free list selected by their size
+	VkDeviceSize offset    = 0;
+	VkDeviceSize size_used = 0;
+	uint32_t     usecount  = 0;
+	uint32_t     count     = 0;
+	while(block)
+	{
+		vkk_memoryBlock_t* next = block->next;
+		if((block->memory.offset != offset)              ||
+		   (block->memory.size < VKK_MEMORY_TLSF_ALIGN) ||
+		   (block->memory.offset%VKK_MEMORY_TLSF_ALIGN) ||
+		   (next && (next->prev != block))              ||
+		   (next && block->is_free && next->is_free))
+		{
+			LOGW("invalid offset=%" PRIu64 ", size=%" PRIu64
+			     ", expected=%" PRIu64 ", is_free=%i",
+			     (uint64_t) block->memory.offset,
+			     (uint64_t) block->memory.size,
+			     (uint64_t) offset, block->is_free);
+			return 0;
+		}
+
+		if(block->is_free)
+		{
+			if(vkk_memoryChunk_checkList(self, block) == 0)
+			{
+				return 0;
+			}
+			++count;
+		}
+		else
+		{
+			size_used += block->memory.size;
+			++usecount;
+		}
+
+		offset += block->memory.size;
+		block   = next;
+	}
+
+	// the free lists must only contain the free blocks
+	uint32_t free_count = 0;
+	int      fl;
+	int      sl;
+	for(fl = 0; fl < VKK_MEMORY_TLSF_FL; ++fl)
+	{
+		for(sl = 0; sl < VKK_MEMORY_TLSF_SL; ++sl)
+		{
+			vkk_memoryBlock_t* iter = self->blocks[fl][sl];
+			while(iter)
+			{
+				++free_count;
+				iter = iter->next_free;
+			}
+		}
+	}
+
+	if((offset    != self->size)      ||
+	   (size_used != self->size_used) ||
+	   (usecount  != self->usecount)  ||
+	   (count     != free_count))
+	{
+		LOGW("invalid size=%" PRIu64 "/%" PRIu64
+		     ", size_used=%" PRIu64 "/%" PRIu64
+		     ", usecount=%u/%u, free=%u/%u",
+		     (uint64_t) offset, (uint64_t) self->size,
+		     (uint64_t) size_used, (uint64_t) self->size_used,
+		     usecount, self->usecount, count, free_count);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+vkk_memoryChunk_checkSlots(vkk_memoryChunk_t* self)
+{
+	ASSERT(self);
+
+	vkk_memoryPool_t* pool = self->pool;
+
+	// the bitmap must match the usecount (excluding the
+	// bits past the last slot) and the words before the
+	// hint must be full
+	uint32_t words = (pool->count + 63)/64;
+	uint32_t tail  = pool->count%64;
+	uint32_t count = 0;
+	uint32_t w;
+	for(w = 0; w < words; ++w)
+	{
+		uint64_t bits = self->slot_bitmap[w];
+		if((w < self->slot_hint) && (bits != ~0ULL))
+		{
+			LOGW("invalid w=%u, slot_hint=%u", w, self->slot_hint);
+			return 0;
+		}
+
+		if(tail && (w == words - 1))
+		{
+			bits &= ~(~0ULL << tail);
+		}
+		count += (uint32_t) __builtin_popcountll((unsigned long long)
+		                                         bits);
+	}
+
+	if((count != self->usecount) ||
+	   (self->size_used != count*pool->stride))
+	{
+		LOGW("invalid count=%u, usecount=%u, size_used=%" PRIu64,
+		     count, self->usecount, (uint64_t) self->size_used);
+		return 0;
+	}
+
+	return 1;
+}
+
+#endif
+
+static vkk_memoryBlock_t*
+vkk_memoryChunk_findBlock(vkk_memoryChunk_t* self,
+                          VkDeviceSize size,
+                          VkDeviceSize align)
+{
+	ASSERT(self);
+
+	// worst case size including the alignment padding
+	VkDeviceSize search = size + align - VKK_MEMORY_TLSF_ALIGN;
+
+	// round up to the next list so that any block in the
+	// list is large enough (good fit)
+	int fl;
+	int sl;
+	vkk_memoryChunk_mapping(search, &fl, &sl);
+	VkDeviceSize round;
+	round = search + (1ULL << (fl - VKK_MEMORY_TLSF_SL_LOG2)) - 1;
+	vkk_memoryChunk_mapping(round, &fl, &sl);
+
+	uint32_t sl_map = self->sl_bitmap[fl] & (~0U << sl);
+	if(sl_map == 0)
+	{
+		uint64_t fl_map = 0;
+		if(fl + 1 < VKK_MEMORY_TLSF_FL)
+		{
+			fl_map = self->fl_bitmap & (~0ULL << (fl + 1));
+		}
+
+		if(fl_map)
+		{
+			fl     = __builtin_ctzll((unsigned long long) fl_map);
+			sl_map = self->sl_bitmap[fl];
+		}
+	}
+
+	if(sl_map)
+	{
+		sl = __builtin_ctz(sl_map);
+		return self->blocks[fl][sl];
+	}
+
+	// fall back to searching the list which contains the
+	// requested size since it may contain a block that is
+	// large enough (e.g. a chunk sized for the request)
+	vkk_memoryChunk_mapping(size, &fl, &sl);
+	vkk_memoryBlock_t* block = self->blocks[fl][sl];
+	while(block)
+	{
+		VkDeviceSize offset = block->memory.offset;
+		VkDeviceSize pad;
+		pad = vkk_memoryChunk_alignUp(offset, align) - offset;
+		if(pad + size <= block->memory.size)
+		{
+			return block;
+		}
+		block = block->next_free;
+	}
+
+	return NULL;
+}
+
+static vkk_memory_t*
+vkk_memoryChunk_allocBlock(vkk_memoryChunk_t* self,
+                           VkMemoryRequirements* mr,
+                           vkk_memoryInfo_t* info)
+{
+	ASSERT(self);
+	ASSERT(mr);
 	ASSERT(info);
 
-	vkk_memoryManager_t* mm     = pool->mm;
-	vkk_engine_t*        engine = mm->engine;
+	VkDeviceSize align = mr->alignment;
+	if(align < VKK_MEMORY_TLSF_ALIGN)
+	{
+		align = VKK_MEMORY_TLSF_ALIGN;
+	}
+
+	VkDeviceSize size;
+	size = vkk_memoryChunk_alignUp(mr->size,
+	                               VKK_MEMORY_TLSF_ALIGN);
+
+	vkk_memoryBlock_t* block;
+	block = vkk_memoryChunk_findBlock(self, size, align);
+	if(block == NULL)
+	{
+		return NULL;
+	}
+	vkk_memoryChunk_removeBlock(self, block);
+
+	// split the alignment padding into a free block
+	// note that the previous block is always in use since
+	// free blocks are merged
+	VkDeviceSize offset = block->memory.offset;
+	VkDeviceSize pad;
+	pad = vkk_memoryChunk_alignUp(offset, align) - offset;
+	if(pad)
+	{
+		vkk_memoryBlock_t* pad_block;
+		pad_block = vkk_memoryChunk_newBlock(self, offset, pad);
+		if(pad_block == NULL)
+		{
+			vkk_memoryChunk_insertBlock(self, block);
+			return NULL;
+		}
+
+		pad_block->prev = block->prev;
+		pad_block->next = block;
+		if(block->prev)
+		{
+			block->prev->next = pad_block;
+		}
+		block->prev           = pad_block;
+		block->memory.offset += pad;
+		block->memory.size   -= pad;
+		vkk_memoryChunk_insertBlock(self, pad_block);
+	}
+
+	// split the remainder into a free block
+	// the remainder is wasted if the split fails
+	if(block->memory.size - size >= VKK_MEMORY_TLSF_ALIGN)
+	{
+		vkk_memoryBlock_t* tail;
+		tail = vkk_memoryChunk_newBlock(self,
+		                                block->memory.offset + size,
+		                                block->memory.size - size);
+		if(tail)
+		{
+			tail->prev = block;
+			tail->next = block->next;
+			if(block->next)
+			{
+				block->next->prev = tail;
+			}
+			block->next        = tail;
+			block->memory.size = size;
+			vkk_memoryChunk_insertBlock(self, tail);
+		}
+	}
+
+	block->is_free   = 0;
+	self->size_used += block->memory.size;
+	++self->usecount;
+
+	ASSERT((block->memory.offset%align) == 0);
+	ASSERT(block->memory.size >= mr->size);
+	ASSERT(vkk_memoryChunk_checkBlocks(self, block));
+
+	// update performed by manager
+	++info->count_slots;
+	info->size_slots += (size_t) block->memory.size;
+
+	return &block->memory;
+}
+
+static void
+vkk_memoryChunk_freeBlock(vkk_memoryChunk_t* self,
+                          vkk_memory_t* memory,
+                          vkk_memoryInfo_t* info)
+{
+	ASSERT(self);
+	ASSERT(memory);
+	ASSERT(info);
+
+	vkk_memoryBlock_t* block = (vkk_memoryBlock_t*) memory;
+
+	// update performed by manager
+	++info->count_slots;
+	info->size_slots += (size_t) block->memory.size;
+
+	block->is_free   = 1;
+	self->size_used -= block->memory.size;
+	--self->usecount;
+
+	// merge with the previous block
+	vkk_memoryBlock_t* prev = block->prev;
+	if(prev && prev->is_free)
+	{
+		vkk_memoryChunk_removeBlock(self, prev);
+		prev->memory.size += block->memory.size;
+		prev->next         = block->next;
+		if(block->next)
+		{
+			block->next->prev = prev;
+		}
+		vkk_memoryChunk_deleteBlock(&block);
+		block = prev;
+	}
+
+	// merge with the next block
+	vkk_memoryBlock_t* next = block->next;
+	if(next && next->is_free)
+	{
+		vkk_memoryChunk_removeBlock(self, next);
+		block->memory.size += next->memory.size;
+		block->next         = next->next;
+		if(next->next)
+		{
+			next->next->prev = block;
+		}
+		vkk_memoryChunk_deleteBlock(&next);
+	}
+
+	vkk_memoryChunk_insertBlock(self, block);
+	ASSERT(vkk_memoryChunk_checkBlocks(self, block));
+}
+
+/***********************************************************
+* private - fixed stride                                   *
+***********************************************************/
+
+static int
+vkk_memoryChunk_newSlots(vkk_memoryChunk_t* self)
+{
+	ASSERT(self);
+
+	vkk_memoryPool_t* pool = self->pool;
+
+	// the handles are initialized once for the chunk
+	// lifetime so that alloc/free never call the heap
+	self->slot_array = (vkk_memory_t*)
+	                   CALLOC(pool->count, sizeof(vkk_memory_t));
+	if(self->slot_array == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	uint32_t words = (pool->count + 63)/64;
+	self->slot_bitmap = (uint64_t*)
+	                    CALLOC(words, sizeof(uint64_t));
+	if(self->slot_bitmap == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_bitmap;
+	}
+
+	uint32_t i;
+	for(i = 0; i < pool->count; ++i)
+	{
+		vkk_memory_t* memory = &self->slot_array[i];
+		memory->chunk  = self;
+		memory->offset = i*pool->stride;
+		memory->size   = pool->stride;
+	}
+
+	// mark the bits past the last slot as used so the bit
+	// scan never selects them
+	uint32_t tail = pool->count%64;
+	if(tail)
+	{
+		self->slot_bitmap[words - 1] = ~0ULL << tail;
+	}
+
+	// success
+	return 1;
+
+	// failure
+	fail_bitmap:
+		FREE(self->slot_array);
+		self->slot_array = NULL;
+	return 0;
+}
+
+static void
+vkk_memoryChunk_deleteSlots(vkk_memoryChunk_t* self)
+{
+	ASSERT(self);
+
+	FREE(self->slot_bitmap);
+	FREE(self->slot_array);
+	self->slot_bitmap = NULL;
+	self->slot_array  = NULL;
+}
+
+static vkk_memory_t*
+vkk_memoryChunk_allocSlot(vkk_memoryChunk_t* self,
+                          vkk_memoryInfo_t* info)
+{
+	ASSERT(self);
+	ASSERT(info);
+
+	vkk_memoryPool_t* pool = self->pool;
+
+	// check if the chunk is full
+	if(self->usecount == pool->count)
+	{
+		return NULL;
+	}
+
+	// find the first free slot starting with the first
+	// word which may contain a free slot
+	uint32_t words = (pool->count + 63)/64;
+	uint32_t w;
+	for(w = self->slot_hint; w < words; ++w)
+	{
+		uint64_t bits = self->slot_bitmap[w];
+		if(bits != ~0ULL)
+		{
+			int b = __builtin_ctzll((unsigned long long) ~bits);
+			self->slot_bitmap[w] = bits | (1ULL << b);
+			self->slot_hint      = w;
+
+			++self->usecount;
+			self->size_used += pool->stride;
+
+			ASSERT(vkk_memoryChunk_checkSlots(self));
+
+			// update performed by manager
+			++info->count_slots;
+			info->size_slots += (size_t) pool->stride;
+
+			return &self->slot_array[64*w + b];
+		}
+	}
+
+	// usecount implies that a slot is free
+	ASSERT(0);
+	return NULL;
+}
+
+static void
+vkk_memoryChunk_freeSlot(vkk_memoryChunk_t* self,
+                         vkk_memory_t* memory,
+                         vkk_memoryInfo_t* info)
+{
+	ASSERT(self);
+	ASSERT(memory);
+	ASSERT(info);
+
+	vkk_memoryPool_t* pool = self->pool;
+
+	uint32_t slot = (uint32_t) (memory - self->slot_array);
+	uint32_t w    = slot/64;
+	ASSERT(slot < pool->count);
+	ASSERT(self->slot_bitmap[w] & (1ULL << (slot%64)));
+
+	self->slot_bitmap[w] &= ~(1ULL << (slot%64));
+	if(w < self->slot_hint)
+	{
+		self->slot_hint = w;
+	}
+
+	--self->usecount;
+	self->size_used -= pool->stride;
+
+	ASSERT(vkk_memoryChunk_checkSlots(self));
+
+	// update performed by manager
+	++info->count_slots;
+	info->size_slots += (size_t) pool->stride;
+}
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static vkk_memoryChunk_t*
+vkk_memoryChunk_newChunk(vkk_memoryManager_t* mm,
+                         vkk_memoryPool_t* pool,
+                         uint32_t mt_index,
+                         vkk_memoryType_e type,
+                         vkk_memoryPriority_e priority,
+                         VkDeviceSize size,
+                         const void* ma_next,
+                         int* _over_budget)
+{
+	// pool and ma_next may be NULL
+	ASSERT(mm);
+	ASSERT(_over_budget);
+
+	vkk_engine_t* engine = mm->engine;
 
 	vkk_memoryChunk_t* self;
 	self = (vkk_memoryChunk_t*)
@@ -55,7 +708,11 @@ vkk_memoryChunk_new(vkk_memoryPool_t* pool,
 		return NULL;
 	}
 
-	self->pool = pool;
+	self->mm       = mm;
+	self->pool     = pool;
+	self->mt_index = mt_index;
+	self->type     = type;
+	self->size     = size;
 
 	// create an updater hash to reduce mutex conflicts
 	// for unrelated chunks
@@ -69,137 +726,384 @@ vkk_memoryChunk_new(vkk_memoryPool_t* pool,
 	}
 	self->updater = u % VKK_CHUNK_UPDATERS;
 
+	// the memory priority is a hint which allows the driver
+	// to demote low priority memory first under pressure
+	float priority_map[VKK_MEMORY_PRIORITY_COUNT] =
+	{
+		0.25f, 0.5f, 1.0f
+	};
+
+	VkMemoryPriorityAllocateInfoEXT mpa_info =
+	{
+		.sType    = VK_STRUCTURE_TYPE_MEMORY_PRIORITY_ALLOCATE_INFO_EXT,
+		.pNext    = ma_next,
+		.priority = priority_map[priority]
+	};
+
+	if(engine->has_memory_priority)
+	{
+		ma_next = &mpa_info;
+	}
+
 	VkMemoryAllocateInfo ma_info =
 	{
 		.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.pNext           = NULL,
-		.allocationSize  = pool->stride*pool->count,
-		.memoryTypeIndex = pool->mt_index
+		.pNext           = ma_next,
+		.allocationSize  = size,
+		.memoryTypeIndex = mt_index
 	};
 
-	if(vkAllocateMemory(engine->device, &ma_info, NULL,
-	                    &self->memory) != VK_SUCCESS)
+	// enforce the memory budget
+	if(vkk_memoryManager_reserve(mm, mt_index, type,
+	                             (size_t) size) == 0)
+	{
+		*_over_budget = 1;
+		goto fail_reserve;
+	}
+
+	// the driver may also report that the memory is
+	// exhausted which trimming or evicting may resolve
+	double   t0 = cc_timestamp();
+	VkResult result;
+	result = vkAllocateMemory(engine->device, &ma_info, NULL,
+	                          &self->memory);
+	if(result != VK_SUCCESS)
 	{
+		if((result == VK_ERROR_OUT_OF_DEVICE_MEMORY) ||
+		   (result == VK_ERROR_OUT_OF_HOST_MEMORY))
+		{
+			*_over_budget = 1;
+		}
+
 		LOGE("vkAllocateMemory failed");
 		goto fail_allocate;
 	}
+	vkk_memoryManager_recordAllocate(mm, type,
+	                                 cc_timestamp() - t0);
 
-	self->slots = cc_list_new();
-	if(self->slots == NULL)
+	// map host visible memory once for the chunk lifetime
+	VkMemoryPropertyFlags mp_flags;
+	mp_flags = mm->mp.memoryTypes[mt_index].propertyFlags;
+	if(mp_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
 	{
-		goto fail_slots;
-	}
+		self->host_visible = 1;
+		if((mp_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
+		{
+			self->non_coherent = 1;
+		}
 
-	// update performed by manager
-	++info->count_chunks;
-	info->size_chunks += (size_t) pool->stride*pool->count;
+		#if VKK_MEMORY_PERSISTENT_MAP
+		if(vkMapMemory(engine->device, self->memory, 0,
+		               VK_WHOLE_SIZE, 0,
+		               &self->ptr) != VK_SUCCESS)
+		{
+			LOGE("vkMapMemory failed");
+			goto fail_map;
+		}
+		#endif
+	}
 
 	// success
 	return self;
 
 	// failure
-	fail_slots:
+	#if VKK_MEMORY_PERSISTENT_MAP
+	fail_map:
 		vkFreeMemory(engine->device, self->memory, NULL);
+	#endif
 	fail_allocate:
+		vkk_memoryManager_release(mm, mt_index, type,
+		                          (size_t) size);
+	fail_reserve:
 		FREE(self);
 	return NULL;
 }
 
-void vkk_memoryChunk_delete(vkk_memoryChunk_t** _self,
-                            vkk_memoryInfo_t* info)
+static void
+vkk_memoryChunk_deleteChunk(vkk_memoryChunk_t** _self)
 {
 	ASSERT(_self);
-	ASSERT(info);
 
 	vkk_memoryChunk_t* self = *_self;
 	if(self)
 	{
-		ASSERT(self->usecount == 0);
-
-		vkk_memoryPool_t*    pool   = self->pool;
-		vkk_memoryManager_t* mm     = pool->mm;
-		vkk_engine_t*        engine = mm->engine;
-
-		// update performed by manager
-		++info->count_chunks;
-		info->size_chunks += (size_t) pool->stride*pool->count;
+		vkk_engine_t* engine = self->mm->engine;
 
-		cc_listIter_t* iter;
-		iter = cc_list_head(self->slots);
-		while(iter)
+		if(self->buffer != VK_NULL_HANDLE)
 		{
-			vkk_memory_t* memory;
-			memory = (vkk_memory_t*)
-			         cc_list_remove(self->slots, &iter);
-			vkk_memory_delete(&memory);
+			vkDestroyBuffer(engine->device, self->buffer, NULL);
+		}
+		if(self->ptr)
+		{
+			vkUnmapMemory(engine->device, self->memory);
 		}
-		cc_list_delete(&self->slots);
-
 		vkFreeMemory(engine->device, self->memory, NULL);
+		vkk_memoryManager_release(self->mm, self->mt_index,
+		                          self->type,
+		                          (size_t) self->size);
 		FREE(self);
 		*_self = NULL;
 	}
 }
 
-int vkk_memoryChunk_slots(vkk_memoryChunk_t* self)
+static int
+vkk_memoryChunk_newBuffer(vkk_memoryChunk_t* self)
 {
 	ASSERT(self);
 
-	vkk_memoryPool_t* pool = self->pool;
+	vkk_memoryPool_t* pool   = self->pool;
+	vkk_engine_t*     engine = self->mm->engine;
+
+	VkBufferCreateInfo b_info =
+	{
+		.sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext                 = NULL,
+		.flags                 = 0,
+		.size                  = self->size,
+		.usage                 = pool->usage,
+		.sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 1,
+		.pQueueFamilyIndices   = &engine->queue_family_index
+	};
 
-	// return slots available
-	return cc_list_size(self->slots) + (pool->count - self->slot);
+	if(vkCreateBuffer(engine->device, &b_info, NULL,
+	                  &self->buffer) != VK_SUCCESS)
+	{
+		LOGE("vkCreateBuffer failed");
+		return 0;
+	}
+
+	// the shared buffer must span the chunk memory
+	VkMemoryRequirements mr;
+	vkGetBufferMemoryRequirements(engine->device,
+	                              self->buffer, &mr);
+	if((mr.size > self->size) ||
+	   ((mr.memoryTypeBits & (1 << self->mt_index)) == 0))
+	{
+		LOGE("invalid size=%u, mr_size=%u, mt_index=%u",
+		     (uint32_t) self->size, (uint32_t) mr.size,
+		     self->mt_index);
+		goto fail_requirements;
+	}
+
+	if(vkBindBufferMemory(engine->device, self->buffer,
+	                      self->memory, 0) != VK_SUCCESS)
+	{
+		LOGE("vkBindBufferMemory failed");
+		goto fail_bind;
+	}
+
+	// success
+	return 1;
+
+	// failure
+	fail_bind:
+	fail_requirements:
+		vkDestroyBuffer(engine->device, self->buffer, NULL);
+		self->buffer = VK_NULL_HANDLE;
+	return 0;
 }
 
-vkk_memory_t*
-vkk_memoryChunk_alloc(vkk_memoryChunk_t* self,
-                      vkk_memoryInfo_t* info)
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+vkk_memoryChunk_t*
+vkk_memoryChunk_new(vkk_memoryPool_t* pool,
+                    VkDeviceSize size,
+                    vkk_memoryInfo_t* info,
+                    int* _over_budget)
 {
-	ASSERT(self);
+	ASSERT(pool);
 	ASSERT(info);
+	ASSERT(_over_budget);
 
-	vkk_memoryPool_t* pool = self->pool;
+	vkk_memoryChunk_t* self;
+	self = vkk_memoryChunk_newChunk(pool->mm, pool,
+	                                pool->mt_index,
+	                                pool->type, pool->priority,
+	                                size, NULL, _over_budget);
+	if(self == NULL)
+	{
+		return NULL;
+	}
 
-	// try to reuse an existing slot
-	vkk_memory_t* memory;
-	cc_listIter_t* iter = cc_list_head(self->slots);
-	if(iter)
+	// shared buffer pools
+	if(pool->usage && (vkk_memoryChunk_newBuffer(self) == 0))
 	{
-		memory = (vkk_memory_t*)
-		         cc_list_remove(self->slots, &iter);
-		++self->usecount;
+		goto fail_buffer;
+	}
 
-		// update performed by manager
-		++info->count_slots;
-		info->size_slots += (size_t) pool->stride;
+	// variable size chunks begin with a single free block
+	if(pool->stride == 0)
+	{
+		vkk_memoryBlock_t* block;
+		block = vkk_memoryChunk_newBlock(self, 0, size);
+		if(block == NULL)
+		{
+			goto fail_block;
+		}
+		vkk_memoryChunk_insertBlock(self, block);
+	}
+	else if(vkk_memoryChunk_newSlots(self) == 0)
+	{
+		goto fail_slots;
+	}
 
-		return memory;
+	// update performed by manager
+	++info->count_chunks;
+	info->size_chunks += (size_t) size;
+	if(self->buffer != VK_NULL_HANDLE)
+	{
+		++info->count_shared;
 	}
 
-	// check if the chunk is full
-	if(self->slot == pool->count)
+	// success
+	return self;
+
+	// failure
+	fail_slots:
+	fail_block:
+	fail_buffer:
+		vkk_memoryChunk_deleteChunk(&self);
+	return NULL;
+}
+
+vkk_memoryChunk_t*
+vkk_memoryChunk_newDedicated(vkk_memoryManager_t* mm,
+                             uint32_t mt_index,
+                             vkk_memoryType_e type,
+                             vkk_memoryPriority_e priority,
+                             VkDeviceSize size,
+                             VkBuffer buffer,
+                             VkImage image,
+                             vkk_memoryInfo_t* info,
+                             int* _over_budget)
+{
+	ASSERT(mm);
+	ASSERT(info);
+	ASSERT(_over_budget);
+
+	vkk_engine_t* engine = mm->engine;
+
+	// the dedicated allocation info is optional but may
+	// allow the driver to optimize the resource
+	VkMemoryDedicatedAllocateInfoKHR mda_info =
 	{
-		return NULL;
+		.sType  = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR,
+		.pNext  = NULL,
+		.image  = image,
+		.buffer = buffer
+	};
+
+	const void* ma_next = NULL;
+	if(engine->has_dedicated_allocation)
+	{
+		ma_next = &mda_info;
 	}
 
-	memory = vkk_memory_new(self, self->slot*pool->stride);
-	if(memory == NULL)
+	vkk_memoryChunk_t* self;
+	self = vkk_memoryChunk_newChunk(mm, NULL, mt_index, type,
+	                                priority, size, ma_next,
+	                                _over_budget);
+	if(self == NULL)
 	{
 		return NULL;
 	}
 
-	++self->slot;
-	++self->usecount;
-
 	// update performed by manager
-	++info->count_slots;
-	info->size_slots += (size_t) pool->stride;
+	++info->count_dedicated;
+	info->size_dedicated += (size_t) size;
+
+	return self;
+}
+
+void vkk_memoryChunk_delete(vkk_memoryChunk_t** _self,
+                            vkk_memoryInfo_t* info)
+{
+	ASSERT(_self);
+	ASSERT(info);
+
+	vkk_memoryChunk_t* self = *_self;
+	if(self)
+	{
+		ASSERT(self->usecount == 0);
+
+		// update performed by manager
+		if(self->pool)
+		{
+			++info->count_chunks;
+			info->size_chunks += (size_t) self->size;
+			if(self->buffer != VK_NULL_HANDLE)
+			{
+				++info->count_shared;
+			}
+		}
+		else
+		{
+			++info->count_dedicated;
+			info->size_dedicated += (size_t) self->size;
+		}
+
+		vkk_memoryChunk_deleteSlots(self);
+
+		// all blocks are free
+		while(self->fl_bitmap)
+		{
+			int fl;
+			int sl;
+			fl = __builtin_ctzll((unsigned long long) self->fl_bitmap);
+			sl = __builtin_ctz(self->sl_bitmap[fl]);
+
+			vkk_memoryBlock_t* block = self->blocks[fl][sl];
+			vkk_memoryChunk_removeBlock(self, block);
+			vkk_memoryChunk_deleteBlock(&block);
+		}
+
+		vkk_memoryChunk_deleteChunk(_self);
+	}
+}
+
+vkk_memory_t*
+vkk_memoryChunk_alloc(vkk_memoryChunk_t* self,
+                      VkMemoryRequirements* mr,
+                      vkk_memoryInfo_t* info)
+{
+	ASSERT(self);
+	ASSERT(mr);
+	ASSERT(info);
+
+	vkk_memoryPool_t* pool = self->pool;
+
+	if(pool == NULL)
+	{
+		// dedicated chunks contain a single memory object
+		if(self->usecount)
+		{
+			return NULL;
+		}
+
+		vkk_memory_t* memory;
+		memory = vkk_memory_new(self, 0, self->size);
+		if(memory == NULL)
+		{
+			return NULL;
+		}
+
+		++self->usecount;
+		self->size_used = self->size;
 
-	return memory;
+		return memory;
+	}
+	else if(pool->stride == 0)
+	{
+		return vkk_memoryChunk_allocBlock(self, mr, info);
+	}
+
+	return vkk_memoryChunk_allocSlot(self, info);
 }
 
 int vkk_memoryChunk_free(vkk_memoryChunk_t* self,
-                         int shutdown,
                          vkk_memory_t** _memory,
                          vkk_memoryInfo_t* info)
 {
@@ -212,21 +1116,19 @@ int vkk_memoryChunk_free(vkk_memoryChunk_t* self,
 	{
 		vkk_memoryPool_t* pool = self->pool;
 
-		--self->usecount;
-
-		// update performed by manager
-		++info->count_slots;
-		info->size_slots += (size_t) pool->stride;
-
-		if(shutdown)
+		if(pool == NULL)
 		{
+			--self->usecount;
+			self->size_used = 0;
 			vkk_memory_delete(&memory);
 		}
-		else if(cc_list_append(self->slots, NULL,
-		                       (const void*) memory) == NULL)
+		else if(pool->stride == 0)
 		{
-			LOGW("slot lost %u bytes", (uint32_t) pool->stride);
-			vkk_memory_delete(&memory);
+			vkk_memoryChunk_freeBlock(self, memory, info);
+		}
+		else
+		{
+			vkk_memoryChunk_freeSlot(self, memory, info);
 		}
 		*_memory = NULL;
 	}
@@ -238,10 +1140,8 @@ void vkk_memoryChunk_memoryInfo(vkk_memoryChunk_t* self)
 {
 	ASSERT(self);
 
-	vkk_memoryPool_t* pool = self->pool;
-
-	float usage = ((float) self->usecount)/
-	              ((float) pool->count);
-	LOGI("CHUNK: usecount=%i, usage=%0.1f",
-	     (int) self->usecount, usage);
+	float usage = ((float) self->size_used)/
+	              ((float) self->size);
+	LOGI("CHUNK: usecount=%i, usage=%0.1f, evacuate=%i",
+	     (int) self->usecount, usage, self->evacuate);
 }
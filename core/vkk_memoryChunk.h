@@ -26,29 +26,109 @@
 
 #include "vkk_memory.h"
 
+// TLSF (two-level segregated fit) parameters
+// variable size chunks suballocate blocks which are a
+// multiple of VKK_MEMORY_TLSF_ALIGN bytes and the free
+// blocks are binned by the first level (log2 of size) and
+// second level (linear subdivision of first level)
+#define VKK_MEMORY_TLSF_ALIGN   256
+#define VKK_MEMORY_TLSF_FL      64
+#define VKK_MEMORY_TLSF_SL_LOG2 4
+#define VKK_MEMORY_TLSF_SL      16
+
+typedef struct vkk_memoryBlock_s vkk_memoryBlock_t;
+
+// memory must be the first member since the memory handle
+// returned by vkk_memoryChunk_alloc is cast to a block
+typedef struct vkk_memoryBlock_s
+{
+	vkk_memory_t memory;
+
+	int is_free;
+
+	// physically adjacent blocks
+	vkk_memoryBlock_t* prev;
+	vkk_memoryBlock_t* next;
+
+	// free list
+	vkk_memoryBlock_t* prev_free;
+	vkk_memoryBlock_t* next_free;
+} vkk_memoryBlock_t;
+
 typedef struct vkk_memoryChunk_s
 {
+	vkk_memoryManager_t* mm;
+
+	// pool is NULL for dedicated chunks
 	vkk_memoryPool_t* pool;
+	uint32_t          mt_index;
+	vkk_memoryType_e  type;
 
 	int            locked;
 	int            updater;
-	uint32_t       slot;
 	uint32_t       usecount;
+	VkDeviceSize   size;
+	VkDeviceSize   size_used;
 	VkDeviceMemory memory;
 
-	// freed memory slots
-	cc_list_t* slots;
+	// persistently mapped host visible memory
+	// ptr is mapped on demand by vkk_memoryManager_map when
+	// VKK_MEMORY_PERSISTENT_MAP is disabled
+	int   host_visible;
+	void* ptr;
+
+	// shared buffer which spans the chunk memory
+	// (shared buffer pools only)
+	VkBuffer buffer;
+
+	// non-coherent host visible memory must be flushed
+	// after CPU writes and invalidated before CPU reads
+	// the dirty range is flushed by the manager on submit
+	// (see vkk_memoryManager_markDirty for the locking)
+	int            non_coherent;
+	VkDeviceSize   dirty_begin;
+	VkDeviceSize   dirty_end;
+	cc_listIter_t* dirty;
+
+	// iterator in the manager retained list when empty
+	cc_listIter_t* retained;
+
+	// sparse chunks are evacuated by the pool free and
+	// released rather than retained once empty
+	int evacuate;
+
+	// memory slots (fixed stride)
+	// slot_bitmap marks the slots in use and slot_hint is
+	// the first bitmap word which may contain a free slot
+	vkk_memory_t* slot_array;
+	uint64_t*     slot_bitmap;
+	uint32_t      slot_hint;
+
+	// free blocks (variable size)
+	uint64_t           fl_bitmap;
+	uint32_t           sl_bitmap[VKK_MEMORY_TLSF_FL];
+	vkk_memoryBlock_t* blocks[VKK_MEMORY_TLSF_FL][VKK_MEMORY_TLSF_SL];
 } vkk_memoryChunk_t;
 
 vkk_memoryChunk_t* vkk_memoryChunk_new(vkk_memoryPool_t* pool,
-                                       vkk_memoryInfo_t* info);
+                                       VkDeviceSize size,
+                                       vkk_memoryInfo_t* info,
+                                       int* _over_budget);
+vkk_memoryChunk_t* vkk_memoryChunk_newDedicated(vkk_memoryManager_t* mm,
+                                                uint32_t mt_index,
+                                                vkk_memoryType_e type,
+                                                vkk_memoryPriority_e priority,
+                                                VkDeviceSize size,
+                                                VkBuffer buffer,
+                                                VkImage image,
+                                                vkk_memoryInfo_t* info,
+                                                int* _over_budget);
 void               vkk_memoryChunk_delete(vkk_memoryChunk_t** _self,
                                           vkk_memoryInfo_t* info);
-int                vkk_memoryChunk_slots(vkk_memoryChunk_t* self);
 vkk_memory_t*      vkk_memoryChunk_alloc(vkk_memoryChunk_t* self,
+                                         VkMemoryRequirements* mr,
                                          vkk_memoryInfo_t* info);
 int                vkk_memoryChunk_free(vkk_memoryChunk_t* self,
-                                        int shutdown,
                                         vkk_memory_t** _memory,
                                         vkk_memoryInfo_t* info);
 void               vkk_memoryChunk_memoryInfo(vkk_memoryChunk_t* self);
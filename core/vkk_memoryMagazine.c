@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2023 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "vkk"
+#include "../../libcc/cc_log.h"
+#include "../../libcc/cc_memory.h"
+#include "vkk_memory.h"
+#include "vkk_memoryChunk.h"
+#include "vkk_memoryMagazine.h"
+#include "vkk_memoryPool.h"
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static vkk_memoryMagazineClass_t*
+vkk_memoryMagazine_findClass(vkk_memoryMagazine_t* self,
+                             const vkk_memoryPoolKey_t* key,
+                             int assign)
+{
+	ASSERT(self);
+	ASSERT(key);
+
+	// empty classes may be reassigned to a new class
+	vkk_memoryMagazineClass_t* empty = NULL;
+
+	int i;
+	for(i = 0; i < VKK_MEMORY_MAGAZINE_CLASSES; ++i)
+	{
+		vkk_memoryMagazineClass_t* mc = &self->classes[i];
+		if(memcmp(&mc->key, key, sizeof(vkk_memoryPoolKey_t)) == 0)
+		{
+			return mc;
+		}
+		else if((empty == NULL) && (mc->count == 0))
+		{
+			empty = mc;
+		}
+	}
+
+	if(assign && empty)
+	{
+		memcpy(&empty->key, key, sizeof(vkk_memoryPoolKey_t));
+	}
+
+	return empty;
+}
+
+static int vkk_memoryMagazine_bin(size_t size)
+{
+	if(size <= 1)
+	{
+		return 0;
+	}
+
+	// log2 of size
+	int bin = 63 - __builtin_clzll((unsigned long long) size);
+	if(bin >= VKK_MEMORY_HISTOGRAM_COUNT)
+	{
+		bin = VKK_MEMORY_HISTOGRAM_COUNT - 1;
+	}
+
+	return bin;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+vkk_memoryMagazine_t*
+vkk_memoryMagazine_new(vkk_memoryManager_t* mm)
+{
+	ASSERT(mm);
+
+	vkk_memoryMagazine_t* self;
+	self = (vkk_memoryMagazine_t*)
+	       CALLOC(1, sizeof(vkk_memoryMagazine_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	self->mm = mm;
+
+	if(pthread_mutex_init(&self->mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_mutex;
+	}
+
+	// success
+	return self;
+
+	// failure
+	fail_mutex:
+		FREE(self);
+	return NULL;
+}
+
+void vkk_memoryMagazine_delete(vkk_memoryMagazine_t** _self)
+{
+	ASSERT(_self);
+
+	vkk_memoryMagazine_t* self = *_self;
+	if(self)
+	{
+		// slots must be drained by the manager
+		#ifdef ASSERT_DEBUG
+		int i;
+		for(i = 0; i < VKK_MEMORY_MAGAZINE_CLASSES; ++i)
+		{
+			ASSERT(self->classes[i].count == 0);
+		}
+		#endif
+
+		pthread_mutex_destroy(&self->mutex);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+vkk_memory_t*
+vkk_memoryMagazine_get(vkk_memoryMagazine_t* self,
+                       const vkk_memoryPoolKey_t* key,
+                       uint32_t* _refill)
+{
+	ASSERT(self);
+	ASSERT(key);
+	ASSERT(_refill);
+
+	*_refill = 0;
+
+	pthread_mutex_lock(&self->mutex);
+
+	vkk_memoryMagazineClass_t* mc;
+	mc = vkk_memoryMagazine_findClass(self, key, 0);
+	if(mc == NULL)
+	{
+		// all classes are in use by other pool keys
+		pthread_mutex_unlock(&self->mutex);
+		return NULL;
+	}
+	else if(mc->count == 0)
+	{
+		// the caller should refill the class
+		*_refill = VKK_MEMORY_MAGAZINE_REFILL;
+		pthread_mutex_unlock(&self->mutex);
+		return NULL;
+	}
+
+	--mc->count;
+	vkk_memory_t* memory = mc->slots[mc->count];
+	mc->slots[mc->count] = NULL;
+
+	pthread_mutex_unlock(&self->mutex);
+
+	return memory;
+}
+
+void vkk_memoryMagazine_refill(vkk_memoryMagazine_t* self,
+                               const vkk_memoryPoolKey_t* key,
+                               uint32_t count,
+                               vkk_memory_t** slots)
+{
+	ASSERT(self);
+	ASSERT(key);
+	ASSERT(slots);
+
+	pthread_mutex_lock(&self->mutex);
+
+	// the class must be available since only the owner
+	// thread adds slots
+	vkk_memoryMagazineClass_t* mc;
+	mc = vkk_memoryMagazine_findClass(self, key, 1);
+	ASSERT(mc);
+	ASSERT(mc->count + count <= VKK_MEMORY_MAGAZINE_SIZE);
+
+	uint32_t i;
+	for(i = 0; i < count; ++i)
+	{
+		mc->slots[mc->count] = slots[i];
+		++mc->count;
+	}
+
+	pthread_mutex_unlock(&self->mutex);
+}
+
+int vkk_memoryMagazine_put(vkk_memoryMagazine_t* self,
+                           vkk_memory_t* memory,
+                           vkk_memoryBatch_t* batch)
+{
+	ASSERT(self);
+	ASSERT(memory);
+	ASSERT(batch);
+
+	batch->count = 0;
+
+	vkk_memoryPoolKey_t key;
+	vkk_memoryPool_key(memory->chunk->pool, &key);
+
+	pthread_mutex_lock(&self->mutex);
+
+	vkk_memoryMagazineClass_t* mc;
+	mc = vkk_memoryMagazine_findClass(self, &key, 1);
+	if(mc == NULL)
+	{
+		// the caller must return the slot to the pool
+		pthread_mutex_unlock(&self->mutex);
+		return 0;
+	}
+	else if(mc->count == VKK_MEMORY_MAGAZINE_SIZE)
+	{
+		// hand off the oldest slots so the caller may pass
+		// them to the depot rather than returning each slot
+		// to the pool under the manager lock
+		memcpy(&batch->key, &key, sizeof(vkk_memoryPoolKey_t));
+
+		uint32_t i;
+		for(i = 0; i < VKK_MEMORY_MAGAZINE_BATCH; ++i)
+		{
+			batch->slots[i] = mc->slots[i];
+		}
+		batch->count = VKK_MEMORY_MAGAZINE_BATCH;
+
+		for(i = VKK_MEMORY_MAGAZINE_BATCH; i < mc->count; ++i)
+		{
+			mc->slots[i - VKK_MEMORY_MAGAZINE_BATCH] = mc->slots[i];
+			mc->slots[i] = NULL;
+		}
+		mc->count -= VKK_MEMORY_MAGAZINE_BATCH;
+	}
+
+	mc->slots[mc->count] = memory;
+	++mc->count;
+
+	pthread_mutex_unlock(&self->mutex);
+
+	return 1;
+}
+
+uint32_t vkk_memoryMagazine_drain(vkk_memoryMagazine_t* self,
+                                  vkk_memory_t** slots)
+{
+	ASSERT(self);
+	ASSERT(slots);
+
+	pthread_mutex_lock(&self->mutex);
+
+	// drain the first non-empty class
+	uint32_t count = 0;
+	int      i;
+	for(i = 0; i < VKK_MEMORY_MAGAZINE_CLASSES; ++i)
+	{
+		vkk_memoryMagazineClass_t* mc = &self->classes[i];
+		if(mc->count)
+		{
+			for(count = 0; count < mc->count; ++count)
+			{
+				slots[count] = mc->slots[count];
+				mc->slots[count] = NULL;
+			}
+			mc->count = 0;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&self->mutex);
+
+	return count;
+}
+
+uint32_t vkk_memoryMagazine_purge(vkk_memoryMagazine_t* self,
+                                  vkk_memory_t** slots)
+{
+	ASSERT(self);
+	ASSERT(slots);
+
+	pthread_mutex_lock(&self->mutex);
+
+	// remove the slots of evacuated chunks from the first
+	// class which contains any
+	uint32_t count = 0;
+	int      i;
+	for(i = 0; i < VKK_MEMORY_MAGAZINE_CLASSES; ++i)
+	{
+		vkk_memoryMagazineClass_t* mc = &self->classes[i];
+
+		uint32_t j = 0;
+		uint32_t k;
+		for(k = 0; k < mc->count; ++k)
+		{
+			vkk_memory_t* memory = mc->slots[k];
+			if(memory->chunk->evacuate)
+			{
+				slots[count] = memory;
+				++count;
+			}
+			else
+			{
+				mc->slots[j] = memory;
+				++j;
+			}
+		}
+
+		for(k = j; k < mc->count; ++k)
+		{
+			mc->slots[k] = NULL;
+		}
+		mc->count = j;
+
+		if(count)
+		{
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&self->mutex);
+
+	return count;
+}
+
+void vkk_memoryMagazine_recordAlloc(vkk_memoryMagazine_t* self,
+                                    vkk_memoryType_e type,
+                                    size_t requested,
+                                    size_t allocated)
+{
+	ASSERT(self);
+
+	int b0 = vkk_memoryMagazine_bin(requested);
+	int b1 = vkk_memoryMagazine_bin(allocated);
+
+	pthread_mutex_lock(&self->mutex);
+
+	vkk_memoryStats_t* stats = &self->stats[type];
+	++stats->count_alloc;
+	stats->size_requested += requested;
+	stats->size_allocated += allocated;
+	++stats->histogram_requested[b0];
+	++stats->histogram_allocated[b1];
+
+	pthread_mutex_unlock(&self->mutex);
+}
+
+void vkk_memoryMagazine_recordFree(vkk_memoryMagazine_t* self,
+                                   vkk_memoryType_e type)
+{
+	ASSERT(self);
+
+	pthread_mutex_lock(&self->mutex);
+	++self->stats[type].count_free;
+	pthread_mutex_unlock(&self->mutex);
+}
+
+void vkk_memoryMagazine_stats(vkk_memoryMagazine_t* self,
+                              vkk_memoryType_e type,
+                              vkk_memoryStats_t* stats)
+{
+	ASSERT(self);
+	ASSERT(stats);
+
+	pthread_mutex_lock(&self->mutex);
+
+	// accumulate the allocation stats for the type
+	int t;
+	for(t = 0; t < VKK_MEMORY_TYPE_COUNT; ++t)
+	{
+		if((type != VKK_MEMORY_TYPE_ANY) && (type != t))
+		{
+			continue;
+		}
+
+		vkk_memoryStats_t* src = &self->stats[t];
+		stats->count_alloc    += src->count_alloc;
+		stats->count_free     += src->count_free;
+		stats->size_requested += src->size_requested;
+		stats->size_allocated += src->size_allocated;
+
+		int i;
+		for(i = 0; i < VKK_MEMORY_HISTOGRAM_COUNT; ++i)
+		{
+			stats->histogram_requested[i] += src->histogram_requested[i];
+			stats->histogram_allocated[i] += src->histogram_allocated[i];
+		}
+	}
+
+	pthread_mutex_unlock(&self->mutex);
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2023 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef vkk_memoryMagazine_H
+#define vkk_memoryMagazine_H
+
+#include <pthread.h>
+
+#include "../../libcc/cc_list.h"
+#include "vkk_memory.h"
+#include "vkk_memoryPool.h"
+
+// each thread caches up to VKK_MEMORY_MAGAZINE_SIZE fixed
+// stride slots for up to VKK_MEMORY_MAGAZINE_CLASSES
+// pool key classes and an empty magazine class is
+// refilled with VKK_MEMORY_MAGAZINE_REFILL slots
+#ifndef VKK_MEMORY_MAGAZINE_CLASSES
+#define VKK_MEMORY_MAGAZINE_CLASSES 8
+#endif
+
+#ifndef VKK_MEMORY_MAGAZINE_SIZE
+#define VKK_MEMORY_MAGAZINE_SIZE 32
+#endif
+
+#ifndef VKK_MEMORY_MAGAZINE_REFILL
+#define VKK_MEMORY_MAGAZINE_REFILL (VKK_MEMORY_MAGAZINE_SIZE/2)
+#endif
+
+// a full magazine class hands off the oldest
+// VKK_MEMORY_MAGAZINE_BATCH slots as a batch which the
+// manager passes to other threads through the depot
+#ifndef VKK_MEMORY_MAGAZINE_BATCH
+#define VKK_MEMORY_MAGAZINE_BATCH (VKK_MEMORY_MAGAZINE_SIZE/2)
+#endif
+
+typedef struct
+{
+	vkk_memoryPoolKey_t key;
+	uint32_t            count;
+	vkk_memory_t*       slots[VKK_MEMORY_MAGAZINE_BATCH];
+} vkk_memoryBatch_t;
+
+typedef struct
+{
+	vkk_memoryPoolKey_t key;
+	uint32_t            count;
+	vkk_memory_t*       slots[VKK_MEMORY_MAGAZINE_SIZE];
+} vkk_memoryMagazineClass_t;
+
+typedef struct vkk_memoryMagazine_s
+{
+	vkk_memoryManager_t* mm;
+
+	// iterator in the manager magazine list
+	cc_listIter_t* iter;
+
+	// the owner thread is the only thread which adds slots
+	// but the manager may drain slots from any thread
+	pthread_mutex_t mutex;
+
+	vkk_memoryMagazineClass_t classes[VKK_MEMORY_MAGAZINE_CLASSES];
+
+	// per-thread allocation stats which are merged by the
+	// manager to avoid contention on the manager lock
+	vkk_memoryStats_t stats[VKK_MEMORY_TYPE_COUNT];
+} vkk_memoryMagazine_t;
+
+vkk_memoryMagazine_t* vkk_memoryMagazine_new(vkk_memoryManager_t* mm);
+void                  vkk_memoryMagazine_delete(vkk_memoryMagazine_t** _self);
+vkk_memory_t*         vkk_memoryMagazine_get(vkk_memoryMagazine_t* self,
+                                             const vkk_memoryPoolKey_t* key,
+                                             uint32_t* _refill);
+void                  vkk_memoryMagazine_refill(vkk_memoryMagazine_t* self,
+                                                const vkk_memoryPoolKey_t* key,
+                                                uint32_t count,
+                                                vkk_memory_t** slots);
+int                   vkk_memoryMagazine_put(vkk_memoryMagazine_t* self,
+                                             vkk_memory_t* memory,
+                                             vkk_memoryBatch_t* batch);
+uint32_t              vkk_memoryMagazine_drain(vkk_memoryMagazine_t* self,
+                                               vkk_memory_t** slots);
+uint32_t              vkk_memoryMagazine_purge(vkk_memoryMagazine_t* self,
+                                               vkk_memory_t** slots);
+void                  vkk_memoryMagazine_recordAlloc(vkk_memoryMagazine_t* self,
+                                                     vkk_memoryType_e type,
+                                                     size_t requested,
+                                                     size_t allocated);
+void                  vkk_memoryMagazine_recordFree(vkk_memoryMagazine_t* self,
+                                                    vkk_memoryType_e type);
+void                  vkk_memoryMagazine_stats(vkk_memoryMagazine_t* self,
+                                               vkk_memoryType_e type,
+                                               vkk_memoryStats_t* stats);
+
+#endif
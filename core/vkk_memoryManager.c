@@ -22,6 +22,7 @@
  */
 
 #include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
@@ -32,14 +33,10 @@
 #include "vkk_engine.h"
 #include "vkk_memory.h"
 #include "vkk_memoryChunk.h"
+#include "vkk_memoryMagazine.h"
 #include "vkk_memoryManager.h"
 #include "vkk_memoryPool.h"
-
-typedef struct
-{
-	uint32_t mt_index;
-	uint32_t stride;
-} vkk_memoryPoolKey_t;
+#include "vkk_util.h"
 
 /***********************************************************
 * private                                                  *
@@ -55,10 +52,13 @@ vkk_memoryManager_addInfo(vkk_memoryManager_t* self,
 
 	vkk_memoryInfo_t* pinfo = &self->info[type];
 
-	pinfo->count_chunks += info->count_chunks;
-	pinfo->count_slots  += info->count_slots;
-	pinfo->size_chunks  += info->size_chunks;
-	pinfo->size_slots   += info->size_slots;
+	pinfo->count_chunks    += info->count_chunks;
+	pinfo->count_slots     += info->count_slots;
+	pinfo->count_dedicated += info->count_dedicated;
+	pinfo->count_shared    += info->count_shared;
+	pinfo->size_chunks     += info->size_chunks;
+	pinfo->size_slots      += info->size_slots;
+	pinfo->size_dedicated  += info->size_dedicated;
 }
 
 static void
@@ -71,10 +71,13 @@ vkk_memoryManager_subInfo(vkk_memoryManager_t* self,
 
 	vkk_memoryInfo_t* pinfo = &self->info[type];
 
-	pinfo->count_chunks -= info->count_chunks;
-	pinfo->count_slots  -= info->count_slots;
-	pinfo->size_chunks  -= info->size_chunks;
-	pinfo->size_slots   -= info->size_slots;
+	pinfo->count_chunks    -= info->count_chunks;
+	pinfo->count_slots     -= info->count_slots;
+	pinfo->count_dedicated -= info->count_dedicated;
+	pinfo->count_shared    -= info->count_shared;
+	pinfo->size_chunks     -= info->size_chunks;
+	pinfo->size_slots      -= info->size_slots;
+	pinfo->size_dedicated  -= info->size_dedicated;
 }
 
 static void
@@ -134,30 +137,29 @@ vkk_memoryManager_chunkUnlock(vkk_memoryManager_t* self,
 	pthread_cond_broadcast(&self->chunk_cond[u]);
 }
 
-static int
+static void
 vkk_memoryManager_poolLock(vkk_memoryManager_t* self,
                            vkk_memoryPool_t* pool)
 {
 	ASSERT(self);
 	ASSERT(pool);
 
-	// check if the pool is already locked
-	// note that the pool may not exist after waiting
-	// so the caller must check if the pool exists
-	// before retrying the lock
-	if(pool->locked)
+	pthread_mutex_lock(&pool->pool_mutex);
+	TRACE_BEGIN();
+}
+
+static int
+vkk_memoryManager_poolTryLock(vkk_memoryManager_t* self,
+                              vkk_memoryPool_t* pool)
+{
+	ASSERT(self);
+	ASSERT(pool);
+
+	if(pthread_mutex_trylock(&pool->pool_mutex) != 0)
 	{
-		TRACE_END();
-		pthread_cond_wait(&self->pool_cond,
-		                  &self->manager_mutex);
-		TRACE_BEGIN();
 		return 0;
 	}
-
-	pool->locked = 1;
-
-	TRACE_END();
-	pthread_mutex_unlock(&self->manager_mutex);
+	TRACE_BEGIN();
 
 	return 1;
 }
@@ -169,311 +171,2415 @@ vkk_memoryManager_poolUnlock(vkk_memoryManager_t* self,
 	ASSERT(self);
 	ASSERT(pool);
 
-	pthread_mutex_lock(&self->manager_mutex);
-	TRACE_BEGIN();
-
-	pool->locked = 0;
+	TRACE_END();
+	pthread_mutex_unlock(&pool->pool_mutex);
+}
 
-	pthread_cond_broadcast(&self->pool_cond);
+static void
+vkk_memoryManager_mappedRange(vkk_memoryManager_t* self,
+                              vkk_memoryChunk_t* chunk,
+                              VkDeviceSize begin,
+                              VkDeviceSize end,
+                              VkMappedMemoryRange* range)
+{
+	ASSERT(self);
+	ASSERT(chunk);
+	ASSERT(range);
+
+	// ranges must be aligned to the nonCoherentAtomSize
+	// unless they extend to the end of the allocation
+	VkDeviceSize atom = self->atom_size;
+	begin = (begin/atom)*atom;
+	end   = ((end + atom - 1)/atom)*atom;
+
+	range->sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range->pNext  = NULL;
+	range->memory = chunk->memory;
+	range->offset = begin;
+	range->size   = end - begin;
+	if(end >= chunk->size)
+	{
+		range->size = VK_WHOLE_SIZE;
+	}
 }
 
-static size_t computePoolCount(size_t stride)
+static void
+vkk_memoryManager_markDirty(vkk_memoryManager_t* self,
+                            vkk_memory_t* memory,
+                            size_t offset,
+                            size_t size)
 {
-	ASSERT(stride > 0);
+	ASSERT(self);
+	ASSERT(memory);
 
-	// enforce allocation size
-	size_t MB    = 1024*1024;
-	size_t count = 256;
-	size_t size  = stride*count;
-	if(size >= 16*MB)
+	vkk_memoryChunk_t* chunk = memory->chunk;
+
+	VkDeviceSize begin = memory->offset + offset;
+	VkDeviceSize end   = begin + size;
+
+	// extend the dirty range of the chunk which is flushed
+	// by the next submit
+	int u = chunk->updater;
+	pthread_mutex_lock(&self->chunk_mutex[u]);
+	if(chunk->dirty)
 	{
-		// allocate at most 16MB
-		count = 16*MB/stride;
+		if(begin < chunk->dirty_begin)
+		{
+			chunk->dirty_begin = begin;
+		}
+		if(end > chunk->dirty_end)
+		{
+			chunk->dirty_end = end;
+		}
+		pthread_mutex_unlock(&self->chunk_mutex[u]);
+		return;
 	}
-	else if(size < 2*MB)
+	pthread_mutex_unlock(&self->chunk_mutex[u]);
+
+	// link the chunk into the dirty list and check again
+	// since the chunk may have been linked by another
+	// thread while unlocked
+	pthread_mutex_lock(&self->dirty_mutex);
+	pthread_mutex_lock(&self->chunk_mutex[u]);
+	if(chunk->dirty)
 	{
-		// allocate at least 2MB
-		count = 2*MB/stride;
+		if(begin < chunk->dirty_begin)
+		{
+			chunk->dirty_begin = begin;
+		}
+		if(end > chunk->dirty_end)
+		{
+			chunk->dirty_end = end;
+		}
 	}
+	else
+	{
+		chunk->dirty = cc_list_append(self->dirty, NULL,
+		                              (const void*) chunk);
+		if(chunk->dirty == NULL)
+		{
+			// flush immediately
+			VkMappedMemoryRange range;
+			vkk_memoryManager_mappedRange(self, chunk, begin, end,
+			                              &range);
+			vkFlushMappedMemoryRanges(self->engine->device, 1,
+			                          &range);
+		}
+		else
+		{
+			chunk->dirty_begin = begin;
+			chunk->dirty_end   = end;
+		}
+	}
+	pthread_mutex_unlock(&self->chunk_mutex[u]);
+	pthread_mutex_unlock(&self->dirty_mutex);
+}
 
-	// enforce minimum count
-	if(count == 0)
+static char*
+vkk_memoryManager_mapChunk(vkk_memoryManager_t* self,
+                           vkk_memoryChunk_t* chunk)
+{
+	ASSERT(self);
+	ASSERT(chunk);
+
+	#if VKK_MEMORY_PERSISTENT_MAP
+	return (char*) chunk->ptr;
+	#else
+	// map the chunk on demand for the chunk lifetime when
+	// the mapped pointer is held by the caller (readback)
+	vkk_engine_t* engine = self->engine;
+	vkk_memoryManager_chunkLock(self, chunk);
+	if((chunk->ptr == NULL) && chunk->host_visible)
 	{
-		count = 1;
+		if(vkMapMemory(engine->device, chunk->memory, 0,
+		               VK_WHOLE_SIZE, 0,
+		               &chunk->ptr) != VK_SUCCESS)
+		{
+			LOGE("vkMapMemory failed");
+			chunk->ptr = NULL;
+		}
 	}
+	char* data = (char*) chunk->ptr;
+	vkk_memoryManager_chunkUnlock(self, chunk);
+	return data;
+	#endif
+}
 
-	return count;
+static char*
+vkk_memoryManager_beginAccess(vkk_memoryManager_t* self,
+                              vkk_memoryChunk_t* chunk)
+{
+	ASSERT(self);
+	ASSERT(chunk);
+
+	#if VKK_MEMORY_PERSISTENT_MAP
+	// chunk is persistently mapped so the chunk lock is not
+	// required when updating an independent slot
+	return (char*) chunk->ptr;
+	#else
+	// legacy path which maps the chunk for each access
+	// unless the chunk was mapped by vkk_memoryManager_map
+	vkk_engine_t* engine = self->engine;
+	vkk_memoryManager_chunkLock(self, chunk);
+	if(chunk->ptr)
+	{
+		return (char*) chunk->ptr;
+	}
+
+	void* data;
+	if(vkMapMemory(engine->device, chunk->memory, 0,
+	               VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+	{
+		LOGE("vkMapMemory failed");
+		vkk_memoryManager_chunkUnlock(self, chunk);
+		return NULL;
+	}
+	return (char*) data;
+	#endif
 }
 
-static vkk_memory_t*
-vkk_memoryManager_alloc(vkk_memoryManager_t* self,
-                        VkMemoryRequirements* mr,
-                        VkFlags mp_flags,
-                        vkk_memoryType_e type)
+static void
+vkk_memoryManager_endAccess(vkk_memoryManager_t* self,
+                            vkk_memory_t* memory,
+                            size_t offset,
+                            size_t size,
+                            int write)
 {
 	ASSERT(self);
-	ASSERT(mr);
+	ASSERT(memory);
 
-	vkk_memoryManager_lock(self);
+	vkk_memoryChunk_t* chunk = memory->chunk;
 
+	#if VKK_MEMORY_PERSISTENT_MAP
+	if(write && chunk->non_coherent)
+	{
+		vkk_memoryManager_markDirty(self, memory, offset, size);
+	}
+	#else
+	// the write is flushed immediately since the memory may
+	// be unmapped before the next submit
 	vkk_engine_t* engine = self->engine;
+	if(write && chunk->non_coherent)
+	{
+		VkMappedMemoryRange range;
+		vkk_memoryManager_mappedRange(self, chunk,
+		                              memory->offset + offset,
+		                              memory->offset + offset + size,
+		                              &range);
+		if(vkFlushMappedMemoryRanges(engine->device, 1,
+		                             &range) != VK_SUCCESS)
+		{
+			LOGW("vkFlushMappedMemoryRanges failed");
+		}
+	}
 
-	uint32_t mt_index;
-	if(vkk_engine_getMemoryTypeIndex(engine,
-	                                 mr->memoryTypeBits,
-	                                 mp_flags,
-	                                 &mt_index) == 0)
+	if(chunk->ptr == NULL)
 	{
-		LOGE("invalid memory type");
-		goto fail_memory_type;
+		vkUnmapMemory(engine->device, chunk->memory);
 	}
+	vkk_memoryManager_chunkUnlock(self, chunk);
+	#endif
+}
 
-	// compute the pool stride
-	VkDeviceSize stride = mr->alignment;
-	while(stride < mr->size)
+static void
+vkk_memoryManager_undirty(vkk_memoryManager_t* self,
+                          vkk_memoryChunk_t* chunk)
+{
+	ASSERT(self);
+	ASSERT(chunk);
+
+	// the memory of deleted chunks does not need a flush
+	pthread_mutex_lock(&self->dirty_mutex);
+	if(chunk->dirty)
 	{
-		stride *= 2;
+		cc_list_remove(self->dirty, &chunk->dirty);
 	}
+	pthread_mutex_unlock(&self->dirty_mutex);
+}
 
-	vkk_memoryPoolKey_t key =
+static void
+vkk_memoryManager_deleteChunk(vkk_memoryManager_t* self,
+                              vkk_memoryChunk_t** _chunk,
+                              vkk_memoryInfo_t* info)
+{
+	ASSERT(self);
+	ASSERT(_chunk);
+	ASSERT(info);
+
+	// the pool and the info mutex must be locked
+
+	vkk_memoryChunk_t* chunk = *_chunk;
+	vkk_memoryPool_t*  pool  = chunk->pool;
+
+	vkk_memoryManager_undirty(self, chunk);
+
+	// evacuated chunks are released rather than retained
+	if(chunk->evacuate)
 	{
-		.mt_index = (uint32_t) mt_index,
-		.stride   = (uint32_t) stride
-	};
+		vkk_memoryInfo_t* pinfo = &self->info[chunk->type];
+		++pinfo->count_reclaimed;
+		pinfo->size_reclaimed += (size_t) chunk->size;
+	}
 
-	// find an existing pool
-	int locked       = 0;
-	int pool_created = 0;
-	cc_mapIter_t*     miter;
-	vkk_memoryPool_t* pool;
-	while(locked == 0)
+	// empty pools persist for the manager lifetime
+	vkk_memoryPool_removeChunk(pool, chunk);
+
+	vkk_memoryChunk_delete(_chunk, info);
+}
+
+static void
+vkk_memoryManager_unretain(vkk_memoryManager_t* self,
+                           vkk_memoryChunk_t* chunk)
+{
+	ASSERT(self);
+	ASSERT(chunk);
+
+	// the pool and the info mutex must be locked
+
+	vkk_memoryType_e  type  = chunk->type;
+	vkk_memoryInfo_t* pinfo = &self->info[type];
+
+	if(chunk->retained)
 	{
-		miter = cc_map_findp(self->pools,
-		                     sizeof(vkk_memoryPoolKey_t), &key);
-		if(miter == NULL)
-		{
-			// otherwise create a new pool
-			uint32_t count = computePoolCount((size_t) stride);
-			pool = vkk_memoryPool_new(self, count, stride, mt_index,
-			                          type);
-			if(pool == NULL)
-			{
-				goto fail_pool;
-			}
-			pool_created = 1;
+		cc_list_remove(self->retained[type], &chunk->retained);
+		--pinfo->count_retained;
+		pinfo->size_retained -= (size_t) chunk->size;
+	}
+}
 
-			miter = cc_map_addp(self->pools, (const void*) pool,
-			                    sizeof(vkk_memoryPoolKey_t),
-			                    &key);
-			if(miter == NULL)
-			{
-				goto fail_add;
-			}
-		}
-		else
+static void
+vkk_memoryManager_trimType(vkk_memoryManager_t* self,
+                           vkk_memoryType_e type,
+                           size_t budget)
+{
+	ASSERT(self);
+
+	// the info mutex must be locked
+
+	vkk_memoryInfo_t* pinfo = &self->info[type];
+	vkk_memoryInfo_t  info  = { 0 };
+
+	// release the least recently emptied chunks first
+	cc_listIter_t* iter = cc_list_head(self->retained[type]);
+	while(iter && (pinfo->size_retained > budget))
+	{
+		vkk_memoryChunk_t* chunk;
+		chunk = (vkk_memoryChunk_t*) cc_list_peekIter(iter);
+		iter  = cc_list_next(iter);
+
+		// chunks in locked pools are skipped since the pool
+		// may be allocating from the chunk and the pool lock
+		// is acquired before the info mutex
+		vkk_memoryPool_t* pool = chunk->pool;
+		if(vkk_memoryManager_poolTryLock(self, pool) == 0)
 		{
-			pool = (vkk_memoryPool_t*) cc_map_val(miter);
+			continue;
 		}
+		ASSERT(chunk->usecount == 0);
 
-		locked = vkk_memoryManager_poolLock(self, pool);
+		vkk_memoryManager_unretain(self, chunk);
+		vkk_memoryManager_deleteChunk(self, &chunk, &info);
+		vkk_memoryManager_poolUnlock(self, pool);
 	}
 
-	// memory is unitialized
-	vkk_memoryInfo_t info   = { 0 };
-	vkk_memory_t*    memory = vkk_memoryPool_alloc(pool, &info);
-	if(memory == NULL)
+	vkk_memoryManager_subInfo(self, type, &info);
+}
+
+static void
+vkk_memoryManager_retain(vkk_memoryManager_t* self,
+                         vkk_memoryChunk_t* chunk)
+{
+	ASSERT(self);
+	ASSERT(chunk);
+
+	// the pool and the info mutex must be locked
+
+	vkk_memoryType_e  type  = chunk->type;
+	vkk_memoryInfo_t* pinfo = &self->info[type];
+
+	// empty chunks remain in the pool and are appended to
+	// the tail of the LRU list
+	chunk->retained = cc_list_append(self->retained[type], NULL,
+	                                 (const void*) chunk);
+	if(chunk->retained == NULL)
 	{
-		vkk_memoryManager_poolUnlock(self, pool);
-		goto fail_alloc;
+		// release the chunk immediately
+		vkk_memoryInfo_t info = { 0 };
+		vkk_memoryManager_deleteChunk(self, &chunk, &info);
+		vkk_memoryManager_subInfo(self, type, &info);
+		return;
 	}
-	vkk_memoryManager_poolUnlock(self, pool);
-	vkk_memoryManager_addInfo(self, type, &info);
-	vkk_memoryManager_unlock(self);
+	++pinfo->count_retained;
+	pinfo->size_retained += (size_t) chunk->size;
 
-	// success
-	return memory;
+	size_t budget = VKK_MEMORY_RETAIN_SIZE;
+	if(self->shutdown)
+	{
+		budget = 0;
+	}
+	vkk_memoryManager_trimType(self, type, budget);
+}
 
-	// failure
-	fail_alloc:
+static int
+vkk_memoryManager_freeSlot(vkk_memoryManager_t* self,
+                           vkk_memory_t** _memory)
+{
+	ASSERT(self);
+	ASSERT(_memory);
+
+	vkk_memory_t*    memory = *_memory;
+	vkk_memoryInfo_t info   = { 0 };
+
+	// free the memory and retain the chunk (if empty)
+	// under the pool lock which does not require the
+	// manager lock
+	vkk_memoryPool_t* pool = memory->chunk->pool;
+	vkk_memoryType_e  type = pool->type;
+	vkk_memoryManager_poolLock(self, pool);
+
+	// the pool may evacuate the chunk when it becomes sparse
+	vkk_memoryChunk_t* owner    = memory->chunk;
+	int                evacuate = owner->evacuate;
+
+	vkk_memoryChunk_t* chunk = NULL;
+	vkk_memoryPool_free(pool, _memory, &chunk, &info);
+	int purge = (evacuate == 0) && owner->evacuate;
+
+	pthread_mutex_lock(&self->info_mutex);
+	vkk_memoryManager_subInfo(self, type, &info);
+	if(chunk && chunk->evacuate)
 	{
-		if(pool_created)
-		{
-			cc_map_remove(self->pools, &miter);
-		}
+		// release the evacuated chunk immediately
+		vkk_memoryInfo_t chunk_info = { 0 };
+		vkk_memoryManager_deleteChunk(self, &chunk,
+		                              &chunk_info);
+		vkk_memoryManager_subInfo(self, type, &chunk_info);
+	}
+	else if(chunk)
+	{
+		vkk_memoryManager_retain(self, chunk);
 	}
-	fail_add:
+	pthread_mutex_unlock(&self->info_mutex);
+
+	vkk_memoryManager_poolUnlock(self, pool);
+
+	// the cached slots of the evacuated chunk must be
+	// purged by the caller (see vkk_memoryManager_purge)
+	return purge;
+}
+
+static void
+vkk_memoryManager_drainMagazine(vkk_memoryManager_t* self,
+                                vkk_memoryMagazine_t* magazine)
+{
+	ASSERT(self);
+	ASSERT(magazine);
+
+	// the manager must be locked
+	vkk_memory_t* slots[VKK_MEMORY_MAGAZINE_SIZE];
+	uint32_t      count;
+	count = vkk_memoryMagazine_drain(magazine, slots);
+	while(count)
 	{
-		if(pool_created)
+		uint32_t i;
+		for(i = 0; i < count; ++i)
 		{
-			vkk_memoryPool_delete(&pool);
+			if(vkk_memoryManager_freeSlot(self, &slots[i]))
+			{
+				self->purge = 1;
+			}
 		}
+		count = vkk_memoryMagazine_drain(magazine, slots);
 	}
-	fail_pool:
-	fail_memory_type:
+}
+
+static int
+vkk_memoryManager_depotPush(vkk_memoryManager_t* self,
+                            vkk_memoryBatch_t* batch)
+{
+	ASSERT(self);
+	ASSERT(batch);
+
+	pthread_mutex_lock(&self->depot_mutex);
+
+	if(self->depot_count == VKK_MEMORY_DEPOT_SIZE)
 	{
-		vkk_memoryManager_unlock(self);
-		LOGE("alloc failed");
+		// the caller must return the batch to the pools
+		pthread_mutex_unlock(&self->depot_mutex);
+		return 0;
 	}
-	return NULL;
-}
 
-/***********************************************************
-* public                                                   *
-***********************************************************/
+	memcpy(&self->depot[self->depot_count], batch,
+	       sizeof(vkk_memoryBatch_t));
+	++self->depot_count;
 
-vkk_memoryManager_t*
-vkk_memoryManager_new(vkk_engine_t* engine)
-{
-	ASSERT(engine);
+	pthread_mutex_unlock(&self->depot_mutex);
+
+	return 1;
+}
+
+static int
+vkk_memoryManager_depotPop(vkk_memoryManager_t* self,
+                           const vkk_memoryPoolKey_t* key,
+                           vkk_memoryBatch_t* batch)
+{
+	ASSERT(self);
+	ASSERT(batch);
+
+	pthread_mutex_lock(&self->depot_mutex);
+
+	// pop the newest batch for the key or any batch when
+	// the key is NULL
+	uint32_t i = self->depot_count;
+	while(i > 0)
+	{
+		--i;
+
+		vkk_memoryBatch_t* b = &self->depot[i];
+		if(key && memcmp(&b->key, key,
+		                 sizeof(vkk_memoryPoolKey_t)))
+		{
+			continue;
+		}
+
+		memcpy(batch, b, sizeof(vkk_memoryBatch_t));
+
+		--self->depot_count;
+		if(i != self->depot_count)
+		{
+			memcpy(b, &self->depot[self->depot_count],
+			       sizeof(vkk_memoryBatch_t));
+		}
+
+		pthread_mutex_unlock(&self->depot_mutex);
+		return 1;
+	}
+
+	pthread_mutex_unlock(&self->depot_mutex);
+
+	return 0;
+}
+
+static int
+vkk_memoryManager_freeBatch(vkk_memoryManager_t* self,
+                            vkk_memoryBatch_t* batch)
+{
+	ASSERT(self);
+	ASSERT(batch);
+
+	int      purge = 0;
+	uint32_t i;
+	for(i = 0; i < batch->count; ++i)
+	{
+		if(vkk_memoryManager_freeSlot(self, &batch->slots[i]))
+		{
+			purge = 1;
+		}
+	}
+	batch->count = 0;
+
+	return purge;
+}
+
+static uint32_t
+vkk_memoryManager_depotPurge(vkk_memoryManager_t* self,
+                             vkk_memory_t** slots)
+{
+	ASSERT(self);
+	ASSERT(slots);
+
+	pthread_mutex_lock(&self->depot_mutex);
+
+	// remove the slots of evacuated chunks from the first
+	// batch which contains any and remove the batch when
+	// it becomes empty
+	uint32_t count = 0;
+	uint32_t i;
+	for(i = 0; i < self->depot_count; ++i)
+	{
+		vkk_memoryBatch_t* b = &self->depot[i];
+
+		uint32_t j = 0;
+		uint32_t k;
+		for(k = 0; k < b->count; ++k)
+		{
+			vkk_memory_t* memory = b->slots[k];
+			if(memory->chunk->evacuate)
+			{
+				slots[count] = memory;
+				++count;
+			}
+			else
+			{
+				b->slots[j] = memory;
+				++j;
+			}
+		}
+		b->count = j;
+
+		if(count)
+		{
+			if(b->count == 0)
+			{
+				--self->depot_count;
+				if(i != self->depot_count)
+				{
+					memcpy(b, &self->depot[self->depot_count],
+					       sizeof(vkk_memoryBatch_t));
+				}
+			}
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&self->depot_mutex);
+
+	return count;
+}
+
+static void
+vkk_memoryManager_purge(vkk_memoryManager_t* self)
+{
+	ASSERT(self);
+
+	// the manager must be locked
+
+	// return the cached slots of evacuated chunks to the
+	// pools so the magazines and depot do not pin the
+	// evacuated chunks and repeat while returning the slots
+	// evacuates additional chunks
+	vkk_memory_t* slots[VKK_MEMORY_MAGAZINE_SIZE];
+	uint32_t      count;
+	uint32_t      i;
+	while(self->purge)
+	{
+		self->purge = 0;
+
+		count = vkk_memoryManager_depotPurge(self, slots);
+		while(count)
+		{
+			for(i = 0; i < count; ++i)
+			{
+				if(vkk_memoryManager_freeSlot(self, &slots[i]))
+				{
+					self->purge = 1;
+				}
+			}
+			count = vkk_memoryManager_depotPurge(self, slots);
+		}
+
+		// restart the search after purging each magazine
+		int purged = 1;
+		while(purged)
+		{
+			purged = 0;
+
+			cc_listIter_t* iter = cc_list_head(self->magazines);
+			while(iter)
+			{
+				vkk_memoryMagazine_t* magazine;
+				magazine = (vkk_memoryMagazine_t*)
+				           cc_list_peekIter(iter);
+
+				count = vkk_memoryMagazine_purge(magazine, slots);
+				if(count)
+				{
+					for(i = 0; i < count; ++i)
+					{
+						if(vkk_memoryManager_freeSlot(self,
+						                              &slots[i]))
+						{
+							self->purge = 1;
+						}
+					}
+					purged = 1;
+					break;
+				}
+
+				iter = cc_list_next(iter);
+			}
+		}
+	}
+}
+
+static void
+vkk_memoryManager_purgeUnlocked(vkk_memoryManager_t* self)
+{
+	ASSERT(self);
+
+	// the slots were freed without the manager lock which
+	// is only acquired to purge the cached slots
+	vkk_memoryManager_lock(self);
+	self->purge = 1;
+	vkk_memoryManager_purge(self);
+	vkk_memoryManager_unlock(self);
+}
+
+static void
+vkk_memoryManager_drainMagazines(vkk_memoryManager_t* self)
+{
+	ASSERT(self);
+
+	// return the depot batches to the pools
+	vkk_memoryBatch_t batch;
+	while(vkk_memoryManager_depotPop(self, NULL, &batch))
+	{
+		if(vkk_memoryManager_freeBatch(self, &batch))
+		{
+			self->purge = 1;
+		}
+	}
+
+	// restart the search after draining each magazine and
+	// stop when all magazines are empty
+	int drained = 1;
+	while(drained)
+	{
+		drained = 0;
+
+		cc_listIter_t* iter = cc_list_head(self->magazines);
+		while(iter)
+		{
+			vkk_memoryMagazine_t* magazine;
+			magazine = (vkk_memoryMagazine_t*)
+			           cc_list_peekIter(iter);
+
+			vkk_memory_t* slots[VKK_MEMORY_MAGAZINE_SIZE];
+			uint32_t      count;
+			count = vkk_memoryMagazine_drain(magazine, slots);
+			if(count)
+			{
+				uint32_t i;
+				for(i = 0; i < count; ++i)
+				{
+					if(vkk_memoryManager_freeSlot(self, &slots[i]))
+					{
+						self->purge = 1;
+					}
+				}
+				drained = 1;
+				break;
+			}
+
+			iter = cc_list_next(iter);
+		}
+	}
+
+	// purge the slots of chunks which were evacuated while
+	// draining the magazines
+	vkk_memoryManager_purge(self);
+}
+
+static void
+vkk_memoryManager_magazineDestructor(void* ptr)
+{
+	ASSERT(ptr);
+
+	vkk_memoryMagazine_t* magazine = (vkk_memoryMagazine_t*) ptr;
+	vkk_memoryManager_t*  self     = magazine->mm;
+
+	// return the cached slots when the thread exits
+	vkk_memoryManager_lock(self);
+	vkk_memoryManager_drainMagazine(self, magazine);
+	cc_list_remove(self->magazines, &magazine->iter);
+	vkk_memoryManager_purge(self);
+
+	// retain the stats of the thread
+	pthread_mutex_lock(&self->budget_mutex);
+	int t;
+	for(t = 0; t < VKK_MEMORY_TYPE_COUNT; ++t)
+	{
+		vkk_memoryMagazine_stats(magazine, t, &self->stats[t]);
+	}
+	pthread_mutex_unlock(&self->budget_mutex);
+	vkk_memoryManager_unlock(self);
+
+	vkk_memoryMagazine_delete(&magazine);
+}
+
+static vkk_memoryMagazine_t*
+vkk_memoryManager_magazine(vkk_memoryManager_t* self)
+{
+	ASSERT(self);
+
+	vkk_memoryMagazine_t* magazine;
+	magazine = (vkk_memoryMagazine_t*)
+	           pthread_getspecific(self->magazine_key);
+	if(magazine)
+	{
+		return magazine;
+	}
+
+	// create the magazine on demand for the calling thread
+	magazine = vkk_memoryMagazine_new(self);
+	if(magazine == NULL)
+	{
+		return NULL;
+	}
+
+	vkk_memoryManager_lock(self);
+	magazine->iter = cc_list_append(self->magazines, NULL,
+	                                (const void*) magazine);
+	if(magazine->iter == NULL)
+	{
+		vkk_memoryManager_unlock(self);
+		goto fail_append;
+	}
+	vkk_memoryManager_unlock(self);
+
+	if(pthread_setspecific(self->magazine_key,
+	                       (const void*) magazine) != 0)
+	{
+		LOGE("pthread_setspecific failed");
+		goto fail_set;
+	}
+
+	// success
+	return magazine;
+
+	// failure
+	fail_set:
+	{
+		vkk_memoryManager_lock(self);
+		cc_list_remove(self->magazines, &magazine->iter);
+		vkk_memoryManager_unlock(self);
+	}
+	fail_append:
+		vkk_memoryMagazine_delete(&magazine);
+	return NULL;
+}
+
+static size_t computePoolCount(size_t stride)
+{
+	ASSERT(stride > 0);
+
+	// enforce allocation size
+	size_t MB    = 1024*1024;
+	size_t count = 256;
+	size_t size  = stride*count;
+	if(size >= 16*MB)
+	{
+		// allocate at most 16MB
+		count = 16*MB/stride;
+	}
+	else if(size < 2*MB)
+	{
+		// allocate at least 2MB
+		count = 2*MB/stride;
+	}
+
+	// enforce minimum count
+	if(count == 0)
+	{
+		count = 1;
+	}
+
+	return count;
+}
+
+static void
+vkk_memoryManager_bufferRequirements(vkk_memoryManager_t* self,
+                                     VkBuffer buffer,
+                                     VkMemoryRequirements* mr,
+                                     int* _dedicated)
+{
+	ASSERT(self);
+	ASSERT(mr);
+	ASSERT(_dedicated);
+
+	vkk_engine_t* engine = self->engine;
+
+	*_dedicated = 0;
+	if(self->getBufferMemoryRequirements2)
+	{
+		VkMemoryDedicatedRequirementsKHR mdr =
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR,
+			.pNext = NULL,
+		};
+
+		VkBufferMemoryRequirementsInfo2KHR bmr_info =
+		{
+			.sType  = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2_KHR,
+			.pNext  = NULL,
+			.buffer = buffer
+		};
+
+		VkMemoryRequirements2KHR mr2 =
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR,
+			.pNext = &mdr,
+		};
+
+		self->getBufferMemoryRequirements2(engine->device,
+		                                   &bmr_info, &mr2);
+		memcpy(mr, &mr2.memoryRequirements,
+		       sizeof(VkMemoryRequirements));
+
+		if(mdr.prefersDedicatedAllocation ||
+		   mdr.requiresDedicatedAllocation)
+		{
+			*_dedicated = 1;
+		}
+	}
+	else
+	{
+		vkGetBufferMemoryRequirements(engine->device,
+		                              buffer, mr);
+	}
+
+	if(mr->size >= VKK_MEMORY_DEDICATED_SIZE)
+	{
+		*_dedicated = 1;
+	}
+}
+
+static void
+vkk_memoryManager_imageRequirements(vkk_memoryManager_t* self,
+                                    VkImage image,
+                                    VkMemoryRequirements* mr,
+                                    int* _dedicated)
+{
+	ASSERT(self);
+	ASSERT(mr);
+	ASSERT(_dedicated);
+
+	vkk_engine_t* engine = self->engine;
+
+	*_dedicated = 0;
+	if(self->getImageMemoryRequirements2)
+	{
+		VkMemoryDedicatedRequirementsKHR mdr =
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR,
+			.pNext = NULL,
+		};
+
+		VkImageMemoryRequirementsInfo2KHR imr_info =
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR,
+			.pNext = NULL,
+			.image = image
+		};
+
+		VkMemoryRequirements2KHR mr2 =
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR,
+			.pNext = &mdr,
+		};
+
+		self->getImageMemoryRequirements2(engine->device,
+		                                  &imr_info, &mr2);
+		memcpy(mr, &mr2.memoryRequirements,
+		       sizeof(VkMemoryRequirements));
+
+		if(mdr.prefersDedicatedAllocation ||
+		   mdr.requiresDedicatedAllocation)
+		{
+			*_dedicated = 1;
+		}
+	}
+	else
+	{
+		vkGetImageMemoryRequirements(engine->device,
+		                             image, mr);
+	}
+
+	if(mr->size >= VKK_MEMORY_DEDICATED_SIZE)
+	{
+		*_dedicated = 1;
+	}
+}
+
+static uint32_t
+vkk_memoryManager_poolIndex(vkk_memoryManager_t* self,
+                            const vkk_memoryPoolKey_t* key)
+{
+	ASSERT(self);
+	ASSERT(key);
+	ASSERT((key->stride & (key->stride - 1)) == 0);
+
+	// shared usage index where 0 selects non-shared pools
+	uint32_t u = 0;
+	if(key->usage)
+	{
+		uint32_t count;
+		count = __atomic_load_n(&self->shared_count,
+		                        __ATOMIC_ACQUIRE);
+		while(self->shared_usage[u] != key->usage)
+		{
+			++u;
+			ASSERT(u < count);
+		}
+		++u;
+	}
+
+	// log2(stride) + 1 where 0 selects variable size pools
+	uint32_t bin = 0;
+	if(key->stride)
+	{
+		bin = 32 - __builtin_clz(key->stride);
+	}
+
+	return (((key->priority*VK_MAX_MEMORY_TYPES +
+	          key->mt_index)*2 + key->optimal)*
+	        (VKK_MEMORY_SHARED_USAGES + 1) + u)*
+	       VKK_MEMORY_POOL_BINS + bin;
+}
+
+static int
+vkk_memoryManager_sharedRequirements(vkk_memoryManager_t* self,
+                                     VkBufferUsageFlags usage,
+                                     VkMemoryRequirements* mr)
+{
+	ASSERT(self);
+	ASSERT(mr);
+
+	vkk_engine_t* engine = self->engine;
+
+	// lock-free lookup of the published entries
+	uint32_t i;
+	uint32_t count;
+	count = __atomic_load_n(&self->shared_count,
+	                        __ATOMIC_ACQUIRE);
+	for(i = 0; i < count; ++i)
+	{
+		if(self->shared_usage[i] == usage)
+		{
+			memcpy(mr, &self->shared_mr[i],
+			       sizeof(VkMemoryRequirements));
+			return 1;
+		}
+	}
+
+	vkk_memoryManager_lock(self);
+
+	// check again since another thread may have published
+	// the usage before the lock was acquired
+	for(i = 0; i < self->shared_count; ++i)
+	{
+		if(self->shared_usage[i] == usage)
+		{
+			memcpy(mr, &self->shared_mr[i],
+			       sizeof(VkMemoryRequirements));
+			vkk_memoryManager_unlock(self);
+			return 1;
+		}
+	}
+
+	if(self->shared_count == VKK_MEMORY_SHARED_USAGES)
+	{
+		LOGE("invalid usage=0x%X", (uint32_t) usage);
+		goto fail_count;
+	}
+
+	// the requirements are queried with a temporary buffer
+	// since the memoryTypeBits and alignment are identical
+	// for all buffers with the same usage
+	VkBufferCreateInfo b_info =
+	{
+		.sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext                 = NULL,
+		.flags                 = 0,
+		.size                  = VKK_MEMORY_TLSF_ALIGN,
+		.usage                 = usage,
+		.sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 1,
+		.pQueueFamilyIndices   = &engine->queue_family_index
+	};
+
+	VkBuffer buffer;
+	if(vkCreateBuffer(engine->device, &b_info, NULL,
+	                  &buffer) != VK_SUCCESS)
+	{
+		LOGE("vkCreateBuffer failed");
+		goto fail_create;
+	}
+
+	vkGetBufferMemoryRequirements(engine->device, buffer, mr);
+	vkDestroyBuffer(engine->device, buffer, NULL);
+
+	// suballocations are bound to the shared buffer at
+	// their offset which must also satisfy the uniform
+	// buffer descriptor offset alignment
+	if((usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) &&
+	   (mr->alignment < self->ub_align))
+	{
+		mr->alignment = self->ub_align;
+	}
+
+	self->shared_usage[i] = usage;
+	memcpy(&self->shared_mr[i], mr,
+	       sizeof(VkMemoryRequirements));
+	__atomic_store_n(&self->shared_count, i + 1,
+	                 __ATOMIC_RELEASE);
+
+	vkk_memoryManager_unlock(self);
+
+	// success
+	return 1;
+
+	// failure
+	fail_create:
+	fail_count:
+		vkk_memoryManager_unlock(self);
+	return 0;
+}
+
+static vkk_memory_t*
+vkk_memoryManager_allocDedicated(vkk_memoryManager_t* self,
+                                 VkMemoryRequirements* mr,
+                                 VkFlags mp_flags,
+                                 vkk_memoryType_e type,
+                                 vkk_memoryPriority_e priority,
+                                 VkBuffer buffer,
+                                 VkImage image,
+                                 int* _over_budget)
+{
+	ASSERT(self);
+	ASSERT(mr);
+	ASSERT(_over_budget);
+
+	vkk_engine_t* engine = self->engine;
+
+	uint32_t mt_index;
+	if(vkk_engine_getMemoryTypeIndex(engine,
+	                                 mr->memoryTypeBits,
+	                                 mp_flags,
+	                                 &mt_index) == 0)
+	{
+		LOGE("invalid memory type");
+		return NULL;
+	}
+
+	// the Vulkan allocation is performed while unlocked
+	// since dedicated chunks are independent of the pools
+	vkk_memoryInfo_t   info = { 0 };
+	vkk_memoryChunk_t* chunk;
+	chunk = vkk_memoryChunk_newDedicated(self, mt_index, type,
+	                                     priority, mr->size,
+	                                     buffer, image, &info,
+	                                     _over_budget);
+	if(chunk == NULL)
+	{
+		return NULL;
+	}
+
+	vkk_memory_t* memory;
+	memory = vkk_memoryChunk_alloc(chunk, mr, &info);
+	if(memory == NULL)
+	{
+		goto fail_memory;
+	}
+
+	vkk_memoryManager_lock(self);
+	if(cc_list_append(self->dedicated, NULL,
+	                  (const void*) chunk) == NULL)
+	{
+		vkk_memoryManager_unlock(self);
+		goto fail_append;
+	}
+	vkk_memoryManager_unlock(self);
+
+	pthread_mutex_lock(&self->info_mutex);
+	vkk_memoryManager_addInfo(self, type, &info);
+	pthread_mutex_unlock(&self->info_mutex);
+
+	// success
+	return memory;
+
+	// failure
+	fail_append:
+		vkk_memoryChunk_free(chunk, &memory, &info);
+	fail_memory:
+		vkk_memoryChunk_delete(&chunk, &info);
+	return NULL;
+}
+
+static void
+vkk_memoryManager_freeDedicated(vkk_memoryManager_t* self,
+                                vkk_memory_t** _memory)
+{
+	ASSERT(self);
+	ASSERT(_memory);
+
+	vkk_memory_t*      memory = *_memory;
+	vkk_memoryChunk_t* chunk  = memory->chunk;
+	vkk_memoryType_e   type   = chunk->type;
+	vkk_memoryInfo_t   info   = { 0 };
+
+	// detach the chunk from the manager and the Vulkan
+	// free is performed while unlocked
+	vkk_memoryManager_lock(self);
+	cc_listIter_t* iter = cc_list_head(self->dedicated);
+	while(iter)
+	{
+		vkk_memoryChunk_t* tmp;
+		tmp = (vkk_memoryChunk_t*) cc_list_peekIter(iter);
+		if(tmp == chunk)
+		{
+			cc_list_remove(self->dedicated, &iter);
+			break;
+		}
+
+		iter = cc_list_next(iter);
+	}
+	vkk_memoryManager_undirty(self, chunk);
+	vkk_memoryManager_unlock(self);
+
+	vkk_memoryChunk_free(chunk, _memory, &info);
+	vkk_memoryChunk_delete(&chunk, &info);
+
+	pthread_mutex_lock(&self->info_mutex);
+	vkk_memoryManager_subInfo(self, type, &info);
+	pthread_mutex_unlock(&self->info_mutex);
+}
+
+static vkk_memory_t*
+vkk_memoryManager_alloc(vkk_memoryManager_t* self,
+                        VkMemoryRequirements* mr,
+                        VkFlags mp_flags,
+                        vkk_memoryType_e type,
+                        vkk_memoryPriority_e priority,
+                        VkBufferUsageFlags usage,
+                        int optimal,
+                        int* _over_budget)
+{
+	ASSERT(self);
+	ASSERT(mr);
+	ASSERT(_over_budget);
+
+	vkk_engine_t* engine = self->engine;
+
+	uint32_t mt_index;
+	if(vkk_engine_getMemoryTypeIndex(engine,
+	                                 mr->memoryTypeBits,
+	                                 mp_flags,
+	                                 &mt_index) == 0)
+	{
+		LOGE("invalid memory type");
+		return NULL;
+	}
+
+	// compute the pool stride
+	VkDeviceSize stride = mr->alignment;
+	while(stride < mr->size)
+	{
+		stride *= 2;
+	}
+
+	// select a variable size pool for large allocations
+	uint32_t count = 0;
+	if(stride > VKK_MEMORY_STRIDE_MAX)
+	{
+		stride = 0;
+	}
+	else
+	{
+		count = computePoolCount((size_t) stride);
+	}
+
+	// priorities only select distinct pools when the device
+	// supports VK_EXT_memory_priority
+	if(engine->has_memory_priority == 0)
+	{
+		priority = VKK_MEMORY_PRIORITY_DEFAULT;
+	}
+
+	vkk_memoryPoolKey_t key =
+	{
+		.mt_index = (uint32_t) mt_index,
+		.stride   = (uint32_t) stride,
+		.usage    = (uint32_t) usage,
+		.optimal  = 0,
+		.priority = (uint32_t) priority
+	};
+
+	// optimal tiling images are placed in separate pools
+	// when a slot/block may share a bufferImageGranularity
+	// page with a linear resource (buffer) in the same chunk
+	// fixed stride slots are safe when the stride is a
+	// multiple of the granularity and variable size blocks
+	// are safe when the block alignment is a multiple of
+	// the granularity
+	if(optimal)
+	{
+		if(stride)
+		{
+			key.optimal = (stride%self->granularity) ? 1 : 0;
+		}
+		else
+		{
+			key.optimal = (VKK_MEMORY_TLSF_ALIGN%self->granularity) ?
+			              1 : 0;
+		}
+	}
+
+	// try to allocate a fixed stride slot from the thread
+	// magazine which does not require the manager lock
+	vkk_memory_t*         memory;
+	vkk_memoryMagazine_t* magazine = NULL;
+	uint32_t              refill   = 0;
+	if(stride)
+	{
+		magazine = vkk_memoryManager_magazine(self);
+		if(magazine)
+		{
+			memory = vkk_memoryMagazine_get(magazine, &key,
+			                                &refill);
+
+			// refill the magazine from a depot batch which
+			// does not require the manager lock
+			vkk_memoryBatch_t batch;
+			if((memory == NULL) && refill &&
+			   vkk_memoryManager_depotPop(self, &key, &batch))
+			{
+				--batch.count;
+				memory = batch.slots[batch.count];
+				if(batch.count)
+				{
+					vkk_memoryMagazine_refill(magazine, &key,
+					                          batch.count,
+					                          batch.slots);
+				}
+				refill = 0;
+			}
+
+			if(memory && (memory->chunk->evacuate == 0))
+			{
+				return memory;
+			}
+			else if(memory)
+			{
+				// return a slot whose chunk was evacuated
+				// after the slot was cached
+				if(vkk_memoryManager_freeSlot(self, &memory))
+				{
+					vkk_memoryManager_purgeUnlocked(self);
+				}
+			}
+		}
+	}
+
+	// find an existing pool without the manager lock
+	uint32_t          idx = vkk_memoryManager_poolIndex(self, &key);
+	vkk_memoryPool_t* pool;
+	pool = __atomic_load_n(&self->pools[idx], __ATOMIC_ACQUIRE);
+	if(pool == NULL)
+	{
+		// the manager lock is only required to create pools
+		// so check again since another thread may have
+		// created the pool before the lock was acquired
+		vkk_memoryManager_lock(self);
+		pool = self->pools[idx];
+		if(pool == NULL)
+		{
+			// otherwise create a new pool
+			pool = vkk_memoryPool_new(self, count, &key, type);
+			if(pool == NULL)
+			{
+				vkk_memoryManager_unlock(self);
+				goto fail_pool;
+			}
+
+			if(cc_list_append(self->pool_list, NULL,
+			                  (const void*) pool) == NULL)
+			{
+				vkk_memoryPool_delete(&pool);
+				vkk_memoryManager_unlock(self);
+				goto fail_pool;
+			}
+
+			__atomic_store_n(&self->pools[idx], pool,
+			                 __ATOMIC_RELEASE);
+		}
+		vkk_memoryManager_unlock(self);
+	}
+
+	// the pool persists so the pool lock is sufficient
+	vkk_memoryManager_poolLock(self, pool);
+
+	// memory is unitialized
+	vkk_memoryInfo_t info = { 0 };
+	memory = vkk_memoryPool_alloc(pool, mr, &info,
+	                              _over_budget);
+	if(memory == NULL)
+	{
+		vkk_memoryManager_poolUnlock(self, pool);
+		goto fail_alloc;
+	}
+
+	// reserve additional slots to refill the magazine
+	// note that the reserved slots are reported as used and
+	// the refill is truncated rather than creating a chunk
+	// (see vkk_memoryPool_refill)
+	vkk_memory_t* slots[VKK_MEMORY_MAGAZINE_SIZE];
+	uint32_t      n = 0;
+	while(n < refill)
+	{
+		slots[n] = vkk_memoryPool_refill(pool, mr, &info);
+		if(slots[n] == NULL)
+		{
+			break;
+		}
+		++n;
+	}
+
+	// the chunk must be unretained before the pool is
+	// unlocked so that it is not trimmed while in use
+	pthread_mutex_lock(&self->info_mutex);
+	vkk_memoryManager_unretain(self, memory->chunk);
+	vkk_memoryManager_addInfo(self, type, &info);
+	pthread_mutex_unlock(&self->info_mutex);
+	vkk_memoryManager_poolUnlock(self, pool);
+
+	// the magazine is refilled without the pool lock
+	// to preserve the pool/magazine lock order
+	if(n)
+	{
+		vkk_memoryMagazine_refill(magazine, &key, n, slots);
+	}
+
+	// success
+	return memory;
+
+	// failure
+	fail_alloc:
+	fail_pool:
+		LOGE("alloc failed");
+	return NULL;
+}
+
+static vkk_memory_t*
+vkk_memoryManager_allocTry(vkk_memoryManager_t* self,
+                           VkMemoryRequirements* mr,
+                           VkFlags mp_flags,
+                           vkk_memoryType_e type,
+                           vkk_memoryPriority_e priority,
+                           VkBufferUsageFlags usage,
+                           int optimal,
+                           int dedicated,
+                           VkBuffer buffer,
+                           VkImage image,
+                           int* _over_budget)
+{
+	ASSERT(self);
+	ASSERT(mr);
+	ASSERT(_over_budget);
+
+	// over_budget is set when the allocation failed because
+	// the memory budget or soft cap was exceeded (or the
+	// driver reported that the memory was exhausted) such
+	// that trimming or evicting resources may resolve it
+	*_over_budget = 0;
+
+	vkk_memory_t* memory;
+	if(dedicated)
+	{
+		memory = vkk_memoryManager_allocDedicated(self, mr,
+		                                          mp_flags, type,
+		                                          priority,
+		                                          buffer, image,
+		                                          _over_budget);
+	}
+	else
+	{
+		memory = vkk_memoryManager_alloc(self, mr, mp_flags,
+		                                 type, priority, usage,
+		                                 optimal, _over_budget);
+	}
+
+	if(memory)
+	{
+		vkk_memoryMagazine_t* magazine;
+		magazine = vkk_memoryManager_magazine(self);
+		if(magazine)
+		{
+			vkk_memoryMagazine_recordAlloc(magazine, type,
+			                               (size_t) mr->size,
+			                               (size_t) memory->size);
+		}
+	}
+
+	return memory;
+}
+
+static vkk_memory_t*
+vkk_memoryManager_allocEvict(vkk_memoryManager_t* self,
+                             VkMemoryRequirements* mr,
+                             VkFlags mp_flags,
+                             vkk_memoryType_e type,
+                             vkk_memoryPriority_e priority,
+                             VkBufferUsageFlags usage,
+                             int optimal,
+                             int dedicated,
+                             VkBuffer buffer,
+                             VkImage image,
+                             int evict)
+{
+	ASSERT(self);
+	ASSERT(mr);
+
+	int attempt;
+	for(attempt = 0; attempt < 2; ++attempt)
+	{
+		int over_budget = 0;
+
+		vkk_memory_t* memory;
+		memory = vkk_memoryManager_allocTry(self, mr, mp_flags,
+		                                    type, priority, usage,
+		                                    optimal, dedicated,
+		                                    buffer, image,
+		                                    &over_budget);
+		if(memory)
+		{
+			return memory;
+		}
+
+		// trimming or evicting resources cannot resolve
+		// other failures (e.g. no compatible memory type)
+		if(over_budget == 0)
+		{
+			break;
+		}
+
+		if(attempt == 0)
+		{
+			// release the retained chunks and cached slots
+			// which count against the budget
+			vkk_memoryManager_trim(self);
+		}
+		else if(evict)
+		{
+			// ask the app to evict resources
+			// the evicted objects are destroyed by the
+			// destruct queue once their timestamps expire
+			// so the allocation fails and the app should
+			// retry (e.g. on the next frame) rather than
+			// blocking this thread on the destruct queue
+			// which may wait for the current frame
+			pthread_mutex_lock(&self->budget_mutex);
+			void*              priv     = self->evict_priv;
+			vkk_engine_evictFn evict_fn = self->evict_fn;
+			pthread_mutex_unlock(&self->budget_mutex);
+
+			if(evict_fn)
+			{
+				evict_fn(priv, type, (size_t) mr->size);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static vkk_memory_t*
+vkk_memoryManager_allocClass(vkk_memoryManager_t* self,
+                             VkMemoryRequirements* mr,
+                             vkk_memoryClass_e mclass,
+                             vkk_memoryPriority_e priority,
+                             VkBufferUsageFlags usage,
+                             int dedicated,
+                             VkBuffer buffer,
+                             int evict)
+{
+	ASSERT(self);
+	ASSERT(mr);
+
+	vkk_engine_t* engine = self->engine;
+
+	const char* class_name[VKK_MEMORY_CLASS_COUNT] =
+	{
+		"upload",
+		"device",
+		"readback",
+		"dynamic",
+	};
+
+	vkk_memory_t*    memory = NULL;
+	vkk_memoryType_e type   = VKK_MEMORY_TYPE_SYSTEM;
+
+	// prefer device local host visible memory for dynamic
+	// buffers but do not trim or evict resources to make
+	// room since the upload memory is a valid fallback
+	// note that dynamic allocations are accounted as device
+	// memory so they count against the device soft cap
+	if((mclass == VKK_MEMORY_CLASS_DYNAMIC) &&
+	   (mr->memoryTypeBits & self->dynamic_bits))
+	{
+		VkMemoryRequirements dmr = *mr;
+		dmr.memoryTypeBits &= self->dynamic_bits;
+
+		int over_budget;
+		memory = vkk_memoryManager_allocTry(self, &dmr,
+		                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+		                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                                    VKK_MEMORY_TYPE_DEVICE,
+		                                    priority, usage, 0,
+		                                    dedicated, buffer,
+		                                    VK_NULL_HANDLE,
+		                                    &over_budget);
+	}
+
+	if(memory == NULL)
+	{
+		VkFlags mp_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		if(mclass == VKK_MEMORY_CLASS_DEVICE)
+		{
+			mp_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			type     = VKK_MEMORY_TYPE_DEVICE;
+		}
+		else if(mclass == VKK_MEMORY_CLASS_READBACK)
+		{
+			// prefer cached memory (coherent or non-coherent)
+			// and fall back to the upload memory
+			VkFlags cached_flags[] =
+			{
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				VK_MEMORY_PROPERTY_HOST_CACHED_BIT  |
+				VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+			};
+
+			int i;
+			for(i = 0; i < 2; ++i)
+			{
+				uint32_t mt_index;
+				if(vkk_engine_getMemoryTypeIndex(engine,
+				                                 mr->memoryTypeBits,
+				                                 cached_flags[i],
+				                                 &mt_index))
+				{
+					mp_flags = cached_flags[i];
+					break;
+				}
+			}
+		}
+
+		memory = vkk_memoryManager_allocEvict(self, mr, mp_flags,
+		                                      type, priority,
+		                                      usage, 0, dedicated,
+		                                      buffer,
+		                                      VK_NULL_HANDLE, evict);
+		if(memory == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	// report the memory type of the first allocation of
+	// each class and memory type
+	uint32_t mt_index = memory->chunk->mt_index;
+	if(__atomic_fetch_add(&self->class_count[mclass][mt_index],
+	                      1, __ATOMIC_RELAXED) == 0)
+	{
+		VkMemoryType* mt = &self->mp.memoryTypes[mt_index];
+		LOGI("class=%s, mt_index=%u, heap=%u, flags=0x%X",
+		     class_name[mclass], mt_index, mt->heapIndex,
+		     (uint32_t) mt->propertyFlags);
+	}
+
+	return memory;
+}
+
+static uint32_t
+vkk_memoryManager_heapMask(vkk_memoryManager_t* self,
+                           vkk_memoryType_e type)
+{
+	ASSERT(self);
+
+	VkMemoryPropertyFlags flags = 0;
+	if(type == VKK_MEMORY_TYPE_SYSTEM)
+	{
+		flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	}
+	else if(type == VKK_MEMORY_TYPE_DEVICE)
+	{
+		flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	}
+	else if(type == VKK_MEMORY_TYPE_TRANSIENT)
+	{
+		flags = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+	}
+
+	// select the heaps which back the memory type
+	uint32_t mask = 0;
+	uint32_t i;
+	for(i = 0; i < self->mp.memoryTypeCount; ++i)
+	{
+		VkMemoryType* mt = &self->mp.memoryTypes[i];
+		if((mt->propertyFlags & flags) == flags)
+		{
+			mask |= 1 << mt->heapIndex;
+		}
+	}
+
+	// transient memory falls back to device memory
+	if((mask == 0) && (type == VKK_MEMORY_TYPE_TRANSIENT))
+	{
+		return vkk_memoryManager_heapMask(self,
+		                                  VKK_MEMORY_TYPE_DEVICE);
+	}
+
+	return mask;
+}
+
+static void
+vkk_memoryManager_heapBudget(vkk_memoryManager_t* self,
+                             uint32_t heap_mask,
+                             size_t* _budget,
+                             size_t* _usage)
+{
+	ASSERT(self);
+	ASSERT(_budget);
+	ASSERT(_usage);
+
+	vkk_engine_t* engine = self->engine;
+
+	// the budget mutex must be locked
+
+	// the device budget includes the usage of other
+	// processes while the heap size is an upper bound when
+	// VK_EXT_memory_budget is not supported
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT mbp =
+	{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+		.pNext = NULL,
+	};
+
+	VkPhysicalDeviceMemoryProperties2KHR mp2 =
+	{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR,
+		.pNext = &mbp,
+	};
+
+	if(self->getPhysicalDeviceMemoryProperties2)
+	{
+		self->getPhysicalDeviceMemoryProperties2(engine->physical_device,
+		                                         &mp2);
+	}
+
+	size_t   budget = 0;
+	size_t   usage  = 0;
+	uint32_t h;
+	for(h = 0; h < self->mp.memoryHeapCount; ++h)
+	{
+		if((heap_mask & (1 << h)) == 0)
+		{
+			continue;
+		}
+
+		if(self->getPhysicalDeviceMemoryProperties2)
+		{
+			budget += (size_t) mbp.heapBudget[h];
+			usage  += (size_t) mbp.heapUsage[h];
+		}
+		else
+		{
+			budget += (size_t) self->mp.memoryHeaps[h].size;
+			usage  += self->heap_usage[h];
+		}
+	}
+
+	*_budget = budget;
+	*_usage  = usage;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+vkk_memoryManager_t*
+vkk_memoryManager_new(vkk_engine_t* engine)
+{
+	ASSERT(engine);
+
+	vkk_memoryManager_t* self;
+	self = (vkk_memoryManager_t*)
+	       CALLOC(1, sizeof(vkk_memoryManager_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	self->engine = engine;
+
+	vkGetPhysicalDeviceMemoryProperties(engine->physical_device,
+	                                    &self->mp);
+
+	VkPhysicalDeviceProperties pdp;
+	vkGetPhysicalDeviceProperties(engine->physical_device, &pdp);
+	self->atom_size = pdp.limits.nonCoherentAtomSize;
+	if(self->atom_size == 0)
+	{
+		self->atom_size = 1;
+	}
+	self->ub_align    = pdp.limits.minUniformBufferOffsetAlignment;
+	self->granularity = pdp.limits.bufferImageGranularity;
+	if(self->granularity == 0)
+	{
+		self->granularity = 1;
+	}
+
+	// select the memory types for dynamic buffers
+	uint32_t i;
+	VkFlags  dynamic_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+	                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+	                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	for(i = 0; i < self->mp.memoryTypeCount; ++i)
+	{
+		VkMemoryType* mt   = &self->mp.memoryTypes[i];
+		VkMemoryHeap* heap = &self->mp.memoryHeaps[mt->heapIndex];
+		if(((mt->propertyFlags & dynamic_flags) == dynamic_flags) &&
+		   (heap->size > VKK_MEMORY_DYNAMIC_HEAP_SIZE))
+		{
+			self->dynamic_bits |= 1 << i;
+		}
+	}
+	LOGI("dynamic_bits=0x%X", self->dynamic_bits);
+
+	if(engine->has_memory_budget)
+	{
+		self->getPhysicalDeviceMemoryProperties2 =
+			(PFN_vkGetPhysicalDeviceMemoryProperties2KHR)
+			vkGetInstanceProcAddr(engine->instance,
+			                      "vkGetPhysicalDeviceMemoryProperties2KHR");
+		if(self->getPhysicalDeviceMemoryProperties2 == NULL)
+		{
+			LOGW("vkGetInstanceProcAddr failed");
+		}
+	}
+
+	if(engine->has_dedicated_allocation)
+	{
+		self->getBufferMemoryRequirements2 =
+			(PFN_vkGetBufferMemoryRequirements2KHR)
+			vkGetDeviceProcAddr(engine->device,
+			                    "vkGetBufferMemoryRequirements2KHR");
+		self->getImageMemoryRequirements2 =
+			(PFN_vkGetImageMemoryRequirements2KHR)
+			vkGetDeviceProcAddr(engine->device,
+			                    "vkGetImageMemoryRequirements2KHR");
+		if((self->getBufferMemoryRequirements2 == NULL) ||
+		   (self->getImageMemoryRequirements2  == NULL))
+		{
+			LOGW("vkGetDeviceProcAddr failed");
+			self->getBufferMemoryRequirements2 = NULL;
+			self->getImageMemoryRequirements2  = NULL;
+		}
+	}
+
+	self->pools = (vkk_memoryPool_t**)
+	              CALLOC(VKK_MEMORY_POOL_COUNT,
+	                     sizeof(vkk_memoryPool_t*));
+	if(self->pools == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_pools;
+	}
+
+	self->pool_list = cc_list_new();
+	if(self->pool_list == NULL)
+	{
+		goto fail_pool_list;
+	}
+
+	self->dedicated = cc_list_new();
+	if(self->dedicated == NULL)
+	{
+		goto fail_dedicated;
+	}
+
+	self->dirty = cc_list_new();
+	if(self->dirty == NULL)
+	{
+		goto fail_dirty;
+	}
+
+	int t;
+	for(t = 0; t < VKK_MEMORY_TYPE_COUNT; ++t)
+	{
+		self->retained[t] = cc_list_new();
+		if(self->retained[t] == NULL)
+		{
+			goto fail_retained;
+		}
+	}
+
+	self->magazines = cc_list_new();
+	if(self->magazines == NULL)
+	{
+		goto fail_magazines;
+	}
+
+	if(pthread_key_create(&self->magazine_key,
+	                      vkk_memoryManager_magazineDestructor) != 0)
+	{
+		LOGE("pthread_key_create failed");
+		goto fail_magazine_key;
+	}
+
+	if(pthread_mutex_init(&self->depot_mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_depot_mutex;
+	}
+
+	if(pthread_mutex_init(&self->budget_mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_budget_mutex;
+	}
+
+	if(pthread_mutex_init(&self->dirty_mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_dirty_mutex;
+	}
+
+	if(pthread_mutex_init(&self->info_mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_info_mutex;
+	}
+
+	if(pthread_mutex_init(&self->manager_mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_manager_mutex;
+	}
+
+	int u;
+	for(u = 0; u < VKK_CHUNK_UPDATERS; ++u)
+	{
+		if(pthread_mutex_init(&self->chunk_mutex[u], NULL) != 0)
+		{
+			LOGE("pthread_mutex_init failed");
+			goto fail_chunk_mutex;
+		}
+	}
+
+	int v;
+	for(v = 0; v < VKK_CHUNK_UPDATERS; ++v)
+	{
+		if(pthread_cond_init(&self->chunk_cond[v], NULL) != 0)
+		{
+			LOGE("pthread_cond_init failed");
+			goto fail_chunk_cond;
+		}
+	}
+
+	// success
+	return self;
+
+	// failure
+	fail_chunk_cond:
+	{
+		int i;
+		for(i = 0; i < v; ++i)
+		{
+			pthread_cond_destroy(&self->chunk_cond[i]);
+		}
+		for(i = 0; i < u; ++i)
+		{
+			pthread_mutex_destroy(&self->chunk_mutex[i]);
+		}
+	}
+	fail_chunk_mutex:
+		pthread_mutex_destroy(&self->manager_mutex);
+	fail_manager_mutex:
+		pthread_mutex_destroy(&self->info_mutex);
+	fail_info_mutex:
+		pthread_mutex_destroy(&self->dirty_mutex);
+	fail_dirty_mutex:
+		pthread_mutex_destroy(&self->budget_mutex);
+	fail_budget_mutex:
+		pthread_mutex_destroy(&self->depot_mutex);
+	fail_depot_mutex:
+		pthread_key_delete(self->magazine_key);
+	fail_magazine_key:
+		cc_list_delete(&self->magazines);
+	fail_magazines:
+	fail_retained:
+	{
+		int i;
+		for(i = 0; i < t; ++i)
+		{
+			cc_list_delete(&self->retained[i]);
+		}
+		cc_list_delete(&self->dirty);
+	}
+	fail_dirty:
+		cc_list_delete(&self->dedicated);
+	fail_dedicated:
+		cc_list_delete(&self->pool_list);
+	fail_pool_list:
+		FREE(self->pools);
+	fail_pools:
+		FREE(self);
+	return NULL;
+}
+
+void vkk_memoryManager_delete(vkk_memoryManager_t** _self)
+{
+	ASSERT(_self);
+
+	vkk_memoryManager_t* self = *_self;
+	if(self)
+	{
+		// return the cached slots and delete the magazines
+		// note that the key destructor is not called for
+		// threads which exit after the key is deleted
+		vkk_memoryManager_lock(self);
+		vkk_memoryManager_drainMagazines(self);
+		vkk_memoryManager_unlock(self);
+		pthread_key_delete(self->magazine_key);
+
+		cc_listIter_t* iter = cc_list_head(self->magazines);
+		while(iter)
+		{
+			vkk_memoryMagazine_t* magazine;
+			magazine = (vkk_memoryMagazine_t*)
+			           cc_list_remove(self->magazines, &iter);
+			vkk_memoryMagazine_delete(&magazine);
+		}
+		cc_list_delete(&self->magazines);
+
+		// release retained chunks
+		pthread_mutex_lock(&self->info_mutex);
+		int t;
+		for(t = 0; t < VKK_MEMORY_TYPE_COUNT; ++t)
+		{
+			vkk_memoryManager_trimType(self, t, 0);
+			cc_list_delete(&self->retained[t]);
+		}
+		pthread_mutex_unlock(&self->info_mutex);
+
+		// delete the empty pools
+		iter = cc_list_head(self->pool_list);
+		while(iter)
+		{
+			vkk_memoryPool_t* pool;
+			pool = (vkk_memoryPool_t*)
+			       cc_list_remove(self->pool_list, &iter);
+			vkk_memoryPool_delete(&pool);
+		}
+		cc_list_delete(&self->pool_list);
+		FREE(self->pools);
+
+		ASSERT(cc_list_size(self->dedicated) == 0);
+		ASSERT(cc_list_size(self->dirty) == 0);
+
+		int u;
+		for(u = 0; u < VKK_CHUNK_UPDATERS; ++u)
+		{
+			pthread_cond_destroy(&self->chunk_cond[u]);
+			pthread_mutex_destroy(&self->chunk_mutex[u]);
+		}
+		pthread_mutex_destroy(&self->manager_mutex);
+		pthread_mutex_destroy(&self->info_mutex);
+		pthread_mutex_destroy(&self->dirty_mutex);
+		pthread_mutex_destroy(&self->budget_mutex);
+		pthread_mutex_destroy(&self->depot_mutex);
+		cc_list_delete(&self->dirty);
+		cc_list_delete(&self->dedicated);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+void vkk_memoryManager_shutdown(vkk_memoryManager_t* self)
+{
+	ASSERT(self);
+
+	pthread_mutex_lock(&self->info_mutex);
+	self->shutdown = 1;
+	pthread_mutex_unlock(&self->info_mutex);
+}
+
+void vkk_memoryManager_trim(vkk_memoryManager_t* self)
+{
+	ASSERT(self);
+
+	vkk_memoryManager_lock(self);
+
+	// return the cached slots so that empty chunks may
+	// be released
+	vkk_memoryManager_drainMagazines(self);
+
+	pthread_mutex_lock(&self->info_mutex);
+	int t;
+	for(t = 0; t < VKK_MEMORY_TYPE_COUNT; ++t)
+	{
+		vkk_memoryManager_trimType(self, t, 0);
+	}
+	pthread_mutex_unlock(&self->info_mutex);
+
+	vkk_memoryManager_unlock(self);
+}
+
+void vkk_memoryManager_budget(vkk_memoryManager_t* self,
+                              vkk_memoryType_e type,
+                              vkk_memoryBudget_t* budget)
+{
+	ASSERT(self);
+	ASSERT(budget);
+
+	uint32_t heap_mask = 0xFFFFFFFF;
+	if(type != VKK_MEMORY_TYPE_ANY)
+	{
+		heap_mask = vkk_memoryManager_heapMask(self, type);
+	}
+
+	pthread_mutex_lock(&self->budget_mutex);
+	vkk_memoryManager_heapBudget(self, heap_mask,
+	                             &budget->budget,
+	                             &budget->usage);
+	budget->soft_cap = self->soft_cap[type];
+	pthread_mutex_unlock(&self->budget_mutex);
+}
+
+void vkk_memoryManager_softCap(vkk_memoryManager_t* self,
+                               vkk_memoryType_e type,
+                               size_t soft_cap)
+{
+	ASSERT(self);
+
+	pthread_mutex_lock(&self->budget_mutex);
+	self->soft_cap[type] = soft_cap;
+	pthread_mutex_unlock(&self->budget_mutex);
+}
+
+void vkk_memoryManager_evictFn(vkk_memoryManager_t* self,
+                               void* priv,
+                               vkk_engine_evictFn evict_fn)
+{
+	// priv and evict_fn may be NULL
+	ASSERT(self);
+
+	pthread_mutex_lock(&self->budget_mutex);
+	self->evict_priv = priv;
+	self->evict_fn   = evict_fn;
+	pthread_mutex_unlock(&self->budget_mutex);
+}
+
+int vkk_memoryManager_reserve(vkk_memoryManager_t* self,
+                              uint32_t mt_index,
+                              vkk_memoryType_e type,
+                              size_t size)
+{
+	ASSERT(self);
+
+	uint32_t heap = self->mp.memoryTypes[mt_index].heapIndex;
+
+	pthread_mutex_lock(&self->budget_mutex);
+
+	size_t budget;
+	size_t usage;
+	vkk_memoryManager_heapBudget(self, 1 << heap,
+	                             &budget, &usage);
+	if(usage + size > budget)
+	{
+		LOGW("over budget: heap=%u, usage=%" PRIu64
+		     ", size=%" PRIu64 ", budget=%" PRIu64,
+		     heap, (uint64_t) usage, (uint64_t) size,
+		     (uint64_t) budget);
+		goto fail_budget;
+	}
+
+	// check the soft cap for the type and the total
+	size_t total = 0;
+	int    t;
+	for(t = 0; t < VKK_MEMORY_TYPE_COUNT; ++t)
+	{
+		total += self->type_usage[t];
+	}
+
+	size_t soft_cap = self->soft_cap[type];
+	if((soft_cap && (self->type_usage[type] + size > soft_cap)) ||
+	   (self->soft_cap[VKK_MEMORY_TYPE_ANY] &&
+	    (total + size > self->soft_cap[VKK_MEMORY_TYPE_ANY])))
+	{
+		LOGW("over soft cap: type=%i, usage=%" PRIu64
+		     ", total=%" PRIu64 ", size=%" PRIu64,
+		     (int) type, (uint64_t) self->type_usage[type],
+		     (uint64_t) total, (uint64_t) size);
+		goto fail_soft_cap;
+	}
+
+	self->heap_usage[heap] += size;
+	self->type_usage[type] += size;
+
+	// update the stats
+	// the ANY index tracks the total peak
+	vkk_memoryStats_t* stats = &self->stats[type];
+	++stats->count_chunk_alloc;
+	if(self->type_usage[type] > stats->size_peak)
+	{
+		stats->size_peak = self->type_usage[type];
+	}
+
+	total += size;
+	stats = &self->stats[VKK_MEMORY_TYPE_ANY];
+	if(total > stats->size_peak)
+	{
+		stats->size_peak = total;
+	}
+
+	pthread_mutex_unlock(&self->budget_mutex);
+
+	// success
+	return 1;
+
+	// failure
+	fail_soft_cap:
+	fail_budget:
+		pthread_mutex_unlock(&self->budget_mutex);
+	return 0;
+}
+
+void vkk_memoryManager_release(vkk_memoryManager_t* self,
+                               uint32_t mt_index,
+                               vkk_memoryType_e type,
+                               size_t size)
+{
+	ASSERT(self);
+
+	uint32_t heap = self->mp.memoryTypes[mt_index].heapIndex;
+
+	pthread_mutex_lock(&self->budget_mutex);
+	self->heap_usage[heap] -= size;
+	self->type_usage[type] -= size;
+	++self->stats[type].count_chunk_free;
+	pthread_mutex_unlock(&self->budget_mutex);
+}
+
+void vkk_memoryManager_recordAllocate(vkk_memoryManager_t* self,
+                                      vkk_memoryType_e type,
+                                      double dt)
+{
+	ASSERT(self);
 
-	vkk_memoryManager_t* self;
-	self = (vkk_memoryManager_t*)
-	       CALLOC(1, sizeof(vkk_memoryManager_t));
-	if(self == NULL)
+	pthread_mutex_lock(&self->budget_mutex);
+
+	vkk_memoryStats_t* stats = &self->stats[type];
+	stats->time_allocate += dt;
+	if(dt > stats->time_allocate_max)
 	{
-		LOGE("CALLOC failed");
-		return NULL;
+		stats->time_allocate_max = dt;
 	}
 
-	self->engine = engine;
+	pthread_mutex_unlock(&self->budget_mutex);
+}
 
-	self->pools = cc_map_new();
-	if(self->pools == NULL)
-	{
-		goto fail_pools;
-	}
+void vkk_memoryManager_stats(vkk_memoryManager_t* self,
+                             vkk_memoryType_e type,
+                             vkk_memoryStats_t* stats)
+{
+	ASSERT(self);
+	ASSERT(stats);
 
-	if(pthread_mutex_init(&self->manager_mutex, NULL) != 0)
-	{
-		LOGE("pthread_mutex_init failed");
-		goto fail_manager_mutex;
-	}
+	memset(stats, 0, sizeof(vkk_memoryStats_t));
 
-	int u;
-	for(u = 0; u < VKK_CHUNK_UPDATERS; ++u)
+	// the manager lock protects the magazine list
+	vkk_memoryManager_lock(self);
+
+	pthread_mutex_lock(&self->budget_mutex);
+	int t;
+	for(t = 0; t < VKK_MEMORY_TYPE_COUNT; ++t)
 	{
-		if(pthread_mutex_init(&self->chunk_mutex[u], NULL) != 0)
+		if((type != VKK_MEMORY_TYPE_ANY) && (type != t))
 		{
-			LOGE("pthread_mutex_init failed");
-			goto fail_chunk_mutex;
+			continue;
 		}
-	}
 
-	int v;
-	for(v = 0; v < VKK_CHUNK_UPDATERS; ++v)
-	{
-		if(pthread_cond_init(&self->chunk_cond[v], NULL) != 0)
+		vkk_memoryStats_t* src = &self->stats[t];
+		stats->count_alloc       += src->count_alloc;
+		stats->count_free        += src->count_free;
+		stats->count_chunk_alloc += src->count_chunk_alloc;
+		stats->count_chunk_free  += src->count_chunk_free;
+		stats->size_requested    += src->size_requested;
+		stats->size_allocated    += src->size_allocated;
+		stats->time_allocate     += src->time_allocate;
+		if(src->time_allocate_max > stats->time_allocate_max)
 		{
-			LOGE("pthread_cond_init failed");
-			goto fail_chunk_cond;
+			stats->time_allocate_max = src->time_allocate_max;
+		}
+
+		int i;
+		for(i = 0; i < VKK_MEMORY_HISTOGRAM_COUNT; ++i)
+		{
+			stats->histogram_requested[i] += src->histogram_requested[i];
+			stats->histogram_allocated[i] += src->histogram_allocated[i];
 		}
 	}
+	stats->size_peak = self->stats[type].size_peak;
+	pthread_mutex_unlock(&self->budget_mutex);
 
-	if(pthread_cond_init(&self->pool_cond, NULL) != 0)
+	cc_listIter_t* iter = cc_list_head(self->magazines);
+	while(iter)
 	{
-		LOGE("pthread_cond_init failed");
-		goto fail_pool_cond;
+		vkk_memoryMagazine_t* magazine;
+		magazine = (vkk_memoryMagazine_t*)
+		           cc_list_peekIter(iter);
+		vkk_memoryMagazine_stats(magazine, type, stats);
+		iter = cc_list_next(iter);
 	}
 
-	// success
-	return self;
+	vkk_memoryManager_unlock(self);
+}
 
-	// failure
-	fail_pool_cond:
+int vkk_memoryManager_statsDump(vkk_memoryManager_t* self,
+                                const char* fname)
+{
+	ASSERT(self);
+	ASSERT(fname);
+
+	const char* type_name[VKK_MEMORY_TYPE_COUNT + 1] =
 	{
-		int i;
-		for(i = 0; i < v; ++i)
-		{
-			pthread_cond_destroy(&self->chunk_cond[i]);
-		}
+		"system",
+		"device",
+		"transient",
+		"any",
+	};
+
+	FILE* f = fopen(fname, "w");
+	if(f == NULL)
+	{
+		LOGE("invalid %s", fname);
+		return 0;
 	}
-	fail_chunk_cond:
+
+	fprintf(f, "{\n");
+
+	int t;
+	for(t = 0; t <= VKK_MEMORY_TYPE_ANY; ++t)
 	{
+		vkk_memoryStats_t stats;
+		vkk_memoryManager_stats(self, t, &stats);
+
+		fprintf(f, "\t\"%s\":\n\t{\n", type_name[t]);
+		fprintf(f, "\t\t\"count_alloc\": %" PRIu64 ",\n",
+		        (uint64_t) stats.count_alloc);
+		fprintf(f, "\t\t\"count_free\": %" PRIu64 ",\n",
+		        (uint64_t) stats.count_free);
+		fprintf(f, "\t\t\"count_chunk_alloc\": %" PRIu64 ",\n",
+		        (uint64_t) stats.count_chunk_alloc);
+		fprintf(f, "\t\t\"count_chunk_free\": %" PRIu64 ",\n",
+		        (uint64_t) stats.count_chunk_free);
+		fprintf(f, "\t\t\"size_requested\": %" PRIu64 ",\n",
+		        (uint64_t) stats.size_requested);
+		fprintf(f, "\t\t\"size_allocated\": %" PRIu64 ",\n",
+		        (uint64_t) stats.size_allocated);
+		fprintf(f, "\t\t\"size_peak\": %" PRIu64 ",\n",
+		        (uint64_t) stats.size_peak);
+		fprintf(f, "\t\t\"time_allocate\": %lf,\n",
+		        stats.time_allocate);
+		fprintf(f, "\t\t\"time_allocate_max\": %lf,\n",
+		        stats.time_allocate_max);
+
 		int i;
-		for(i = 0; i < u; ++i)
+		fprintf(f, "\t\t\"histogram_requested\": [");
+		for(i = 0; i < VKK_MEMORY_HISTOGRAM_COUNT; ++i)
 		{
-			pthread_mutex_destroy(&self->chunk_mutex[i]);
+			fprintf(f, "%s%" PRIu64, i ? ", " : "",
+			        (uint64_t) stats.histogram_requested[i]);
 		}
-	}
-	fail_chunk_mutex:
-		pthread_mutex_destroy(&self->manager_mutex);
-	fail_manager_mutex:
-		cc_map_delete(&self->pools);
-	fail_pools:
-		FREE(self);
-	return NULL;
-}
+		fprintf(f, "],\n");
 
-void vkk_memoryManager_delete(vkk_memoryManager_t** _self)
-{
-	ASSERT(_self);
+		fprintf(f, "\t\t\"histogram_allocated\": [");
+		for(i = 0; i < VKK_MEMORY_HISTOGRAM_COUNT; ++i)
+		{
+			fprintf(f, "%s%" PRIu64, i ? ", " : "",
+			        (uint64_t) stats.histogram_allocated[i]);
+		}
+		fprintf(f, "]\n");
 
-	vkk_memoryManager_t* self = *_self;
-	if(self)
+		fprintf(f, "\t},\n");
+	}
+
+	// allocation counts per memory type for each class
+	const char* class_name[VKK_MEMORY_CLASS_COUNT] =
 	{
-		ASSERT(cc_map_size(self->pools) == 0);
+		"upload",
+		"device",
+		"readback",
+		"dynamic",
+	};
 
-		pthread_cond_destroy(&self->pool_cond);
+	fprintf(f, "\t\"classes\":\n\t{\n");
 
-		int u;
-		for(u = 0; u < VKK_CHUNK_UPDATERS; ++u)
+	int c;
+	for(c = 0; c < VKK_MEMORY_CLASS_COUNT; ++c)
+	{
+		fprintf(f, "\t\t\"%s\": {", class_name[c]);
+
+		int      first = 1;
+		uint32_t i;
+		for(i = 0; i < self->mp.memoryTypeCount; ++i)
 		{
-			pthread_cond_destroy(&self->chunk_cond[u]);
-			pthread_mutex_destroy(&self->chunk_mutex[u]);
+			uint64_t count;
+			count = __atomic_load_n(&self->class_count[c][i],
+			                        __ATOMIC_RELAXED);
+			if(count)
+			{
+				fprintf(f, "%s\"%u\": %" PRIu64,
+				        first ? "" : ", ", i, count);
+				first = 0;
+			}
 		}
-		pthread_mutex_destroy(&self->manager_mutex);
-		cc_map_delete(&self->pools);
-		FREE(self);
-		*_self = NULL;
+
+		fprintf(f, "}%s\n",
+		        (c == VKK_MEMORY_CLASS_COUNT - 1) ? "" : ",");
 	}
-}
 
-void vkk_memoryManager_shutdown(vkk_memoryManager_t* self)
-{
-	ASSERT(self);
+	fprintf(f, "\t}\n");
+	fprintf(f, "}\n");
+	fclose(f);
 
-	vkk_memoryManager_lock(self);
-	self->shutdown = 1;
-	vkk_memoryManager_unlock(self);
+	return 1;
 }
 
 vkk_memory_t*
 vkk_memoryManager_allocBuffer(vkk_memoryManager_t* self,
                               VkBuffer buffer,
-                              int device_memory,
+                              vkk_memoryClass_e mclass,
+                              vkk_memoryPriority_e priority,
                               size_t size,
-                              const void* buf)
+                              const void* buf,
+                              int evict)
 {
 	// buf may be NULL
 	ASSERT(self);
 
 	vkk_engine_t* engine = self->engine;
 
-	vkk_memoryType_e type = VKK_MEMORY_TYPE_SYSTEM;
-
+	int                  dedicated;
 	VkMemoryRequirements mr;
-	vkGetBufferMemoryRequirements(engine->device,
-	                              buffer, &mr);
-
-	VkFlags mp_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-	                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-	if(device_memory)
-	{
-		mp_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-		type     = VKK_MEMORY_TYPE_DEVICE;
-	}
+	vkk_memoryManager_bufferRequirements(self, buffer, &mr,
+	                                     &dedicated);
 
 	// memory is unitialized
 	vkk_memory_t* memory;
-	memory = vkk_memoryManager_alloc(self, &mr, mp_flags,
-	                                 type);
+	memory = vkk_memoryManager_allocClass(self, &mr, mclass,
+	                                      priority, 0, dedicated,
+	                                      buffer, evict);
 	if(memory == NULL)
 	{
 		return NULL;
 	}
 
-	// initialize non-device memory
-	if(device_memory == 0)
+	// initialize upload/dynamic memory
+	// readback memory is uninitialized since it is written
+	// by the GPU and CPU writes to non-coherent memory could
+	// be evicted from the cache after the GPU writes
+	if((mclass == VKK_MEMORY_CLASS_UPLOAD) ||
+	   (mclass == VKK_MEMORY_CLASS_DYNAMIC))
 	{
 		if(buf)
 		{
@@ -505,11 +2611,59 @@ vkk_memoryManager_allocBuffer(vkk_memoryManager_t* self,
 	return NULL;
 }
 
+vkk_memory_t*
+vkk_memoryManager_allocShared(vkk_memoryManager_t* self,
+                              vkk_memoryClass_e mclass,
+                              vkk_memoryPriority_e priority,
+                              VkBufferUsageFlags usage,
+                              size_t size,
+                              const void* buf)
+{
+	// buf may be NULL
+	ASSERT(self);
+	ASSERT((mclass == VKK_MEMORY_CLASS_UPLOAD) ||
+	       (mclass == VKK_MEMORY_CLASS_DYNAMIC));
+	ASSERT(size <= VKK_MEMORY_SHARED_SIZE);
+
+	VkMemoryRequirements mr;
+	if(vkk_memoryManager_sharedRequirements(self, usage,
+	                                        &mr) == 0)
+	{
+		return NULL;
+	}
+	mr.size = (VkDeviceSize) size;
+
+	// the memory is suballocated from a shared buffer pool
+	// whose chunks own a VkBuffer which is already bound
+	// note that the pool key includes the memory type so
+	// upload and dynamic buffers use separate pools
+	vkk_memory_t* memory;
+	memory = vkk_memoryManager_allocClass(self, &mr, mclass,
+	                                      priority, usage, 0,
+	                                      VK_NULL_HANDLE, 1);
+	if(memory == NULL)
+	{
+		return NULL;
+	}
+
+	if(buf)
+	{
+		vkk_memoryManager_write(self, memory, 0, size, buf);
+	}
+	else
+	{
+		vkk_memoryManager_clear(self, memory, 0, size);
+	}
+
+	return memory;
+}
+
 vkk_memory_t*
 vkk_memoryManager_allocImage(vkk_memoryManager_t* self,
                              VkImage image,
                              int device_memory,
-                             int transient_memory)
+                             int transient_memory,
+                             vkk_memoryPriority_e priority)
 {
 	ASSERT(self);
 
@@ -517,9 +2671,10 @@ vkk_memoryManager_allocImage(vkk_memoryManager_t* self,
 
 	vkk_memoryType_e type = VKK_MEMORY_TYPE_SYSTEM;
 
+	int                  dedicated;
 	VkMemoryRequirements mr;
-	vkGetImageMemoryRequirements(engine->device,
-	                             image, &mr);
+	vkk_memoryManager_imageRequirements(self, image, &mr,
+	                                    &dedicated);
 
 	// transient_memory is an optional flag allows the
 	// allocation to be performed in tiled memory
@@ -549,8 +2704,11 @@ vkk_memoryManager_allocImage(vkk_memoryManager_t* self,
 
 	// memory is unitialized
 	vkk_memory_t* memory;
-	memory = vkk_memoryManager_alloc(self, &mr, mp_flags,
-	                                 type);
+	memory = vkk_memoryManager_allocEvict(self, &mr, mp_flags,
+	                                      type, priority, 0, 1,
+	                                      dedicated,
+	                                      VK_NULL_HANDLE, image, 1);
+
 	if(memory == NULL)
 	{
 		return NULL;
@@ -582,56 +2740,55 @@ void vkk_memoryManager_free(vkk_memoryManager_t* self,
 	ASSERT(self);
 	ASSERT(_memory);
 
-	vkk_memory_t*    memory = *_memory;
-	vkk_memoryInfo_t info   = { 0 };
-	if(memory)
+	vkk_memory_t* memory = *_memory;
+	if(memory == NULL)
 	{
-		vkk_memoryManager_lock(self);
-
-		// free the memory and delete pool (if necessary);
-		vkk_memoryPool_t* pool = memory->chunk->pool;
-		vkk_memoryType_e  type = pool->type;
-
-		int locked = 0;
-		while(locked == 0)
-		{
-			locked = vkk_memoryManager_poolLock(self, pool);
-		}
+		return;
+	}
 
-		vkk_memoryPoolKey_t key =
-		{
-			.mt_index = (uint32_t) pool->mt_index,
-			.stride   = (uint32_t) pool->stride
-		};
+	vkk_memoryChunk_t* chunk = memory->chunk;
+	vkk_memoryPool_t*  pool  = chunk->pool;
 
-		// call subInfo for either case
-		vkk_memoryChunk_t* chunk = NULL;
-		if(vkk_memoryPool_free(pool, self->shutdown,
-		                       _memory, &chunk, &info))
-		{
-			cc_mapIter_t* miter;
-			miter = cc_map_findp(self->pools,
-			                     sizeof(vkk_memoryPoolKey_t), &key);
+	vkk_memoryMagazine_t* magazine;
+	magazine = vkk_memoryManager_magazine(self);
+	if(magazine)
+	{
+		vkk_memoryMagazine_recordFree(magazine, chunk->type);
+	}
 
-			vkk_memoryPool_t* tmp;
-			tmp = (vkk_memoryPool_t*) cc_map_val(miter);
-			assert(tmp == pool);
+	if(pool == NULL)
+	{
+		vkk_memoryManager_freeDedicated(self, _memory);
+		return;
+	}
 
-			cc_map_remove(self->pools, &miter);
-			vkk_memoryManager_poolUnlock(self, pool);
-		}
-		else
+	// return fixed stride slots to the thread magazine
+	// unless the chunk is being evacuated
+	if(pool->stride && (chunk->evacuate == 0) &&
+	   (self->shutdown == 0))
+	{
+		vkk_memoryBatch_t batch;
+		if(magazine &&
+		   vkk_memoryMagazine_put(magazine, memory, &batch))
 		{
-			vkk_memoryManager_poolUnlock(self, pool);
-			pool = NULL;
+			*_memory = NULL;
+
+			// a full magazine hands off a batch to the depot
+			// or returns the whole batch to the pools under a
+			// single manager lock when the depot is full
+			if(batch.count &&
+			   (vkk_memoryManager_depotPush(self, &batch) == 0) &&
+			   vkk_memoryManager_freeBatch(self, &batch))
+			{
+				vkk_memoryManager_purgeUnlocked(self);
+			}
+			return;
 		}
-		vkk_memoryChunk_delete(&chunk, &info);
-		vkk_memoryManager_subInfo(self, type, &info);
-		vkk_memoryManager_unlock(self);
+	}
 
-		// pool may be deleted while unlocked since it has been
-		// detached from the manager
-		vkk_memoryPool_delete(&pool);
+	if(vkk_memoryManager_freeSlot(self, _memory))
+	{
+		vkk_memoryManager_purgeUnlocked(self);
 	}
 }
 
@@ -643,37 +2800,26 @@ void vkk_memoryManager_clear(vkk_memoryManager_t* self,
 	ASSERT(self);
 	ASSERT(memory);
 
-	vkk_memoryChunk_t*   chunk  = memory->chunk;
-	vkk_memoryPool_t*    pool   = chunk->pool;
-	vkk_memoryManager_t* mm     = pool->mm;
-	vkk_engine_t*        engine = mm->engine;
-
-	vkk_memoryManager_chunkLock(self, chunk);
+	vkk_memoryChunk_t* chunk = memory->chunk;
 
-	if((size == 0) || (size + offset > pool->stride))
+	if((size == 0) || (size + offset > memory->size) ||
+	   (chunk->host_visible == 0))
 	{
 		LOGE("invalid offset=%" PRIu64 ", size=%" PRIu64
-		     ", stride=%" PRIu64,
+		     ", memory_size=%" PRIu64 ", ptr=%p",
 		     (uint64_t) offset, (uint64_t) size,
-		     (uint64_t) pool->stride);
-		vkk_memoryManager_chunkUnlock(self, chunk);
+		     (uint64_t) memory->size, chunk->ptr);
 		return;
 	}
 
-	void* data;
-	if(vkMapMemory(engine->device, chunk->memory,
-	               memory->offset + offset, size, 0,
-	               &data) == VK_SUCCESS)
-	{
-		memset(data, 0, size);
-		vkUnmapMemory(engine->device, chunk->memory);
-	}
-	else
+	char* data = vkk_memoryManager_beginAccess(self, chunk);
+	if(data == NULL)
 	{
-		LOGW("vkMapMemory failed");
+		return;
 	}
 
-	vkk_memoryManager_chunkUnlock(self, chunk);
+	memset(&data[memory->offset + offset], 0, size);
+	vkk_memoryManager_endAccess(self, memory, offset, size, 1);
 }
 
 void vkk_memoryManager_read(vkk_memoryManager_t* self,
@@ -685,37 +2831,47 @@ void vkk_memoryManager_read(vkk_memoryManager_t* self,
 	ASSERT(memory);
 	ASSERT(buf);
 
-	vkk_memoryChunk_t*   chunk  = memory->chunk;
-	vkk_memoryPool_t*    pool   = chunk->pool;
-	vkk_memoryManager_t* mm     = pool->mm;
-	vkk_engine_t*        engine = mm->engine;
-
-	vkk_memoryManager_chunkLock(self, chunk);
+	vkk_memoryChunk_t* chunk = memory->chunk;
 
-	if((size == 0) || (size + offset > pool->stride))
+	if((size == 0) || (size + offset > memory->size) ||
+	   (chunk->host_visible == 0))
 	{
 		LOGE("invalid offset=%" PRIu64 ", size=%" PRIu64
-		     ", stride=%" PRIu64,
+		     ", memory_size=%" PRIu64 ", ptr=%p",
 		     (uint64_t) offset, (uint64_t) size,
-		     (uint64_t) pool->stride);
-		vkk_memoryManager_chunkUnlock(self, chunk);
+		     (uint64_t) memory->size, chunk->ptr);
 		return;
 	}
 
-	void* data;
-	if(vkMapMemory(engine->device, chunk->memory,
-	               memory->offset + offset, size, 0,
-	               &data) == VK_SUCCESS)
+	char* data = vkk_memoryManager_beginAccess(self, chunk);
+	if(data == NULL)
 	{
-		memcpy(buf, data, size);
-		vkUnmapMemory(engine->device, chunk->memory);
+		return;
 	}
-	else
+
+	memcpy(buf, &data[memory->offset + offset], size);
+	vkk_memoryManager_endAccess(self, memory, offset, size, 0);
+}
+
+const void*
+vkk_memoryManager_map(vkk_memoryManager_t* self,
+                      vkk_memory_t* memory)
+{
+	ASSERT(self);
+	ASSERT(memory);
+
+	vkk_memoryChunk_t* chunk = memory->chunk;
+
+	// chunks are persistently mapped and their allocations
+	// are never relocated
+	const char* data = vkk_memoryManager_mapChunk(self, chunk);
+	if(data == NULL)
 	{
-		LOGW("vkMapMemory failed");
+		LOGE("invalid ptr");
+		return NULL;
 	}
 
-	vkk_memoryManager_chunkUnlock(self, chunk);
+	return &data[memory->offset];
 }
 
 void vkk_memoryManager_write(vkk_memoryManager_t* self,
@@ -728,37 +2884,63 @@ void vkk_memoryManager_write(vkk_memoryManager_t* self,
 	ASSERT(memory);
 	ASSERT(buf);
 
-	vkk_memoryChunk_t*   chunk  = memory->chunk;
-	vkk_memoryPool_t*    pool   = chunk->pool;
-	vkk_memoryManager_t* mm     = pool->mm;
-	vkk_engine_t*        engine = mm->engine;
-
-	vkk_memoryManager_chunkLock(self, chunk);
+	vkk_memoryChunk_t* chunk = memory->chunk;
 
-	if((size == 0) || (size + offset > pool->stride))
+	if((size == 0) || (size + offset > memory->size) ||
+	   (chunk->host_visible == 0))
 	{
 		LOGE("invalid offset=%" PRIu64 ", size=%" PRIu64
-		     ", stride=%" PRIu64,
+		     ", memory_size=%" PRIu64 ", ptr=%p",
 		     (uint64_t) offset, (uint64_t) size,
-		     (uint64_t) pool->stride);
-		vkk_memoryManager_chunkUnlock(self, chunk);
+		     (uint64_t) memory->size, chunk->ptr);
 		return;
 	}
 
-	void* data;
-	if(vkMapMemory(engine->device, chunk->memory,
-	               memory->offset + offset, size, 0,
-	               &data) == VK_SUCCESS)
+	char* data = vkk_memoryManager_beginAccess(self, chunk);
+	if(data == NULL)
 	{
-		memcpy(data, buf, size);
-		vkUnmapMemory(engine->device, chunk->memory);
+		return;
 	}
-	else
+
+	memcpy(&data[memory->offset + offset], buf, size);
+	vkk_memoryManager_endAccess(self, memory, offset, size, 1);
+}
+
+void vkk_memoryManager_writeF16(vkk_memoryManager_t* self,
+                                vkk_memory_t* memory,
+                                size_t offset,
+                                size_t size,
+                                const float* buf)
+{
+	ASSERT(self);
+	ASSERT(memory);
+	ASSERT(buf);
+
+	vkk_memoryChunk_t* chunk = memory->chunk;
+
+	// size is the F16 size while buf contains F32 values
+	if((size == 0) || (size%2) ||
+	   (size + offset > memory->size) ||
+	   (chunk->host_visible == 0))
 	{
-		LOGW("vkMapMemory failed");
+		LOGE("invalid offset=%" PRIu64 ", size=%" PRIu64
+		     ", memory_size=%" PRIu64 ", ptr=%p",
+		     (uint64_t) offset, (uint64_t) size,
+		     (uint64_t) memory->size, chunk->ptr);
+		return;
 	}
 
-	vkk_memoryManager_chunkUnlock(self, chunk);
+	// convert directly into the mapped memory to avoid an
+	// intermediate copy
+	char* data = vkk_memoryManager_beginAccess(self, chunk);
+	if(data == NULL)
+	{
+		return;
+	}
+
+	vkk_util_convertF16((uint16_t*) &data[memory->offset + offset],
+	                    buf, size/2);
+	vkk_memoryManager_endAccess(self, memory, offset, size, 1);
 }
 
 void vkk_memoryManager_blit(vkk_memoryManager_t* self,
@@ -772,78 +2954,123 @@ void vkk_memoryManager_blit(vkk_memoryManager_t* self,
 	ASSERT(src_memory);
 	ASSERT(dst_memory);
 
-	vkk_memoryChunk_t*   src_chunk = src_memory->chunk;
-	vkk_memoryChunk_t*   dst_chunk = dst_memory->chunk;
-	vkk_memoryPool_t*    src_pool  = src_chunk->pool;
-	vkk_memoryPool_t*    dst_pool  = dst_chunk->pool;
-	vkk_memoryManager_t* mm        = src_pool->mm;
-	vkk_engine_t*        engine    = mm->engine;
-
-	vkk_memoryManager_chunkLock(self, src_chunk);
-	if(src_chunk != dst_chunk)
-	{
-		vkk_memoryManager_chunkLock(self, dst_chunk);
-	}
+	vkk_memoryChunk_t* src_chunk = src_memory->chunk;
+	vkk_memoryChunk_t* dst_chunk = dst_memory->chunk;
 
 	if((size == 0) ||
-	   (size + src_offset > src_pool->stride) ||
-	   (size + dst_offset > dst_pool->stride))
+	   (size + src_offset > src_memory->size) ||
+	   (size + dst_offset > dst_memory->size) ||
+	   (src_chunk->host_visible == 0) ||
+	   (dst_chunk->host_visible == 0))
 	{
 		LOGE("invalid src_offset=%" PRIu64 ", size=%" PRIu64
-		     ", stride=%" PRIu64,
+		     ", memory_size=%" PRIu64 ", ptr=%p",
 		     (uint64_t) src_offset, (uint64_t) size,
-		     (uint64_t) src_pool->stride);
+		     (uint64_t) src_memory->size, src_chunk->ptr);
 		LOGE("invalid dst_offset=%" PRIu64 ", size=%" PRIu64
-		     ", stride=%" PRIu64,
+		     ", memory_size=%" PRIu64 ", ptr=%p",
 		     (uint64_t) dst_offset, (uint64_t) size,
-		     (uint64_t) dst_pool->stride);
+		     (uint64_t) dst_memory->size, dst_chunk->ptr);
+		return;
+	}
 
-		goto fail_size;
+	char* src_data = vkk_memoryManager_beginAccess(self, src_chunk);
+	if(src_data == NULL)
+	{
+		return;
 	}
 
-	void* src_data;
-	if(vkMapMemory(engine->device, src_chunk->memory,
-	               src_memory->offset + src_offset, size, 0,
-	               &src_data) != VK_SUCCESS)
+	char* dst_data = src_data;
+	if(src_chunk != dst_chunk)
 	{
-		LOGW("vkMapMemory failed");
-		goto fail_src;
+		dst_data = vkk_memoryManager_beginAccess(self, dst_chunk);
+		if(dst_data == NULL)
+		{
+			vkk_memoryManager_endAccess(self, src_memory,
+			                            src_offset, size, 0);
+			return;
+		}
 	}
 
-	void* dst_data;
-	if(vkMapMemory(engine->device, dst_chunk->memory,
-	               dst_memory->offset + dst_offset, size, 0,
-	               &dst_data) != VK_SUCCESS)
+	memcpy(&dst_data[dst_memory->offset + dst_offset],
+	       &src_data[src_memory->offset + src_offset], size);
+
+	if(src_chunk != dst_chunk)
 	{
-		LOGW("vkMapMemory failed");
-		goto fail_dst;
+		vkk_memoryManager_endAccess(self, src_memory,
+		                            src_offset, size, 0);
 	}
+	vkk_memoryManager_endAccess(self, dst_memory,
+	                            dst_offset, size, 1);
+}
 
-	memcpy(dst_data, src_data, size);
+void vkk_memoryManager_flush(vkk_memoryManager_t* self)
+{
+	ASSERT(self);
 
-	vkUnmapMemory(engine->device, dst_chunk->memory);
-	vkUnmapMemory(engine->device, src_chunk->memory);
+	vkk_engine_t* engine = self->engine;
 
-	if(src_chunk != dst_chunk)
+	pthread_mutex_lock(&self->dirty_mutex);
+
+	// flush the dirty ranges of all non-coherent chunks
+	// in batches to limit the stack usage
+	VkMappedMemoryRange ranges[VKK_MEMORY_FLUSH_BATCH];
+	uint32_t            count = 0;
+	cc_listIter_t*      iter  = cc_list_head(self->dirty);
+	while(iter)
 	{
-		vkk_memoryManager_chunkUnlock(self, dst_chunk);
+		vkk_memoryChunk_t* chunk;
+		chunk = (vkk_memoryChunk_t*)
+		        cc_list_remove(self->dirty, &iter);
+
+		int u = chunk->updater;
+		pthread_mutex_lock(&self->chunk_mutex[u]);
+		chunk->dirty = NULL;
+		vkk_memoryManager_mappedRange(self, chunk,
+		                              chunk->dirty_begin,
+		                              chunk->dirty_end,
+		                              &ranges[count]);
+		pthread_mutex_unlock(&self->chunk_mutex[u]);
+		++count;
+
+		if((count == VKK_MEMORY_FLUSH_BATCH) || (iter == NULL))
+		{
+			if(vkFlushMappedMemoryRanges(engine->device, count,
+			                             ranges) != VK_SUCCESS)
+			{
+				LOGW("vkFlushMappedMemoryRanges failed");
+			}
+			count = 0;
+		}
 	}
-	vkk_memoryManager_chunkUnlock(self, src_chunk);
 
-	// success
-	return;
+	pthread_mutex_unlock(&self->dirty_mutex);
+}
 
-	// failure
-	fail_dst:
-		vkUnmapMemory(engine->device, src_chunk->memory);
-	fail_src:
-	fail_size:
+void vkk_memoryManager_invalidate(vkk_memoryManager_t* self,
+                                  vkk_memory_t* memory)
+{
+	ASSERT(self);
+	ASSERT(memory);
+
+	vkk_engine_t*      engine = self->engine;
+	vkk_memoryChunk_t* chunk  = memory->chunk;
+
+	// make the GPU writes visible to the CPU
+	// note that the memory must be mapped to invalidate
+	if(chunk->non_coherent &&
+	   vkk_memoryManager_mapChunk(self, chunk))
 	{
-		if(src_chunk != dst_chunk)
+		VkMappedMemoryRange range;
+		vkk_memoryManager_mappedRange(self, chunk,
+		                              memory->offset,
+		                              memory->offset + memory->size,
+		                              &range);
+		if(vkInvalidateMappedMemoryRanges(engine->device, 1,
+		                                  &range) != VK_SUCCESS)
 		{
-			vkk_memoryManager_chunkUnlock(self, dst_chunk);
+			LOGW("vkInvalidateMappedMemoryRanges failed");
 		}
-		vkk_memoryManager_chunkUnlock(self, src_chunk);
 	}
 }
 
@@ -857,15 +3084,30 @@ void vkk_memoryManager_memoryInfo(vkk_memoryManager_t* self,
 
 	vkk_memoryManager_lock(self);
 
+	// copy the memory info which is protected by the info
+	// mutex since the pools may not be locked while the
+	// info mutex is held
+	vkk_memoryInfo_t info_type[VKK_MEMORY_TYPE_COUNT];
+	pthread_mutex_lock(&self->info_mutex);
+	memcpy(info_type, self->info, sizeof(info_type));
+	pthread_mutex_unlock(&self->info_mutex);
+
 	vkk_memoryInfo_t info_any = { 0 };
 
 	int i;
 	for(i = 0; i < VKK_MEMORY_TYPE_COUNT; ++i)
 	{
-		info_any.count_chunks += self->info[i].count_chunks;
-		info_any.count_slots  += self->info[i].count_slots;
-		info_any.size_chunks  += self->info[i].size_chunks;
-		info_any.size_slots   += self->info[i].size_slots;
+		info_any.count_chunks    += info_type[i].count_chunks;
+		info_any.count_slots     += info_type[i].count_slots;
+		info_any.count_dedicated += info_type[i].count_dedicated;
+		info_any.size_chunks     += info_type[i].size_chunks;
+		info_any.size_slots      += info_type[i].size_slots;
+		info_any.size_dedicated  += info_type[i].size_dedicated;
+		info_any.count_retained  += info_type[i].count_retained;
+		info_any.size_retained   += info_type[i].size_retained;
+		info_any.count_reclaimed += info_type[i].count_reclaimed;
+		info_any.size_reclaimed  += info_type[i].size_reclaimed;
+		info_any.count_shared    += info_type[i].count_shared;
 	}
 
 	// store the requested memory info
@@ -876,7 +3118,7 @@ void vkk_memoryManager_memoryInfo(vkk_memoryManager_t* self,
 	}
 	else
 	{
-		memcpy(info, &self->info[type],
+		memcpy(info, &info_type[type],
 		       sizeof(vkk_memoryInfo_t));
 	}
 
@@ -892,33 +3134,78 @@ void vkk_memoryManager_memoryInfo(vkk_memoryManager_t* self,
 
 		LOGI("MEMINFO: type=any, count_chunks=%" PRIu64
 		     ", count_slots=%" PRIu64
+		     ", count_dedicated=%" PRIu64
 		     ", size_chunks=%" PRIu64
-		     ", size_slots=%" PRIu64,
+		     ", size_slots=%" PRIu64
+		     ", size_dedicated=%" PRIu64
+		     ", count_retained=%" PRIu64
+		     ", size_retained=%" PRIu64
+		     ", count_reclaimed=%" PRIu64
+		     ", size_reclaimed=%" PRIu64
+		     ", count_shared=%" PRIu64,
 		     (uint64_t) info_any.count_chunks,
 		     (uint64_t) info_any.count_slots,
+		     (uint64_t) info_any.count_dedicated,
 		     (uint64_t) info_any.size_chunks,
-		     (uint64_t) info_any.size_slots);
+		     (uint64_t) info_any.size_slots,
+		     (uint64_t) info_any.size_dedicated,
+		     (uint64_t) info_any.count_retained,
+		     (uint64_t) info_any.size_retained,
+		     (uint64_t) info_any.count_reclaimed,
+		     (uint64_t) info_any.size_reclaimed,
+		     (uint64_t) info_any.count_shared);
 
 		for(i = 0; i < VKK_MEMORY_TYPE_COUNT; ++i)
 		{
 			LOGI("MEMINFO: type=%s, count_chunks=%" PRIu64
 			     ", count_slots=%" PRIu64
+			     ", count_dedicated=%" PRIu64
 			     ", size_chunks=%" PRIu64
-			     ", size_slots=%" PRIu64,
+			     ", size_slots=%" PRIu64
+			     ", size_dedicated=%" PRIu64
+			     ", count_retained=%" PRIu64
+			     ", size_retained=%" PRIu64
+			     ", count_reclaimed=%" PRIu64
+			     ", size_reclaimed=%" PRIu64
+			     ", count_shared=%" PRIu64,
 			     type_name[i],
-			     (uint64_t) self->info[i].count_chunks,
-			     (uint64_t) self->info[i].count_slots,
-			     (uint64_t) self->info[i].size_chunks,
-			     (uint64_t) self->info[i].size_slots);
+			     (uint64_t) info_type[i].count_chunks,
+			     (uint64_t) info_type[i].count_slots,
+			     (uint64_t) info_type[i].count_dedicated,
+			     (uint64_t) info_type[i].size_chunks,
+			     (uint64_t) info_type[i].size_slots,
+			     (uint64_t) info_type[i].size_dedicated,
+			     (uint64_t) info_type[i].count_retained,
+			     (uint64_t) info_type[i].size_retained,
+			     (uint64_t) info_type[i].count_reclaimed,
+			     (uint64_t) info_type[i].size_reclaimed,
+			     (uint64_t) info_type[i].count_shared);
 		}
 
-		cc_mapIter_t* miter = cc_map_head(self->pools);
-		while(miter)
+		cc_listIter_t* iter = cc_list_head(self->pool_list);
+		while(iter)
 		{
 			vkk_memoryPool_t* pool;
-			pool = (vkk_memoryPool_t*) cc_map_val(miter);
+			pool = (vkk_memoryPool_t*) cc_list_peekIter(iter);
+			vkk_memoryManager_poolLock(self, pool);
 			vkk_memoryPool_memoryInfo(pool, type);
-			miter = cc_map_next(miter);
+			vkk_memoryManager_poolUnlock(self, pool);
+			iter = cc_list_next(iter);
+		}
+
+		iter = cc_list_head(self->dedicated);
+		while(iter)
+		{
+			vkk_memoryChunk_t* chunk;
+			chunk = (vkk_memoryChunk_t*) cc_list_peekIter(iter);
+			if((type == VKK_MEMORY_TYPE_ANY) ||
+			   (type == chunk->type))
+			{
+				LOGI("DEDICATED: type=%s, size=%" PRIu64,
+				     type_name[chunk->type],
+				     (uint64_t) chunk->size);
+			}
+			iter = cc_list_next(iter);
 		}
 	}
 	vkk_memoryManager_unlock(self);
@@ -26,40 +26,287 @@
 
 #include <pthread.h>
 
-#include "../../libcc/cc_map.h"
+#include "../../libcc/cc_list.h"
 #include "vkk_memory.h"
+#include "vkk_memoryMagazine.h"
+#include "vkk_memoryPool.h"
 
 #define VKK_CHUNK_UPDATERS 8
 
+// maximum number of ranges per vkFlushMappedMemoryRanges
+#define VKK_MEMORY_FLUSH_BATCH 16
+
+// host visible chunks are mapped once for the chunk lifetime
+// set VKK_MEMORY_PERSISTENT_MAP to 0 to select the legacy
+// path which maps the chunk under the chunk lock for each
+// clear/read/write/blit (e.g. to compare the xmem-test
+// benchmark before/after the persistent map)
+#ifndef VKK_MEMORY_PERSISTENT_MAP
+#define VKK_MEMORY_PERSISTENT_MAP 1
+#endif
+
+// allocations are rounded up to a power-of-two stride and
+// suballocated from fixed stride pools when the stride is
+// less than or equal to VKK_MEMORY_STRIDE_MAX, otherwise
+// they are suballocated from variable size (TLSF) pools
+// set VKK_MEMORY_STRIDE_MAX to 0 to select variable size
+// pools for all allocations or to 0xFFFFFFFF to select
+// fixed stride pools for all allocations
+#ifndef VKK_MEMORY_STRIDE_MAX
+#define VKK_MEMORY_STRIDE_MAX 16384
+#endif
+
+// default size of variable size chunks
+#ifndef VKK_MEMORY_TLSF_CHUNK_SIZE
+#define VKK_MEMORY_TLSF_CHUNK_SIZE (16*1024*1024)
+#endif
+
+// allocations which are larger than or equal to
+// VKK_MEMORY_DEDICATED_SIZE bypass the pools and receive a
+// dedicated Vulkan memory allocation
+#ifndef VKK_MEMORY_DEDICATED_SIZE
+#define VKK_MEMORY_DEDICATED_SIZE (4*1024*1024)
+#endif
+
+// empty pool chunks are retained up to
+// VKK_MEMORY_RETAIN_SIZE bytes per memory type to avoid
+// repeatedly freeing and allocating Vulkan memory when
+// allocations churn and the least recently emptied chunks
+// are released first when the budget is exceeded
+#ifndef VKK_MEMORY_RETAIN_SIZE
+#define VKK_MEMORY_RETAIN_SIZE (16*1024*1024)
+#endif
+
+// pool chunks whose usage drops below
+// VKK_MEMORY_DEFRAG_USAGE percent are considered sparse and
+// are evacuated when the denser chunks in the pool have
+// enough free space to absorb their live bytes
+#ifndef VKK_MEMORY_DEFRAG_USAGE
+#define VKK_MEMORY_DEFRAG_USAGE 25
+#endif
+
+// small uniform/vertex/index buffers which are less than or
+// equal to VKK_MEMORY_SHARED_SIZE are suballocated from
+// large VkBuffers (owned by the shared pool chunks) rather
+// than creating a VkBuffer per buffer
+// set VKK_MEMORY_SHARED_SIZE to 0 to disable shared buffers
+#ifndef VKK_MEMORY_SHARED_SIZE
+#define VKK_MEMORY_SHARED_SIZE 65536
+#endif
+
+// dynamic buffers prefer device local host visible memory
+// (resizable BAR or UMA) when the heap which backs the memory
+// type is larger than VKK_MEMORY_DYNAMIC_HEAP_SIZE since
+// the legacy BAR window (typically 256MB) is too small to
+// hold the per-frame data of all apps
+// set VKK_MEMORY_DYNAMIC_HEAP_SIZE to 0xFFFFFFFFFFFFFFFF to
+// disable device local host visible memory
+#ifndef VKK_MEMORY_DYNAMIC_HEAP_SIZE
+#define VKK_MEMORY_DYNAMIC_HEAP_SIZE (256*1024*1024)
+#endif
+
+// full magazine classes hand off batches of slots to a
+// shared depot which holds up to VKK_MEMORY_DEPOT_SIZE
+// batches for other threads to refill their magazines
+// (e.g. when buffers are freed by the destruct thread)
+#ifndef VKK_MEMORY_DEPOT_SIZE
+#define VKK_MEMORY_DEPOT_SIZE 16
+#endif
+
+// maximum number of buffer usages for shared buffers
+#define VKK_MEMORY_SHARED_USAGES 4
+
+// pools are indexed directly by the priority, mt_index,
+// optimal flag, shared usage and log2(stride) where bin 0 selects the
+// variable size pool (see vkk_memoryManager_poolIndex)
+#define VKK_MEMORY_POOL_BINS  33
+#define VKK_MEMORY_POOL_COUNT \
+	(VKK_MEMORY_PRIORITY_COUNT*VK_MAX_MEMORY_TYPES*2* \
+	 (VKK_MEMORY_SHARED_USAGES + 1)*VKK_MEMORY_POOL_BINS)
+
+// buffer memory classes
+// upload memory is host visible and coherent, device memory
+// is device local, readback memory prefers host cached
+// memory since CPU reads of uncached (write combined)
+// memory are very slow and dynamic memory prefers device
+// local host visible memory for data which is written by
+// the CPU and read by the GPU every frame (falling back to
+// upload memory)
+typedef enum
+{
+	VKK_MEMORY_CLASS_UPLOAD   = 0,
+	VKK_MEMORY_CLASS_DEVICE   = 1,
+	VKK_MEMORY_CLASS_READBACK = 2,
+	VKK_MEMORY_CLASS_DYNAMIC  = 3,
+} vkk_memoryClass_e;
+
+#define VKK_MEMORY_CLASS_COUNT 4
+
 typedef struct vkk_memoryManager_s
 {
 	vkk_engine_t* engine;
 
 	int shutdown;
 
-	// map from mt_index/stride to memory pool
-	cc_map_t* pools;
+	// memory type properties
+	VkPhysicalDeviceMemoryProperties mp;
+
+	// pool table indexed by the pool key
+	// pools are created on demand (under the manager lock),
+	// published with an atomic store and persist for the
+	// manager lifetime so the lookup does not require the
+	// manager lock or hashing and allocating from an
+	// existing pool only requires the pool lock
+	// the table is allocated separately since it holds
+	// VKK_MEMORY_POOL_COUNT mostly unused entries
+	vkk_memoryPool_t** pools;
+
+	// populated pools in creation order (protected by the
+	// manager lock) so passes over the pools do not visit
+	// every slot of the sparse pool table
+	cc_list_t* pool_list;
+
+	// shared buffer memory requirements which only depend
+	// on the buffer usage and are queried once per usage
+	// entries are immutable once shared_count is published
+	uint32_t             shared_count;
+	VkBufferUsageFlags   shared_usage[VKK_MEMORY_SHARED_USAGES];
+	VkMemoryRequirements shared_mr[VKK_MEMORY_SHARED_USAGES];
+	VkDeviceSize         ub_align;
+
+	// memory types which are device local, host visible and
+	// coherent and whose heap is large enough for dynamic
+	// buffers
+	uint32_t dynamic_bits;
+
+	// allocation counts per memory class and memory type
+	// to report which memory type each class landed in
+	uint64_t class_count[VKK_MEMORY_CLASS_COUNT][VK_MAX_MEMORY_TYPES];
+
+	// linear (buffer) and optimal (image) resources share
+	// pools unless the slots/blocks are not aligned to the
+	// bufferImageGranularity
+	VkDeviceSize granularity;
+
+	// dedicated chunks
+	cc_list_t* dedicated;
 
+	// non-coherent chunks with unflushed CPU writes
+	// the list is protected by the dirty mutex and the dirty
+	// range of each chunk by its chunk mutex so that writes
+	// to a chunk which is already dirty only lock the chunk
+	// (the lock order is dirty then chunk)
+	cc_list_t*      dirty;
+	VkDeviceSize    atom_size;
+	pthread_mutex_t dirty_mutex;
+
+	// retained empty chunks in LRU order (protected by the
+	// info mutex)
+	cc_list_t* retained[VKK_MEMORY_TYPE_COUNT];
+
+	// per-thread slot caches
+	pthread_key_t magazine_key;
+	cc_list_t*    magazines;
+
+	// batches of fixed stride slots handed off by full
+	// magazines (protected by the depot mutex which is
+	// acquired after the manager lock)
+	uint32_t          depot_count;
+	vkk_memoryBatch_t depot[VKK_MEMORY_DEPOT_SIZE];
+	pthread_mutex_t   depot_mutex;
+
+	// set when a chunk is evacuated so the cached slots of
+	// the chunk are purged from the magazines and depot
+	// (protected by the manager lock)
+	int purge;
+
+	// memory budget
+	// heap_usage and type_usage are the sizes of the Vulkan
+	// allocations per heap and per memory type, soft_cap is
+	// the app limit per memory type (where the ANY index
+	// limits the total) and evict_fn is called when an
+	// allocation exceeds the budget
+	size_t             heap_usage[VK_MAX_MEMORY_HEAPS];
+	size_t             type_usage[VKK_MEMORY_TYPE_COUNT];
+	size_t             soft_cap[VKK_MEMORY_TYPE_COUNT + 1];
+	void*              evict_priv;
+	vkk_engine_evictFn evict_fn;
+	pthread_mutex_t    budget_mutex;
+
+	// lifetime chunk stats (protected by the budget mutex)
+	// and the allocation stats of exited threads
+	// the ANY index tracks the total peak
+	vkk_memoryStats_t stats[VKK_MEMORY_TYPE_COUNT + 1];
+
+	// VK_EXT_memory_budget (optional)
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2;
+
+	// VK_KHR_get_memory_requirements2 (optional)
+	PFN_vkGetBufferMemoryRequirements2KHR getBufferMemoryRequirements2;
+	PFN_vkGetImageMemoryRequirements2KHR  getImageMemoryRequirements2;
+
+	// memory info, retained chunks and the shutdown flag
+	// are protected by the info mutex which is acquired
+	// after the pool lock (the lock order is manager, pool,
+	// info then dirty/budget) so pools are only try-locked
+	// when trimming retained chunks
 	vkk_memoryInfo_t info[VKK_MEMORY_TYPE_COUNT];
+	pthread_mutex_t  info_mutex;
 
+	// the manager lock protects the pool list, dedicated
+	// chunks, magazine list and purge flag
 	pthread_mutex_t manager_mutex;
 	pthread_mutex_t chunk_mutex[VKK_CHUNK_UPDATERS];
 	pthread_cond_t  chunk_cond[VKK_CHUNK_UPDATERS];
-	pthread_cond_t  pool_cond;
 } vkk_memoryManager_t;
 
 vkk_memoryManager_t* vkk_memoryManager_new(vkk_engine_t* engine);
 void                 vkk_memoryManager_delete(vkk_memoryManager_t** _self);
 void                 vkk_memoryManager_shutdown(vkk_memoryManager_t* self);
+void                 vkk_memoryManager_trim(vkk_memoryManager_t* self);
+void                 vkk_memoryManager_budget(vkk_memoryManager_t* self,
+                                              vkk_memoryType_e type,
+                                              vkk_memoryBudget_t* budget);
+void                 vkk_memoryManager_softCap(vkk_memoryManager_t* self,
+                                               vkk_memoryType_e type,
+                                               size_t soft_cap);
+void                 vkk_memoryManager_evictFn(vkk_memoryManager_t* self,
+                                               void* priv,
+                                               vkk_engine_evictFn evict_fn);
+int                  vkk_memoryManager_reserve(vkk_memoryManager_t* self,
+                                               uint32_t mt_index,
+                                               vkk_memoryType_e type,
+                                               size_t size);
+void                 vkk_memoryManager_release(vkk_memoryManager_t* self,
+                                               uint32_t mt_index,
+                                               vkk_memoryType_e type,
+                                               size_t size);
+void                 vkk_memoryManager_recordAllocate(vkk_memoryManager_t* self,
+                                                      vkk_memoryType_e type,
+                                                      double dt);
+void                 vkk_memoryManager_stats(vkk_memoryManager_t* self,
+                                             vkk_memoryType_e type,
+                                             vkk_memoryStats_t* stats);
+int                  vkk_memoryManager_statsDump(vkk_memoryManager_t* self,
+                                                 const char* fname);
 vkk_memory_t*        vkk_memoryManager_allocBuffer(vkk_memoryManager_t* self,
                                                    VkBuffer buffer,
-                                                   int device_memory,
+                                                   vkk_memoryClass_e mclass,
+                                                   vkk_memoryPriority_e priority,
+                                                   size_t size,
+                                                   const void* buf,
+                                                   int evict);
+vkk_memory_t*        vkk_memoryManager_allocShared(vkk_memoryManager_t* self,
+                                                   vkk_memoryClass_e mclass,
+                                                   vkk_memoryPriority_e priority,
+                                                   VkBufferUsageFlags usage,
                                                    size_t size,
                                                    const void* buf);
 vkk_memory_t*        vkk_memoryManager_allocImage(vkk_memoryManager_t* self,
                                                   VkImage image,
                                                   int device_memory,
-                                                  int transient_memory);
+                                                  int transient_memory,
+                                                  vkk_memoryPriority_e priority);
 void                 vkk_memoryManager_free(vkk_memoryManager_t* self,
                                             vkk_memory_t** _memory);
 void                 vkk_memoryManager_clear(vkk_memoryManager_t* self,
@@ -71,11 +318,21 @@ void                 vkk_memoryManager_read(vkk_memoryManager_t* self,
                                             size_t offset,
                                             size_t size,
                                             void* buf);
+const void*          vkk_memoryManager_map(vkk_memoryManager_t* self,
+                                           vkk_memory_t* memory);
 void                 vkk_memoryManager_write(vkk_memoryManager_t* self,
                                              vkk_memory_t* memory,
                                              size_t offset,
                                              size_t size,
                                              const void* buf);
+void                 vkk_memoryManager_writeF16(vkk_memoryManager_t* self,
+                                                vkk_memory_t* memory,
+                                                size_t offset,
+                                                size_t size,
+                                                const float* buf);
+void                 vkk_memoryManager_flush(vkk_memoryManager_t* self);
+void                 vkk_memoryManager_invalidate(vkk_memoryManager_t* self,
+                                                  vkk_memory_t* memory);
 void                 vkk_memoryManager_blit(vkk_memoryManager_t* self,
                                             vkk_memory_t* src_memory,
                                             vkk_memory_t* dst_memory,
@@ -31,6 +31,59 @@
 #include "vkk_memoryManager.h"
 #include "vkk_memoryPool.h"
 
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static int vkk_memoryPool_sparse(vkk_memoryChunk_t* chunk)
+{
+	ASSERT(chunk);
+
+	return (100*chunk->size_used <
+	        VKK_MEMORY_DEFRAG_USAGE*chunk->size) ? 1 : 0;
+}
+
+static void
+vkk_memoryPool_evacuate(vkk_memoryPool_t* self,
+                        vkk_memoryChunk_t* chunk)
+{
+	ASSERT(self);
+	ASSERT(chunk);
+
+	if(chunk->evacuate || (vkk_memoryPool_sparse(chunk) == 0))
+	{
+		return;
+	}
+
+	// compute the free space in the dense chunks which may
+	// absorb the allocations from the sparse chunk
+	VkDeviceSize   size_free = 0;
+	cc_listIter_t* iter      = cc_list_head(self->chunks);
+	while(iter)
+	{
+		vkk_memoryChunk_t* tmp;
+		tmp = (vkk_memoryChunk_t*) cc_list_peekIter(iter);
+
+		if(tmp->usecount && (tmp->evacuate == 0) &&
+		   (vkk_memoryPool_sparse(tmp) == 0))
+		{
+			size_free += tmp->size - tmp->size_used;
+			if(size_free >= chunk->size_used)
+			{
+				// note that the live bytes are not copied
+				// since Vulkan buffers and images cannot be
+				// rebound so the alloc placement avoids the
+				// evacuated chunk until the app deletes its
+				// objects
+				chunk->evacuate = 1;
+				return;
+			}
+		}
+
+		iter = cc_list_next(iter);
+	}
+}
+
 /***********************************************************
 * public                                                   *
 ***********************************************************/
@@ -38,11 +91,11 @@
 vkk_memoryPool_t*
 vkk_memoryPool_new(vkk_memoryManager_t* mm,
                    uint32_t count,
-                   VkDeviceSize stride,
-                   uint32_t mt_index,
+                   const vkk_memoryPoolKey_t* key,
                    vkk_memoryType_e type)
 {
 	ASSERT(mm);
+	ASSERT(key);
 	ASSERT(type != VKK_MEMORY_TYPE_ANY);
 
 	vkk_memoryPool_t* self;
@@ -56,9 +109,12 @@ vkk_memoryPool_new(vkk_memoryManager_t* mm,
 
 	self->mm       = mm;
 	self->count    = count;
-	self->stride   = stride;
-	self->mt_index = mt_index;
+	self->stride   = (VkDeviceSize) key->stride;
+	self->mt_index = key->mt_index;
 	self->type     = type;
+	self->usage    = (VkBufferUsageFlags) key->usage;
+	self->optimal  = (int) key->optimal;
+	self->priority = (vkk_memoryPriority_e) key->priority;
 
 	self->chunks = cc_list_new();
 	if(self->chunks == NULL)
@@ -66,10 +122,18 @@ vkk_memoryPool_new(vkk_memoryManager_t* mm,
 		goto fail_chunks;
 	}
 
+	if(pthread_mutex_init(&self->pool_mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_pool_mutex;
+	}
+
 	// success
 	return self;
 
 	// failure
+	fail_pool_mutex:
+		cc_list_delete(&self->chunks);
 	fail_chunks:
 		FREE(self);
 	return NULL;
@@ -84,20 +148,43 @@ void vkk_memoryPool_delete(vkk_memoryPool_t** _self)
 	{
 		ASSERT(cc_list_size(self->chunks) == 0);
 
+		pthread_mutex_destroy(&self->pool_mutex);
 		cc_list_delete(&self->chunks);
 		FREE(self);
 		*_self = NULL;
 	}
 }
 
+void vkk_memoryPool_key(vkk_memoryPool_t* self,
+                        vkk_memoryPoolKey_t* key)
+{
+	ASSERT(self);
+	ASSERT(key);
+
+	key->mt_index = self->mt_index;
+	key->stride   = (uint32_t) self->stride;
+	key->usage    = (uint32_t) self->usage;
+	key->optimal  = (uint32_t) self->optimal;
+	key->priority = (uint32_t) self->priority;
+}
+
 vkk_memory_t*
 vkk_memoryPool_alloc(vkk_memoryPool_t* self,
-                     vkk_memoryInfo_t* info)
+                     VkMemoryRequirements* mr,
+                     vkk_memoryInfo_t* info,
+                     int* _over_budget)
 {
 	ASSERT(self);
+	ASSERT(mr);
 	ASSERT(info);
+	ASSERT(_over_budget);
 
-	// try to allocate from an existing slot
+	// try to allocate from an existing chunk
+	// empty chunks are only selected when no other chunk
+	// has space so that retained chunks may be trimmed
+	// and evacuated chunks are only selected when creating
+	// a new chunk is the only alternative
+	vkk_memory_t*      memory;
 	vkk_memoryChunk_t* chunk;
 	cc_listIter_t*     iter = cc_list_head(self->chunks);
 	while(iter)
@@ -105,16 +192,71 @@ vkk_memoryPool_alloc(vkk_memoryPool_t* self,
 		chunk = (vkk_memoryChunk_t*)
 		        cc_list_peekIter(iter);
 
-		if(vkk_memoryChunk_slots(chunk))
+		if(chunk->usecount && (chunk->evacuate == 0))
 		{
-			return vkk_memoryChunk_alloc(chunk, info);
+			memory = vkk_memoryChunk_alloc(chunk, mr, info);
+			if(memory)
+			{
+				return memory;
+			}
 		}
 
 		iter = cc_list_next(iter);
 	}
 
+	// try to allocate from an empty chunk
+	iter = cc_list_head(self->chunks);
+	while(iter)
+	{
+		chunk = (vkk_memoryChunk_t*)
+		        cc_list_peekIter(iter);
+
+		if(chunk->usecount == 0)
+		{
+			memory = vkk_memoryChunk_alloc(chunk, mr, info);
+			if(memory)
+			{
+				return memory;
+			}
+		}
+
+		iter = cc_list_next(iter);
+	}
+
+	// try to allocate from an evacuated chunk
+	iter = cc_list_head(self->chunks);
+	while(iter)
+	{
+		chunk = (vkk_memoryChunk_t*)
+		        cc_list_peekIter(iter);
+
+		if(chunk->usecount && chunk->evacuate)
+		{
+			memory = vkk_memoryChunk_alloc(chunk, mr, info);
+			if(memory)
+			{
+				return memory;
+			}
+		}
+
+		iter = cc_list_next(iter);
+	}
+
+	// variable size chunks are enlarged for requests which
+	// exceed the default chunk size
+	VkDeviceSize size = self->stride*self->count;
+	if(self->stride == 0)
+	{
+		size = VKK_MEMORY_TLSF_CHUNK_SIZE;
+		if(mr->size > size)
+		{
+			size = (mr->size + VKK_MEMORY_TLSF_ALIGN - 1) &
+			       ~((VkDeviceSize) VKK_MEMORY_TLSF_ALIGN - 1);
+		}
+	}
+
 	// create a new chunk
-	chunk = vkk_memoryChunk_new(self, info);
+	chunk = vkk_memoryChunk_new(self, size, info, _over_budget);
 	if(chunk == NULL)
 	{
 		return NULL;
@@ -129,8 +271,7 @@ vkk_memoryPool_alloc(vkk_memoryPool_t* self,
 	}
 
 	// info invalid if alloc fails
-	vkk_memory_t* memory;
-	memory = vkk_memoryChunk_alloc(chunk, info);
+	memory = vkk_memoryChunk_alloc(chunk, mr, info);
 	if(memory == NULL)
 	{
 		goto fail_memory;
@@ -147,8 +288,42 @@ vkk_memoryPool_alloc(vkk_memoryPool_t* self,
 	return NULL;
 }
 
+vkk_memory_t*
+vkk_memoryPool_refill(vkk_memoryPool_t* self,
+                      VkMemoryRequirements* mr,
+                      vkk_memoryInfo_t* info)
+{
+	ASSERT(self);
+	ASSERT(mr);
+	ASSERT(info);
+
+	// speculative magazine slots are only reserved from the
+	// chunks which are in use and not evacuated so that a
+	// refill never creates a chunk (which may exceed the
+	// budget) or pins an empty or evacuated chunk
+	cc_listIter_t* iter = cc_list_head(self->chunks);
+	while(iter)
+	{
+		vkk_memoryChunk_t* chunk;
+		chunk = (vkk_memoryChunk_t*) cc_list_peekIter(iter);
+
+		if(chunk->usecount && (chunk->evacuate == 0))
+		{
+			vkk_memory_t* memory;
+			memory = vkk_memoryChunk_alloc(chunk, mr, info);
+			if(memory)
+			{
+				return memory;
+			}
+		}
+
+		iter = cc_list_next(iter);
+	}
+
+	return NULL;
+}
+
 int vkk_memoryPool_free(vkk_memoryPool_t* self,
-                        int shutdown,
                         vkk_memory_t** _memory,
                         vkk_memoryChunk_t** _chunk,
                         vkk_memoryInfo_t* info)
@@ -158,29 +333,43 @@ int vkk_memoryPool_free(vkk_memoryPool_t* self,
 	ASSERT(_chunk);
 	ASSERT(info);
 
+	// empty chunks are not removed from the pool since
+	// the manager decides if the chunk should be retained
 	vkk_memory_t* memory = *_memory;
 	if(memory)
 	{
-		// free memory and delete chunk (if needed)
 		vkk_memoryChunk_t* chunk = memory->chunk;
-		if(vkk_memoryChunk_free(chunk, shutdown, _memory, info))
+		if(vkk_memoryChunk_free(chunk, _memory, info))
 		{
-			cc_listIter_t* iter = cc_list_head(self->chunks);
-			while(iter)
-			{
-				vkk_memoryChunk_t* tmp;
-				tmp = (vkk_memoryChunk_t*)
-				      cc_list_peekIter(iter);
-				if(tmp == chunk)
-				{
-					cc_list_remove(self->chunks, &iter);
-					break;
-				}
-
-				iter = cc_list_next(iter);
-			}
 			*_chunk = chunk;
+			return 1;
 		}
+
+		// evacuate the chunk once it becomes sparse
+		vkk_memoryPool_evacuate(self, chunk);
+	}
+
+	return 0;
+}
+
+int vkk_memoryPool_removeChunk(vkk_memoryPool_t* self,
+                               vkk_memoryChunk_t* chunk)
+{
+	ASSERT(self);
+	ASSERT(chunk);
+
+	cc_listIter_t* iter = cc_list_head(self->chunks);
+	while(iter)
+	{
+		vkk_memoryChunk_t* tmp;
+		tmp = (vkk_memoryChunk_t*) cc_list_peekIter(iter);
+		if(tmp == chunk)
+		{
+			cc_list_remove(self->chunks, &iter);
+			break;
+		}
+
+		iter = cc_list_next(iter);
 	}
 
 	return (cc_list_size(self->chunks) == 0) ? 1 : 0;
@@ -210,13 +399,24 @@ void vkk_memoryPool_memoryInfo(vkk_memoryPool_t* self,
 	};
 
 	uint32_t chunk_count = cc_list_size(self->chunks);
-	size_t   chunk_size  = self->count*self->stride*chunk_count;
-	LOGI("POOL: type=%s, count=%u, stride=%u, chunk_count=%i, chunk_size=%" PRIu64,
+	size_t   chunk_size  = 0;
+
+	cc_listIter_t* iter = cc_list_head(self->chunks);
+	while(iter)
+	{
+		vkk_memoryChunk_t* chunk;
+		chunk = (vkk_memoryChunk_t*) cc_list_peekIter(iter);
+		chunk_size += (size_t) chunk->size;
+		iter = cc_list_next(iter);
+	}
+
+	LOGI("POOL: type=%s, count=%u, stride=%u, usage=0x%X, optimal=%i, priority=%i, chunk_count=%i, chunk_size=%" PRIu64,
 	     type_name[self->type], (uint32_t) self->count,
-	     (uint32_t) self->stride, chunk_count,
+	     (uint32_t) self->stride, (uint32_t) self->usage,
+	     self->optimal, (int) self->priority, chunk_count,
 	     (uint64_t) chunk_size);
 
-	cc_listIter_t* iter = cc_list_head(self->chunks);
+	iter = cc_list_head(self->chunks);
 	while(iter)
 	{
 		vkk_memoryChunk_t* chunk;
@@ -24,36 +24,74 @@
 #ifndef vkk_memoryPool_H
 #define vkk_memoryPool_H
 
+#include <pthread.h>
+
 #include "vkk_memory.h"
 
+// stride is zero for variable size pools, usage is zero
+// except for shared buffer pools, optimal is set for
+// pools which are reserved for optimal tiling images when
+// the slots/blocks may share a bufferImageGranularity page
+// with linear resources and priority selects the memory
+// priority of the pool chunks
+typedef struct
+{
+	uint32_t mt_index;
+	uint32_t stride;
+	uint32_t usage;
+	uint32_t optimal;
+	uint32_t priority;
+} vkk_memoryPoolKey_t;
+
 typedef struct vkk_memoryPool_s
 {
 	vkk_memoryManager_t* mm;
 
-	int          locked;
 	uint32_t     count;
 	VkDeviceSize stride;
 	uint32_t     mt_index;
 
+	// count and stride are zero for variable size pools
+
+	// usage is non-zero for shared buffer pools whose
+	// chunks own a VkBuffer which spans the chunk memory
+	VkBufferUsageFlags usage;
+
+	// optimal tiling images only
+	int optimal;
+
+	vkk_memoryPriority_e priority;
+
 	vkk_memoryType_e type;
 
 	// memory chunks
 	cc_list_t* chunks;
+
+	// protects the chunks of the pool (the lock order is
+	// manager then pool)
+	pthread_mutex_t pool_mutex;
 } vkk_memoryPool_t;
 
 vkk_memoryPool_t* vkk_memoryPool_new(vkk_memoryManager_t* mm,
                                      uint32_t count,
-                                     VkDeviceSize stride,
-                                     uint32_t mt_index,
+                                     const vkk_memoryPoolKey_t* key,
                                      vkk_memoryType_e type);
 void              vkk_memoryPool_delete(vkk_memoryPool_t** _self);
+void              vkk_memoryPool_key(vkk_memoryPool_t* self,
+                                     vkk_memoryPoolKey_t* key);
 vkk_memory_t*     vkk_memoryPool_alloc(vkk_memoryPool_t* self,
-                                       vkk_memoryInfo_t* info);
+                                       VkMemoryRequirements* mr,
+                                       vkk_memoryInfo_t* info,
+                                       int* _over_budget);
+vkk_memory_t*     vkk_memoryPool_refill(vkk_memoryPool_t* self,
+                                        VkMemoryRequirements* mr,
+                                        vkk_memoryInfo_t* info);
 int               vkk_memoryPool_free(vkk_memoryPool_t* self,
-                                      int shutdown,
                                       vkk_memory_t** _memory,
                                       vkk_memoryChunk_t** _chunk,
                                       vkk_memoryInfo_t* info);
+int               vkk_memoryPool_removeChunk(vkk_memoryPool_t* self,
+                                             vkk_memoryChunk_t* chunk);
 void              vkk_memoryPool_memoryInfo(vkk_memoryPool_t* self,
                                             vkk_memoryType_e type);
 
@@ -0,0 +1,750 @@
+/*
+ * Copyright (c) 2020 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#define LOG_TAG "vkk"
+#include "../../libcc/cc_log.h"
+#include "../../libcc/cc_memory.h"
+#include "vkk_engine.h"
+#include "vkk_image.h"
+#include "vkk_mipmapPipeline.h"
+#include "vkk_util.h"
+
+// see mipmap.comp
+typedef struct
+{
+	int32_t src_size[2];
+	int32_t group_offset[2];
+	int32_t levels;
+} vkk_mipmapParam_t;
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static const char*
+vkk_mipmapPipeline_shader(vkk_imageFormat_e format)
+{
+	// the formats without a storage image format qualifier
+	// (or which require the extended storage formats) are
+	// mipmapped by the blit chain
+	const char* shader_map[VKK_IMAGE_FORMAT_COUNT] =
+	{
+		"vkk/core/shaders/mipmap_rgba8_comp.spv",
+		NULL,
+		"vkk/core/shaders/mipmap_rgba32f_comp.spv",
+		"vkk/core/shaders/mipmap_rgba16f_comp.spv",
+		NULL,
+		NULL,
+		NULL,
+		NULL,
+		NULL,
+		NULL,
+		NULL,
+		NULL,
+		"vkk/core/shaders/mipmap_r32f_comp.spv",
+		NULL,
+	};
+
+	return shader_map[format];
+}
+
+static uint32_t
+vkk_mipmapPipeline_size(uint32_t size, uint32_t level)
+{
+	// mip level size (enforce the minimum size)
+	size = size >> level;
+	return (size == 0) ? 1 : size;
+}
+
+static void
+vkk_mipmapPipeline_newPipeline(vkk_mipmapPipeline_t* self,
+                               vkk_imageFormat_e format)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	const char* fname = vkk_mipmapPipeline_shader(format);
+	if(fname == NULL)
+	{
+		return;
+	}
+
+	VkFormatProperties fp;
+	vkGetPhysicalDeviceFormatProperties(engine->physical_device,
+	                                    vkk_util_imageFormat(format),
+	                                    &fp);
+	if((fp.optimalTilingFeatures &
+	    VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) == 0)
+	{
+		return;
+	}
+
+	// the shader is optional since the app may not include
+	// the core resources in the resource file
+	VkShaderModule cs;
+	cs = vkk_engine_getShaderModule(engine, fname);
+	if(cs == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	VkComputePipelineCreateInfo cp_info =
+	{
+		.sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext              = NULL,
+		.flags              = 0,
+		.stage              =
+		{
+			.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.pNext               = NULL,
+			.flags               = 0,
+			.stage               = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module              = cs,
+			.pName               = "main",
+			.pSpecializationInfo = NULL,
+		},
+		.layout             = self->pl,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex  = -1,
+	};
+
+	if(vkCreateComputePipelines(engine->device,
+	                            engine->pipeline_cache,
+	                            1, &cp_info, NULL,
+	                            &self->pipeline[format]) != VK_SUCCESS)
+	{
+		LOGW("vkCreateComputePipelines failed");
+		self->pipeline[format] = VK_NULL_HANDLE;
+	}
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+vkk_mipmapPipeline_t*
+vkk_mipmapPipeline_new(vkk_engine_t* engine)
+{
+	ASSERT(engine);
+
+	vkk_mipmapPipeline_t* self;
+	self = (vkk_mipmapPipeline_t*)
+	       CALLOC(1, sizeof(vkk_mipmapPipeline_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	// compute mipmaps are disabled by default until the
+	// GPU timings (see xmem-test) justify the storage usage,
+	// views and descriptor pool required per image
+	self->engine = engine;
+	self->enable = 0;
+
+	if(pthread_mutex_init(&self->timer_mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_timer_mutex;
+	}
+
+	// timestamps are optional
+	VkPhysicalDeviceProperties pdp;
+	vkGetPhysicalDeviceProperties(engine->physical_device,
+	                              &pdp);
+	if(pdp.limits.timestampComputeAndGraphics)
+	{
+		VkQueryPoolCreateInfo qp_info =
+		{
+			.sType              = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.pNext              = NULL,
+			.flags              = 0,
+			.queryType          = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount         = 2*VKK_MIPMAP_PIPELINE_TIMERS,
+			.pipelineStatistics = 0,
+		};
+
+		if(vkCreateQueryPool(engine->device, &qp_info, NULL,
+		                     &self->timer_pool) != VK_SUCCESS)
+		{
+			LOGW("vkCreateQueryPool failed");
+			self->timer_pool = VK_NULL_HANDLE;
+		}
+		self->timer_period = pdp.limits.timestampPeriod;
+	}
+
+	// the src level and the dst levels
+	VkDescriptorSetLayoutBinding bindings[VKK_MIPMAP_PIPELINE_LEVELS + 1];
+
+	int i;
+	for(i = 0; i <= VKK_MIPMAP_PIPELINE_LEVELS; ++i)
+	{
+		VkDescriptorSetLayoutBinding* b = &(bindings[i]);
+		b->binding            = i;
+		b->descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		b->descriptorCount    = 1;
+		b->stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+		b->pImmutableSamplers = NULL;
+	}
+
+	VkDescriptorSetLayoutCreateInfo dsl_info =
+	{
+		.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext        = NULL,
+		.flags        = 0,
+		.bindingCount = VKK_MIPMAP_PIPELINE_LEVELS + 1,
+		.pBindings    = bindings,
+	};
+
+	if(vkCreateDescriptorSetLayout(engine->device,
+	                               &dsl_info, NULL,
+	                               &self->dsl) != VK_SUCCESS)
+	{
+		LOGE("vkCreateDescriptorSetLayout failed");
+		goto fail_create_dsl;
+	}
+
+	VkPushConstantRange pcr =
+	{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset     = 0,
+		.size       = sizeof(vkk_mipmapParam_t),
+	};
+
+	VkPipelineLayoutCreateInfo pl_info =
+	{
+		.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext                  = NULL,
+		.flags                  = 0,
+		.setLayoutCount         = 1,
+		.pSetLayouts            = &self->dsl,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges    = &pcr
+	};
+
+	if(vkCreatePipelineLayout(engine->device, &pl_info, NULL,
+	                          &self->pl) != VK_SUCCESS)
+	{
+		LOGE("vkCreatePipelineLayout failed");
+		goto fail_create_pl;
+	}
+
+	// formats without a pipeline use the blit chain
+	for(i = 0; i < VKK_IMAGE_FORMAT_COUNT; ++i)
+	{
+		vkk_mipmapPipeline_newPipeline(self,
+		                               (vkk_imageFormat_e) i);
+	}
+
+	// success
+	return self;
+
+	// failure
+	fail_create_pl:
+		vkDestroyDescriptorSetLayout(engine->device,
+		                             self->dsl, NULL);
+	fail_create_dsl:
+		vkDestroyQueryPool(engine->device, self->timer_pool,
+		                   NULL);
+		pthread_mutex_destroy(&self->timer_mutex);
+	fail_timer_mutex:
+		FREE(self);
+	return NULL;
+}
+
+void vkk_mipmapPipeline_delete(vkk_mipmapPipeline_t** _self)
+{
+	ASSERT(_self);
+
+	vkk_mipmapPipeline_t* self = *_self;
+	if(self)
+	{
+		vkk_engine_t* engine = self->engine;
+
+		int i;
+		for(i = 0; i < VKK_IMAGE_FORMAT_COUNT; ++i)
+		{
+			vkDestroyPipeline(engine->device,
+			                  self->pipeline[i], NULL);
+		}
+
+		vkDestroyPipelineLayout(engine->device,
+		                        self->pl, NULL);
+		vkDestroyDescriptorSetLayout(engine->device,
+		                             self->dsl, NULL);
+		vkDestroyQueryPool(engine->device, self->timer_pool,
+		                   NULL);
+		pthread_mutex_destroy(&self->timer_mutex);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+int vkk_mipmapPipeline_supported(vkk_mipmapPipeline_t* self,
+                                 vkk_imageFormat_e format)
+{
+	ASSERT(self);
+
+	return self->enable &&
+	       (self->pipeline[format] != VK_NULL_HANDLE);
+}
+
+void vkk_mipmapPipeline_timer(vkk_mipmapPipeline_t* self,
+                              int enable)
+{
+	ASSERT(self);
+
+	pthread_mutex_lock(&self->timer_mutex);
+	self->timer_enable = enable &&
+	                     (self->timer_pool != VK_NULL_HANDLE);
+	self->timer_count  = 0;
+	pthread_mutex_unlock(&self->timer_mutex);
+
+	if(enable && (self->timer_pool == VK_NULL_HANDLE))
+	{
+		LOGW("timestamps unsupported");
+	}
+}
+
+double vkk_mipmapPipeline_elapsed(vkk_mipmapPipeline_t* self,
+                                  uint32_t* _count)
+{
+	ASSERT(self);
+	ASSERT(_count);
+
+	vkk_engine_t* engine = self->engine;
+
+	// each query result is followed by its availability so
+	// the mip chains which are still pending are skipped
+	uint64_t data[4*VKK_MIPMAP_PIPELINE_TIMERS];
+
+	double   elapsed = 0.0;
+	uint32_t count   = 0;
+
+	pthread_mutex_lock(&self->timer_mutex);
+	if(self->timer_count)
+	{
+		VkResult result;
+		result = vkGetQueryPoolResults(engine->device,
+		                               self->timer_pool, 0,
+		                               self->timer_count,
+		                               sizeof(data), data,
+		                               2*sizeof(uint64_t),
+		                               VK_QUERY_RESULT_64_BIT |
+		                               VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if((result == VK_SUCCESS) || (result == VK_NOT_READY))
+		{
+			uint32_t i;
+			for(i = 0; i < self->timer_count; i += 2)
+			{
+				uint64_t* q = &data[2*i];
+				if(q[1] && q[3] && (q[2] >= q[0]))
+				{
+					elapsed += ((double) (q[2] - q[0]))*
+					           ((double) self->timer_period);
+					++count;
+				}
+			}
+		}
+		self->timer_count = 0;
+	}
+	pthread_mutex_unlock(&self->timer_mutex);
+
+	// convert ns to seconds
+	*_count = count;
+	return elapsed/1000000000.0;
+}
+
+int vkk_mipmapPipeline_timerBegin(vkk_mipmapPipeline_t* self,
+                                  VkCommandBuffer cb)
+{
+	ASSERT(self);
+
+	pthread_mutex_lock(&self->timer_mutex);
+	if((self->timer_enable == 0) ||
+	   (self->timer_count + 2 > 2*VKK_MIPMAP_PIPELINE_TIMERS))
+	{
+		pthread_mutex_unlock(&self->timer_mutex);
+		return -1;
+	}
+	int query = (int) self->timer_count;
+	self->timer_count += 2;
+	pthread_mutex_unlock(&self->timer_mutex);
+
+	// the begin timestamp is written once the previous
+	// commands (e.g. the copy of the base level) complete
+	vkCmdResetQueryPool(cb, self->timer_pool,
+	                    (uint32_t) query, 2);
+	vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+	                    self->timer_pool, (uint32_t) query);
+	return query;
+}
+
+void vkk_mipmapPipeline_timerEnd(vkk_mipmapPipeline_t* self,
+                                 VkCommandBuffer cb,
+                                 int query)
+{
+	ASSERT(self);
+
+	if(query < 0)
+	{
+		return;
+	}
+
+	vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+	                    self->timer_pool, (uint32_t) query + 1);
+}
+
+int vkk_mipmapPipeline_newImage(vkk_mipmapPipeline_t* self,
+                                vkk_image_t* image)
+{
+	ASSERT(self);
+	ASSERT(image);
+	ASSERT(image->mip_levels > 1);
+	ASSERT(image->depth == 1);
+
+	vkk_engine_t* engine = self->engine;
+
+	uint32_t count = image->mip_levels;
+
+	// storage images are bound by mip level
+	image->mip_views = (VkImageView*)
+	                   CALLOC(count, sizeof(VkImageView));
+	if(image->mip_views == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	uint32_t i;
+	for(i = 0; i < count; ++i)
+	{
+		VkImageViewCreateInfo iv_info =
+		{
+			.sType      = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.pNext      = NULL,
+			.flags      = 0,
+			.image      = image->image,
+			.viewType   = VK_IMAGE_VIEW_TYPE_2D,
+			.format     = vkk_util_imageFormat(image->format),
+			.components =
+			{
+				.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.a = VK_COMPONENT_SWIZZLE_IDENTITY
+			},
+			.subresourceRange =
+			{
+				.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel   = i,
+				.levelCount     = 1,
+				.baseArrayLayer = 0,
+				.layerCount     = 1
+			}
+		};
+
+		if(vkCreateImageView(engine->device, &iv_info, NULL,
+		                     &image->mip_views[i]) != VK_SUCCESS)
+		{
+			LOGE("vkCreateImageView failed");
+			goto fail_image_view;
+		}
+	}
+
+	// a descriptor set for each src level allows a pass to
+	// start at any level (e.g. for vkk_image_writeRegion)
+	uint32_t set_count = count - 1;
+
+	VkDescriptorPoolSize ps =
+	{
+		.type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = set_count*
+		                   (VKK_MIPMAP_PIPELINE_LEVELS + 1),
+	};
+
+	VkDescriptorPoolCreateInfo dp_info =
+	{
+		.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext         = NULL,
+		.flags         = 0,
+		.maxSets       = set_count,
+		.poolSizeCount = 1,
+		.pPoolSizes    = &ps
+	};
+
+	if(vkCreateDescriptorPool(engine->device, &dp_info, NULL,
+	                          &image->mip_pool) != VK_SUCCESS)
+	{
+		LOGE("vkCreateDescriptorPool failed");
+		goto fail_pool;
+	}
+
+	image->mip_sets = (VkDescriptorSet*)
+	                  CALLOC(set_count, sizeof(VkDescriptorSet));
+	if(image->mip_sets == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_sets;
+	}
+
+	for(i = 0; i < set_count; ++i)
+	{
+		VkDescriptorSetAllocateInfo ds_info =
+		{
+			.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.pNext              = NULL,
+			.descriptorPool     = image->mip_pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts        = &self->dsl
+		};
+
+		if(vkAllocateDescriptorSets(engine->device, &ds_info,
+		                            &image->mip_sets[i]) != VK_SUCCESS)
+		{
+			LOGE("vkAllocateDescriptorSets failed");
+			goto fail_allocate;
+		}
+
+		// the dst levels past the last mip level repeat the
+		// last mip level but are not written by the pass
+		VkDescriptorImageInfo di_info[VKK_MIPMAP_PIPELINE_LEVELS + 1];
+		VkWriteDescriptorSet  writes[VKK_MIPMAP_PIPELINE_LEVELS + 1];
+
+		uint32_t j;
+		for(j = 0; j <= VKK_MIPMAP_PIPELINE_LEVELS; ++j)
+		{
+			uint32_t level = i + j;
+			if(level >= count)
+			{
+				level = count - 1;
+			}
+
+			di_info[j].sampler     = VK_NULL_HANDLE;
+			di_info[j].imageView   = image->mip_views[level];
+			di_info[j].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			writes[j].sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[j].pNext            = NULL;
+			writes[j].dstSet           = image->mip_sets[i];
+			writes[j].dstBinding       = j;
+			writes[j].dstArrayElement  = 0;
+			writes[j].descriptorCount  = 1;
+			writes[j].descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[j].pImageInfo       = &di_info[j];
+			writes[j].pBufferInfo      = NULL;
+			writes[j].pTexelBufferView = NULL;
+		}
+
+		vkUpdateDescriptorSets(engine->device,
+		                       VKK_MIPMAP_PIPELINE_LEVELS + 1,
+		                       writes, 0, NULL);
+	}
+
+	// success
+	return 1;
+
+	// failure
+	fail_allocate:
+	fail_sets:
+	fail_pool:
+	fail_image_view:
+		vkk_mipmapPipeline_deleteImage(self, image);
+	return 0;
+}
+
+void vkk_mipmapPipeline_deleteImage(vkk_mipmapPipeline_t* self,
+                                    vkk_image_t* image)
+{
+	ASSERT(self);
+	ASSERT(image);
+
+	vkk_engine_t* engine = self->engine;
+
+	// the descriptor sets are freed with the pool
+	vkDestroyDescriptorPool(engine->device, image->mip_pool,
+	                        NULL);
+	FREE(image->mip_sets);
+	image->mip_pool = VK_NULL_HANDLE;
+	image->mip_sets = NULL;
+
+	if(image->mip_views)
+	{
+		uint32_t i;
+		for(i = 0; i < image->mip_levels; ++i)
+		{
+			vkDestroyImageView(engine->device,
+			                   image->mip_views[i], NULL);
+		}
+		FREE(image->mip_views);
+		image->mip_views = NULL;
+	}
+}
+
+void vkk_mipmapPipeline_record(vkk_mipmapPipeline_t* self,
+                               vkk_image_t* image,
+                               VkCommandBuffer cb,
+                               uint32_t level,
+                               uint32_t x, uint32_t y,
+                               uint32_t w, uint32_t h)
+{
+	ASSERT(self);
+	ASSERT(image);
+	ASSERT(image->mip_sets);
+	ASSERT(cb != VK_NULL_HANDLE);
+
+	// check if there are sub mip levels to generate
+	if(level + 1 >= image->mip_levels)
+	{
+		return;
+	}
+
+	// the mip levels are accessed as storage images
+	vkk_util_imageMemoryBarrier(image, cb,
+	                            VK_IMAGE_LAYOUT_GENERAL,
+	                            level, 1);
+	vkk_util_imageMemoryBarrier(image, cb,
+	                            VK_IMAGE_LAYOUT_GENERAL,
+	                            level + 1,
+	                            image->mip_levels - level - 1);
+
+	vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE,
+	                  self->pipeline[image->format]);
+
+	// the region [x0,x1)x[y0,y1) is the affected region of
+	// the src level (see vkk_engine_mipmapRegion)
+	uint32_t x0  = x;
+	uint32_t y0  = y;
+	uint32_t x1  = x + w;
+	uint32_t y1  = y + h;
+	uint32_t src = level;
+	while(src + 1 < image->mip_levels)
+	{
+		uint32_t levels = image->mip_levels - src - 1;
+		if(levels > VKK_MIPMAP_PIPELINE_LEVELS)
+		{
+			levels = VKK_MIPMAP_PIPELINE_LEVELS;
+		}
+
+		// the dst levels which are reduced in shared memory
+		// require even sized src levels since the last
+		// column/row of the dst level folds in the extra
+		// texel of an odd sized src level which may belong
+		// to the tile of another workgroup (see mipmap.comp)
+		uint32_t n = 1;
+		while(n < levels)
+		{
+			uint32_t sw = vkk_mipmapPipeline_size(image->width,
+			                                      src + n);
+			uint32_t sh = vkk_mipmapPipeline_size(image->height,
+			                                      src + n);
+			if(((sw > 1) && (sw & 1)) || ((sh > 1) && (sh & 1)))
+			{
+				break;
+			}
+			++n;
+		}
+		levels = n;
+
+		// each workgroup covers an 8x8 tile of the first dst
+		// level which contains the affected region
+		uint32_t dw  = vkk_mipmapPipeline_size(image->width,
+		                                       src + 1);
+		uint32_t dh  = vkk_mipmapPipeline_size(image->height,
+		                                       src + 1);
+		uint32_t dx0 = x0/2;
+		uint32_t dy0 = y0/2;
+		uint32_t dx1 = (x1 + 1)/2;
+		uint32_t dy1 = (y1 + 1)/2;
+		dx1 = (dx1 > dw) ? dw : dx1;
+		dy1 = (dy1 > dh) ? dh : dy1;
+
+		uint32_t gx0 = dx0/8;
+		uint32_t gy0 = dy0/8;
+		uint32_t gx1 = (dx1 + 7)/8;
+		uint32_t gy1 = (dy1 + 7)/8;
+
+		vkk_mipmapParam_t param =
+		{
+			.src_size =
+			{
+				(int32_t) vkk_mipmapPipeline_size(image->width,
+				                                  src),
+				(int32_t) vkk_mipmapPipeline_size(image->height,
+				                                  src),
+			},
+			.group_offset =
+			{
+				(int32_t) gx0,
+				(int32_t) gy0,
+			},
+			.levels = (int32_t) levels,
+		};
+
+		vkCmdBindDescriptorSets(cb,
+		                        VK_PIPELINE_BIND_POINT_COMPUTE,
+		                        self->pl, 0, 1,
+		                        &image->mip_sets[src],
+		                        0, NULL);
+		vkCmdPushConstants(cb, self->pl,
+		                   VK_SHADER_STAGE_COMPUTE_BIT, 0,
+		                   sizeof(vkk_mipmapParam_t), &param);
+		vkCmdDispatch(cb, gx1 - gx0, gy1 - gy0, 1);
+
+		// the affected region of the last dst level
+		uint32_t i;
+		for(i = 1; i <= levels; ++i)
+		{
+			dw = vkk_mipmapPipeline_size(image->width,  src + i);
+			dh = vkk_mipmapPipeline_size(image->height, src + i);
+			x0 = x0/2;
+			y0 = y0/2;
+			x1 = (x1 + 1)/2;
+			y1 = (y1 + 1)/2;
+			x1 = (x1 > dw) ? dw : x1;
+			y1 = (y1 > dh) ? dh : y1;
+		}
+		src += levels;
+
+		// the next pass reads the last dst level
+		if(src + 1 < image->mip_levels)
+		{
+			VkMemoryBarrier mb =
+			{
+				.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				.pNext         = NULL,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+			};
+
+			vkCmdPipelineBarrier(cb,
+			                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			                     0, 1, &mb, 0, NULL, 0, NULL);
+		}
+	}
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2020 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef vkk_mipmapPipeline_H
+#define vkk_mipmapPipeline_H
+
+#include <pthread.h>
+#include <vulkan/vulkan.h>
+
+#include "../vkk.h"
+
+// each compute pass downsamples a src mip level into the
+// next VKK_MIPMAP_PIPELINE_LEVELS mip levels
+#define VKK_MIPMAP_PIPELINE_LEVELS 4
+
+// maximum number of timed mip chains (two timestamp
+// queries per mip chain) between timer reads
+#define VKK_MIPMAP_PIPELINE_TIMERS 256
+
+// compute mipmap generation is an alternative to the blit
+// chain for 2D images whose format supports storage images
+// and requires the mipmap shaders in the resource file
+// (see core/resource/build-resource.sh)
+typedef struct vkk_mipmapPipeline_s
+{
+	vkk_engine_t* engine;
+
+	// apps may enable compute mipmaps (e.g. to compare
+	// with the blit chain) for subsequent images
+	int enable;
+
+	// optional GPU timestamps of the mip chains (blit or
+	// compute) which are protected by the timer_mutex
+	pthread_mutex_t timer_mutex;
+	int             timer_enable;
+	float           timer_period;
+	uint32_t        timer_count;
+	VkQueryPool     timer_pool;
+
+	VkDescriptorSetLayout dsl;
+	VkPipelineLayout      pl;
+
+	// compute pipeline for each format (or VK_NULL_HANDLE
+	// when the format is not supported)
+	VkPipeline pipeline[VKK_IMAGE_FORMAT_COUNT];
+} vkk_mipmapPipeline_t;
+
+vkk_mipmapPipeline_t* vkk_mipmapPipeline_new(vkk_engine_t* engine);
+void                  vkk_mipmapPipeline_delete(vkk_mipmapPipeline_t** _self);
+int                   vkk_mipmapPipeline_supported(vkk_mipmapPipeline_t* self,
+                                                   vkk_imageFormat_e format);
+int                   vkk_mipmapPipeline_newImage(vkk_mipmapPipeline_t* self,
+                                                  vkk_image_t* image);
+void                  vkk_mipmapPipeline_deleteImage(vkk_mipmapPipeline_t* self,
+                                                     vkk_image_t* image);
+void                  vkk_mipmapPipeline_timer(vkk_mipmapPipeline_t* self,
+                                               int enable);
+double                vkk_mipmapPipeline_elapsed(vkk_mipmapPipeline_t* self,
+                                                 uint32_t* _count);
+int                   vkk_mipmapPipeline_timerBegin(vkk_mipmapPipeline_t* self,
+                                                    VkCommandBuffer cb);
+void                  vkk_mipmapPipeline_timerEnd(vkk_mipmapPipeline_t* self,
+                                                  VkCommandBuffer cb,
+                                                  int query);
+void                  vkk_mipmapPipeline_record(vkk_mipmapPipeline_t* self,
+                                                vkk_image_t* image,
+                                                VkCommandBuffer cb,
+                                                uint32_t level,
+                                                uint32_t x, uint32_t y,
+                                                uint32_t w, uint32_t h);
+
+#endif
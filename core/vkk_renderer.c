@@ -129,7 +129,7 @@ vkk_renderer_updateUniformBufferRef(vkk_renderer_t* self,
 	VkDescriptorBufferInfo db_info =
 	{
 		.buffer  = ua->buffer->buffer[idx],
-		.offset  = 0,
+		.offset  = vkk_buffer_offset(ua->buffer, idx),
 		.range   = ua->buffer->size
 	};
 
@@ -964,6 +964,8 @@ void vkk_renderer_bindUniformSets(vkk_renderer_t* self,
 	ASSERT(us_array);
 	ASSERT(self->mode == VKK_RENDERER_MODE_DRAW);
 
+	vkk_engine_t* engine = self->engine;
+
 	double ts = vkk_renderer_tsCurrent(self);
 
 	if(us_count > VKK_ENGINE_MAX_USF_COUNT)
@@ -990,6 +992,24 @@ void vkk_renderer_bindUniformSets(vkk_renderer_t* self,
 			vkk_uniformAttachment_t* ua;
 			ua = &(us_array[i]->ua_array[j]);
 
+			// wait for pending async xfers on first use
+			if(((ua->type == VKK_UNIFORM_TYPE_STORAGE)    ||
+			    (ua->type == VKK_UNIFORM_TYPE_STORAGE_REF)) &&
+			   ua->buffer->xfer_ticket)
+			{
+				vkk_xferManager_wait(engine->xfer,
+				                     ua->buffer->xfer_ticket);
+				ua->buffer->xfer_ticket = 0;
+			}
+			else if(((ua->type == VKK_UNIFORM_TYPE_IMAGE) ||
+			         (ua->type == VKK_UNIFORM_TYPE_IMAGE_REF)) &&
+			        ua->image->xfer_ticket)
+			{
+				vkk_xferManager_wait(engine->xfer,
+				                     ua->image->xfer_ticket);
+				ua->image->xfer_ticket = 0;
+			}
+
 			if(ts != 0.0)
 			{
 				if((ua->type == VKK_UNIFORM_TYPE_BUFFER)     ||
@@ -1139,6 +1159,7 @@ void vkk_renderer_draw(vkk_renderer_t* self,
 
 		idx = vertex_buffers[i]->vbib_index;
 		vb_buffers[i] = vertex_buffers[i]->buffer[idx];
+		vb_offsets[i] = vkk_buffer_offset(vertex_buffers[i], idx);
 	}
 
 	VkCommandBuffer cb = vkk_renderer_commandBuffer(self);
@@ -1191,6 +1212,7 @@ void vkk_renderer_drawIndexed(vkk_renderer_t* self,
 
 		idx = vertex_buffers[i]->vbib_index;
 		vb_buffers[i] = vertex_buffers[i]->buffer[idx];
+		vb_offsets[i] = vkk_buffer_offset(vertex_buffers[i], idx);
 	}
 
 	VkIndexType it_map[VKK_INDEX_TYPE_COUNT] =
@@ -1200,10 +1222,11 @@ void vkk_renderer_drawIndexed(vkk_renderer_t* self,
 	};
 
 	idx = index_buffer->vbib_index;
-	VkBuffer ib_buffer = index_buffer->buffer[idx];
+	VkBuffer     ib_buffer = index_buffer->buffer[idx];
+	VkDeviceSize ib_offset = vkk_buffer_offset(index_buffer, idx);
 
 	VkCommandBuffer cb = vkk_renderer_commandBuffer(self);
-	vkCmdBindIndexBuffer(cb, ib_buffer, 0,
+	vkCmdBindIndexBuffer(cb, ib_buffer, ib_offset,
 	                     it_map[index_type]);
 	vkCmdBindVertexBuffers(cb, 0, vertex_buffer_count,
 	                       vb_buffers, vb_offsets);
@@ -23,6 +23,15 @@
 
 #include <stdlib.h>
 
+#if defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+	#define VKK_UTIL_F16C
+	#include <immintrin.h>
+#elif defined(__aarch64__)
+	#define VKK_UTIL_NEON
+	#include <arm_neon.h>
+#endif
+
 #define LOG_TAG "vkk"
 #include "../../libcc/cc_log.h"
 #include "vkk_engine.h"
@@ -30,6 +39,78 @@
 #include "vkk_uniformSetFactory.h"
 #include "vkk_util.h"
 
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static uint16_t vkk_util_convertF16Scalar(float f)
+{
+	// round to nearest even which matches the F16C and NEON
+	// conversions (denormals are preserved, overflow
+	// saturates to infinity and NaN is quieted)
+	union
+	{
+		float    f;
+		uint32_t u;
+	} in = { .f = f };
+
+	union
+	{
+		uint32_t u;
+		float    f;
+	} magic = { .u = ((127 - 15) + (23 - 10) + 1) << 23 };
+
+	uint32_t sign = in.u & 0x80000000;
+	in.u ^= sign;
+
+	uint16_t h;
+	if(in.u >= ((127 + 16) << 23))
+	{
+		// infinity or NaN
+		h = (in.u > (255 << 23)) ? 0x7E00 : 0x7C00;
+	}
+	else if(in.u < (113 << 23))
+	{
+		// denormal or zero where the float addition rounds
+		// the mantissa into the low bits
+		in.f += magic.f;
+		h = (uint16_t) (in.u - magic.u);
+	}
+	else
+	{
+		// rebias the exponent and round the mantissa
+		uint32_t odd = (in.u >> 13) & 1;
+		in.u -= (127 - 15) << 23;
+		in.u += 0xFFF + odd;
+		h = (uint16_t) (in.u >> 13);
+	}
+
+	return h | (uint16_t) (sign >> 16);
+}
+
+#ifdef VKK_UTIL_F16C
+
+__attribute__((target("avx,f16c")))
+static size_t
+vkk_util_convertF16C(uint16_t* dst, const float* src,
+                     size_t count)
+{
+	ASSERT(dst);
+	ASSERT(src);
+
+	size_t i;
+	for(i = 0; i + 8 <= count; i += 8)
+	{
+		__m256  f = _mm256_loadu_ps(&src[i]);
+		__m128i h = _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128((__m128i*) &dst[i], h);
+	}
+
+	return i;
+}
+
+#endif
+
 /***********************************************************
 * public                                                   *
 ***********************************************************/
@@ -145,6 +226,12 @@ void vkk_util_imageMemoryBarrierRaw(VkImage image,
 		srcStageMask      = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		imb.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 	}
+	else if(oldLayout == VK_IMAGE_LAYOUT_GENERAL)
+	{
+		// compute mipmaps
+		srcStageMask      = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		imb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	}
 	else
 	{
 		LOGW("invalid oldLayout=%u", oldLayout);
@@ -176,6 +263,13 @@ void vkk_util_imageMemoryBarrierRaw(VkImage image,
 		dstStageMask      = ps_map[stage];
 		imb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 	}
+	else if(newLayout == VK_IMAGE_LAYOUT_GENERAL)
+	{
+		// compute mipmaps
+		dstStageMask      = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		imb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+		                    VK_ACCESS_SHADER_WRITE_BIT;
+	}
 	else
 	{
 		LOGW("invalid newLayout=%u", newLayout);
@@ -204,11 +298,87 @@ VkFormat vkk_util_imageFormat(vkk_imageFormat_e format)
 		VK_FORMAT_R8_UNORM,
 		VK_FORMAT_R32_SFLOAT,
 		VK_FORMAT_R16_SFLOAT,
+		VK_FORMAT_BC1_RGBA_UNORM_BLOCK,
+		VK_FORMAT_BC3_UNORM_BLOCK,
+		VK_FORMAT_BC7_UNORM_BLOCK,
+		VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,
+		VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK,
+		VK_FORMAT_ASTC_4x4_UNORM_BLOCK,
+		VK_FORMAT_ASTC_8x8_UNORM_BLOCK,
 	};
 
 	return format_map[format];
 }
 
+size_t vkk_util_imageBlock(vkk_imageFormat_e format,
+                           uint32_t* _bw, uint32_t* _bh)
+{
+	ASSERT(_bw);
+	ASSERT(_bh);
+
+	// uncompressed formats are treated as 1x1 blocks
+	typedef struct
+	{
+		uint32_t bw;
+		uint32_t bh;
+		size_t   bytes;
+	} vkk_utilBlock_t;
+
+	vkk_utilBlock_t block_map[VKK_IMAGE_FORMAT_COUNT] =
+	{
+		{ 1, 1, 4  }, // VKK_IMAGE_FORMAT_RGBA8888
+		{ 1, 1, 2  }, // VKK_IMAGE_FORMAT_RGBA4444
+		{ 1, 1, 16 }, // VKK_IMAGE_FORMAT_RGBAF32
+		{ 1, 1, 8  }, // VKK_IMAGE_FORMAT_RGBAF16
+		{ 1, 1, 3  }, // VKK_IMAGE_FORMAT_RGB888
+		{ 1, 1, 2  }, // VKK_IMAGE_FORMAT_RGB565
+		{ 1, 1, 12 }, // VKK_IMAGE_FORMAT_RGBF32
+		{ 1, 1, 6  }, // VKK_IMAGE_FORMAT_RGBF16
+		{ 1, 1, 2  }, // VKK_IMAGE_FORMAT_RG88
+		{ 1, 1, 8  }, // VKK_IMAGE_FORMAT_RGF32
+		{ 1, 1, 4  }, // VKK_IMAGE_FORMAT_RGF16
+		{ 1, 1, 1  }, // VKK_IMAGE_FORMAT_R8
+		{ 1, 1, 4  }, // VKK_IMAGE_FORMAT_RF32
+		{ 1, 1, 2  }, // VKK_IMAGE_FORMAT_RF16
+		{ 4, 4, 8  }, // VKK_IMAGE_FORMAT_BC1RGBA
+		{ 4, 4, 16 }, // VKK_IMAGE_FORMAT_BC3RGBA
+		{ 4, 4, 16 }, // VKK_IMAGE_FORMAT_BC7RGBA
+		{ 4, 4, 8  }, // VKK_IMAGE_FORMAT_ETC2RGB
+		{ 4, 4, 16 }, // VKK_IMAGE_FORMAT_ETC2RGBA
+		{ 4, 4, 16 }, // VKK_IMAGE_FORMAT_ASTC4X4
+		{ 8, 8, 16 }, // VKK_IMAGE_FORMAT_ASTC8X8
+	};
+
+	*_bw = block_map[format].bw;
+	*_bh = block_map[format].bh;
+	return block_map[format].bytes;
+}
+
+int vkk_util_imageCompressed(vkk_imageFormat_e format)
+{
+	uint32_t bw;
+	uint32_t bh;
+	vkk_util_imageBlock(format, &bw, &bh);
+
+	return (bw > 1) || (bh > 1);
+}
+
+size_t vkk_util_imageSize(vkk_imageFormat_e format,
+                          uint32_t width, uint32_t height,
+                          uint32_t depth)
+{
+	// the size of compressed images is rounded up to
+	// include the partial blocks
+	uint32_t bw;
+	uint32_t bh;
+	size_t   bytes;
+	bytes = vkk_util_imageBlock(format, &bw, &bh);
+
+	size_t bx = (width  + bw - 1)/bw;
+	size_t by = (height + bh - 1)/bh;
+	return bx*by*depth*bytes;
+}
+
 void
 vkk_util_copyUniformAttachmentArray(vkk_uniformAttachment_t* dst,
                                     uint32_t src_ua_count,
@@ -270,3 +440,33 @@ vkk_util_fillUniformAttachmentArray(vkk_uniformAttachment_t* dst,
 		dst[b].buffer = src[i].buffer;
 	}
 }
+
+void vkk_util_convertF16(uint16_t* dst, const float* src,
+                         size_t count)
+{
+	ASSERT(dst);
+	ASSERT(src);
+
+	// convert the bulk of the pixels with SIMD when the CPU
+	// supports F16C (x86) or NEON (arm64) and the remainder
+	// with the scalar fallback
+	size_t i = 0;
+	#if defined(VKK_UTIL_F16C)
+	if(__builtin_cpu_supports("avx") &&
+	   __builtin_cpu_supports("f16c"))
+	{
+		i = vkk_util_convertF16C(dst, src, count);
+	}
+	#elif defined(VKK_UTIL_NEON)
+	for(; i + 4 <= count; i += 4)
+	{
+		float16x4_t h = vcvt_f16_f32(vld1q_f32(&src[i]));
+		vst1_u16(&dst[i], vreinterpret_u16_f16(h));
+	}
+	#endif
+
+	for(; i < count; ++i)
+	{
+		dst[i] = vkk_util_convertF16Scalar(src[i]);
+	}
+}
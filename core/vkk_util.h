@@ -39,6 +39,12 @@ void     vkk_util_imageMemoryBarrierRaw(VkImage image,
                                         uint32_t baseMipLevel,
                                         uint32_t levelCount);
 VkFormat vkk_util_imageFormat(vkk_imageFormat_e format);
+size_t   vkk_util_imageBlock(vkk_imageFormat_e format,
+                             uint32_t* _bw, uint32_t* _bh);
+int      vkk_util_imageCompressed(vkk_imageFormat_e format);
+size_t   vkk_util_imageSize(vkk_imageFormat_e format,
+                            uint32_t width, uint32_t height,
+                            uint32_t depth);
 void     vkk_util_copyUniformAttachmentArray(vkk_uniformAttachment_t* dst,
                                              uint32_t src_ua_count,
                                              vkk_uniformAttachment_t* src,
@@ -47,5 +53,8 @@ void     vkk_util_fillUniformAttachmentArray(vkk_uniformAttachment_t* dst,
                                              uint32_t src_ua_count,
                                              vkk_uniformAttachment_t* src,
                                              vkk_uniformSetFactory_t* usf);
+void     vkk_util_convertF16(uint16_t* dst,
+                             const float* src,
+                             size_t count);
 
 #endif
@@ -28,6 +28,7 @@
 #include "../../libcc/cc_memory.h"
 #include "vkk_buffer.h"
 #include "vkk_commandBuffer.h"
+#include "vkk_defaultRenderer.h"
 #include "vkk_engine.h"
 #include "vkk_xferManager.h"
 #include "vkk_image.h"
@@ -40,6 +41,7 @@
 
 typedef struct vkk_xferBuffer_s
 {
+	size_t        size;
 	VkBuffer      buffer;
 	vkk_memory_t* memory;
 } vkk_xferBuffer_t;
@@ -48,15 +50,61 @@ typedef struct vkk_xferInstance_s
 {
 	VkFence              fence;
 	vkk_commandBuffer_t* cmd_buffer;
+
+	// copies recorded for the dedicated transfer queue
+	// which are released to the graphics queue family and
+	// acquired by cmd_buffer after waiting on the semaphore
+	// (only when the device has a transfer queue)
+	vkk_commandBuffer_t* transfer_cmd_buffer;
+	VkSemaphore          semaphore;
+	int                  transfer;
+
+	// persistently mapped staging ring which is reset when
+	// the instance is recycled
+	vkk_xferBuffer_t* ring;
+	size_t            ring_offset;
+
+	// xfer buffer which is returned to the readback cache
+	// (or deleted when it is a temporary upload buffer)
+	// when the instance is recycled
+	vkk_xferBuffer_t* xb;
+	int               readback;
+
+	// pending async xfer ticket and the number of threads
+	// waiting on the fence (which prevents recycling)
+	uint64_t ticket;
+	int      waiters;
 } vkk_xferInstance_t;
 
+typedef struct vkk_readback_s
+{
+	// image and frame_list iter are set while the readback
+	// is pending in the frame_list and a claimed readback is
+	// being submitted by vkk_xferManager_mapReadback()
+	vkk_image_t*   image;
+	cc_listIter_t* iter;
+	int            claimed;
+
+	// the copy completes when the frame timestamp expires
+	// (default renderer) or when the ticket of the xfer
+	// completes (headless) and the readback buffer is held
+	// until the readback is deleted and is then returned to
+	// the cache
+	double            ts;
+	uint64_t          ticket;
+	size_t            size;
+	vkk_xferBuffer_t* xb;
+	int               invalidated;
+} vkk_readback_t;
+
 /***********************************************************
 * private                                                  *
 ***********************************************************/
 
 static vkk_xferBuffer_t*
-vkk_xferBuffer_new(vkk_engine_t* engine, size_t size,
-                   const void* data)
+vkk_xferBuffer_new(vkk_engine_t* engine,
+                   vkk_memoryClass_e mclass,
+                   size_t size, const void* data)
 {
 	// data may be NULL
 	ASSERT(engine);
@@ -70,6 +118,8 @@ vkk_xferBuffer_new(vkk_engine_t* engine, size_t size,
 		return NULL;
 	}
 
+	self->size = size;
+
 	// create a transfer buffer
 	VkBufferCreateInfo b_info =
 	{
@@ -91,10 +141,16 @@ vkk_xferBuffer_new(vkk_engine_t* engine, size_t size,
 		goto fail_buffer;
 	}
 
-	// memory is initialized
+	// upload memory is initialized
+	// transfer buffers are cache-like data which may be
+	// recreated so they are demoted first and the eviction
+	// callback is not invoked since transfer buffers may be
+	// created while the xfer lock is held
 	self->memory = vkk_memoryManager_allocBuffer(engine->mm,
 	                                             self->buffer,
-	                                             0, size, data);
+	                                             mclass,
+	                                             VKK_MEMORY_PRIORITY_LOW,
+	                                             size, data, 0);
 	if(self->memory == NULL)
 	{
 		goto fail_alloc;
@@ -120,7 +176,7 @@ vkk_xferBuffer_delete(vkk_xferBuffer_t** _self)
 	if(self)
 	{
 		vkk_engine_t* engine;
-		engine = self->memory->chunk->pool->mm->engine;
+		engine = self->memory->chunk->mm->engine;
 
 		vkk_memoryManager_free(engine->mm, &self->memory);
 		vkDestroyBuffer(engine->device, self->buffer, NULL);
@@ -164,10 +220,39 @@ vkk_xferInstance_new(vkk_engine_t* engine)
 		goto fail_cmd_buffer;
 	}
 
+	if(engine->has_transfer_queue)
+	{
+		self->transfer_cmd_buffer = vkk_commandBuffer_newFamily(engine,
+		                                                        1, 0,
+		                                                        engine->transfer_family_index);
+		if(self->transfer_cmd_buffer == NULL)
+		{
+			goto fail_transfer_cmd_buffer;
+		}
+
+		VkSemaphoreCreateInfo s_info =
+		{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			.pNext = NULL,
+			.flags = 0
+		};
+
+		if(vkCreateSemaphore(engine->device, &s_info, NULL,
+		                     &self->semaphore) != VK_SUCCESS)
+		{
+			LOGE("vkCreateSemaphore failed");
+			goto fail_semaphore;
+		}
+	}
+
 	// success
 	return self;
 
 	// failure
+	fail_semaphore:
+		vkk_commandBuffer_delete(&self->transfer_cmd_buffer);
+	fail_transfer_cmd_buffer:
+		vkk_commandBuffer_delete(&self->cmd_buffer);
 	fail_cmd_buffer:
 		vkDestroyFence(engine->device, self->fence, NULL);
 	fail_fence:
@@ -186,6 +271,14 @@ vkk_xferInstance_delete(vkk_xferInstance_t** _self)
 		vkk_engine_t* engine;
 		engine = self->cmd_buffer->engine;
 
+		vkk_xferBuffer_delete(&self->xb);
+		vkk_xferBuffer_delete(&self->ring);
+		if(self->semaphore != VK_NULL_HANDLE)
+		{
+			vkDestroySemaphore(engine->device,
+			                   self->semaphore, NULL);
+		}
+		vkk_commandBuffer_delete(&self->transfer_cmd_buffer);
 		vkk_commandBuffer_delete(&self->cmd_buffer);
 		vkDestroyFence(engine->device, self->fence, NULL);
 		FREE(self);
@@ -193,306 +286,1406 @@ vkk_xferInstance_delete(vkk_xferInstance_t** _self)
 	}
 }
 
-static void
-vkk_xferManager_lock(vkk_xferManager_t* self)
+static size_t
+vkk_xferInstance_offset(vkk_xferInstance_t* self,
+                        size_t align)
 {
 	ASSERT(self);
 
-	pthread_mutex_lock(&self->mutex);
-	TRACE_BEGIN();
+	return align*((self->ring_offset + align - 1)/align);
 }
 
-static void
-vkk_xferManager_unlock(vkk_xferManager_t* self)
+static int
+vkk_xferInstance_fits(vkk_xferInstance_t* self,
+                      size_t size, size_t align)
 {
 	ASSERT(self);
 
-	TRACE_END();
-	pthread_mutex_unlock(&self->mutex);
+	// the instance holds at most one temporary buffer
+	if(size > VKK_XFER_RING_SIZE)
+	{
+		return self->xb == NULL;
+	}
+
+	size_t offset = vkk_xferInstance_offset(self, align);
+	return (offset + size <= VKK_XFER_RING_SIZE) ||
+	       (self->xb == NULL);
 }
 
-static int
-vkk_xferManager_writeImageF16(vkk_xferManager_t* self,
-                              vkk_image_t* image,
-                              const void* pixels)
+static void
+vkk_xferInstance_write(vkk_engine_t* engine,
+                       vkk_memory_t* memory,
+                       size_t offset, size_t size,
+                       int f16, const void* data)
 {
-	ASSERT(self);
-	ASSERT(image);
-	ASSERT(pixels);
-
-	vkk_engine_t* engine = self->engine;
+	ASSERT(engine);
+	ASSERT(memory);
+	ASSERT(data);
 
-	// tmp image is F32 format (F16 format - 1)
-	vkk_image_t* tmp;
-	tmp = vkk_image_new(engine,
-	                    image->width, image->height,
-	                    image->depth, image->format - 1,
-	                    image->mipmap, image->stage,
-	                    pixels);
-	if(tmp == NULL)
+	// F16 data is converted from F32 while staging
+	if(f16)
 	{
-		return 0;
+		vkk_memoryManager_writeF16(engine->mm, memory,
+		                           offset, size,
+		                           (const float*) data);
+	}
+	else
+	{
+		vkk_memoryManager_write(engine->mm, memory,
+		                        offset, size, data);
 	}
+}
 
-	vkk_xferManager_lock(self);
+static int
+vkk_xferInstance_stage(vkk_xferInstance_t* self,
+                       vkk_engine_t* engine,
+                       size_t size, size_t align,
+                       int f16, const void* data,
+                       VkBuffer* _buffer,
+                       VkDeviceSize* _offset)
+{
+	ASSERT(self);
+	ASSERT(engine);
+	ASSERT(data);
+	ASSERT(_buffer);
+	ASSERT(_offset);
 
-	vkk_xferInstance_t* xi;
-	cc_listIter_t* iter = cc_list_head(self->instance_list);
-	if(iter)
+	// oversized uploads fall back to a temporary buffer
+	// which is deleted when the instance is recycled
+	size_t offset = vkk_xferInstance_offset(self, align);
+	if((size > VKK_XFER_RING_SIZE) ||
+	   (offset + size > VKK_XFER_RING_SIZE))
 	{
-		xi = (vkk_xferInstance_t*)
-		     cc_list_remove(self->instance_list, &iter);
+		ASSERT(self->xb == NULL);
+
+		self->xb = vkk_xferBuffer_new(engine,
+		                              VKK_MEMORY_CLASS_UPLOAD,
+		                              size, f16 ? NULL : data);
+		if(self->xb == NULL)
+		{
+			return 0;
+		}
+		self->readback = 0;
+
+		if(f16)
+		{
+			vkk_xferInstance_write(engine, self->xb->memory,
+			                       0, size, f16, data);
+		}
+
+		*_buffer = self->xb->buffer;
+		*_offset = 0;
+		return 1;
 	}
-	else
+
+	// the ring is created on demand and persists for the
+	// lifetime of the instance
+	if(self->ring == NULL)
 	{
-		xi = vkk_xferInstance_new(engine);
-		if(xi == NULL)
+		self->ring = vkk_xferBuffer_new(engine,
+		                                VKK_MEMORY_CLASS_UPLOAD,
+		                                VKK_XFER_RING_SIZE,
+		                                NULL);
+		if(self->ring == NULL)
 		{
-			vkk_xferManager_unlock(self);
-			goto fail_xi;
+			return 0;
 		}
 	}
-	vkk_xferManager_unlock(self);
 
-	VkCommandBuffer cb;
-	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
+	vkk_xferInstance_write(engine, self->ring->memory,
+	                       offset, size, f16, data);
+	self->ring_offset = offset + size;
 
-	vkResetFences(engine->device, 1, &xi->fence);
-	if(vkResetCommandBuffer(cb, 0) != VK_SUCCESS)
+	*_buffer = self->ring->buffer;
+	*_offset = offset;
+	return 1;
+}
+
+static VkCommandBuffer
+vkk_xferInstance_beginTransfer(vkk_xferInstance_t* self)
+{
+	ASSERT(self);
+
+	// copies are recorded for the graphics queue when the
+	// device does not have a transfer queue
+	if(self->transfer_cmd_buffer == NULL)
 	{
-		LOGE("vkResetCommandBuffer failed");
-		goto fail_cb;
+		return VK_NULL_HANDLE;
 	}
 
-	// begin the transfer commands
-	VkCommandBufferInheritanceInfo cbi_info =
+	VkCommandBuffer tcb;
+	tcb = vkk_commandBuffer_get(self->transfer_cmd_buffer, 0);
+	if(self->transfer)
 	{
-		.sType                = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
-		.pNext                = NULL,
-		.renderPass           = VK_NULL_HANDLE,
-		.subpass              = 0,
-		.framebuffer          = VK_NULL_HANDLE,
-		.occlusionQueryEnable = VK_FALSE,
-		.queryFlags           = 0,
-		.pipelineStatistics   = 0
-	};
+		return tcb;
+	}
+
+	if(vkResetCommandBuffer(tcb, 0) != VK_SUCCESS)
+	{
+		LOGE("vkResetCommandBuffer failed");
+		return VK_NULL_HANDLE;
+	}
 
 	VkCommandBufferBeginInfo cb_info =
 	{
 		.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
 		.pNext            = NULL,
 		.flags            = 0,
-		.pInheritanceInfo = &cbi_info
+		.pInheritanceInfo = NULL
 	};
 
-	if(vkBeginCommandBuffer(cb, &cb_info) != VK_SUCCESS)
+	if(vkBeginCommandBuffer(tcb, &cb_info) != VK_SUCCESS)
 	{
 		LOGE("vkBeginCommandBuffer failed");
-		goto fail_begin_cb;
+		return VK_NULL_HANDLE;
 	}
 
-	// transition tmp to src for blitting
-	vkk_util_imageMemoryBarrier(tmp, cb,
-	                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-	                            0, tmp->mip_levels);
-
-	// transition image to dst for blitting
-	vkk_util_imageMemoryBarrier(image, cb,
-	                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-	                            0, image->mip_levels);
+	self->transfer = 1;
 
-	// blit each mip_level from tmp to image
-	int i;
-	uint32_t w = image->width;
-	uint32_t h = image->height;
-	uint32_t d = image->depth;
-	for(i = 0; i < image->mip_levels; ++i)
-	{
-		VkImageBlit ib =
-		{
-			.srcSubresource =
-			{
-				.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel       = i,
-				.baseArrayLayer = 0,
-				.layerCount     = 1
-			},
-			.srcOffsets =
-			{
-				{
-					.x = 0,
-					.y = 0,
-					.z = 0,
-				},
-				{
-					.x = (uint32_t) (w >> i),
-					.y = (uint32_t) (h >> i),
-					.z = (uint32_t) (d >> i),
-				}
-			},
-			.dstSubresource =
-			{
-				.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel       = i,
-				.baseArrayLayer = 0,
-				.layerCount     = 1
-			},
-			.dstOffsets =
-			{
-				{
-					.x = 0,
-					.y = 0,
-					.z = 0,
-				},
-				{
-					.x = (uint32_t) (w >> i),
-					.y = (uint32_t) (h >> i),
-					.z = (uint32_t) (d >> i),
-				}
-			}
-		};
+	return tcb;
+}
 
-		// enforce the minimum size
-		if(ib.srcOffsets[1].x == 0)
-		{
-			ib.srcOffsets[1].x = 1;
-		}
-		if(ib.srcOffsets[1].y == 0)
-		{
-			ib.srcOffsets[1].y = 1;
-		}
-		if(ib.srcOffsets[1].z == 0)
-		{
-			ib.srcOffsets[1].z = 1;
-		}
-		if(ib.dstOffsets[1].x == 0)
-		{
-			ib.dstOffsets[1].x = 1;
-		}
-		if(ib.dstOffsets[1].y == 0)
-		{
-			ib.dstOffsets[1].y = 1;
-		}
-		if(ib.dstOffsets[1].z == 0)
-		{
-			ib.dstOffsets[1].z = 1;
-		}
+static void
+vkk_xferManager_lock(vkk_xferManager_t* self)
+{
+	ASSERT(self);
 
-		vkCmdBlitImage(cb,
-		               tmp->image,
-		               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-		               image->image,
-		               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		               1, &ib, VK_FILTER_NEAREST);
-	}
+	pthread_mutex_lock(&self->mutex);
+	TRACE_BEGIN();
+}
 
-	// transition image shading mode
-	vkk_util_imageMemoryBarrier(image, cb,
-	                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-	                            0, image->mip_levels);
+static void
+vkk_xferManager_unlock(vkk_xferManager_t* self)
+{
+	ASSERT(self);
 
-	// end the transfer commands
-	vkEndCommandBuffer(cb);
+	TRACE_END();
+	pthread_mutex_unlock(&self->mutex);
+}
 
-	// submit the commands
-	if(vkk_engine_queueSubmit(engine, VKK_QUEUE_BACKGROUND, &cb,
-	                          0, NULL, NULL, NULL,
-	                          xi->fence) == 0)
+static size_t vkk_xferManager_sizeClass(size_t size)
+{
+	// round up to a quarter of the largest power-of-two
+	// which does not exceed the size (at most 25% waste)
+	if(size <= VKK_XFER_READBACK_MIN)
 	{
-		goto fail_submit;
+		return VKK_XFER_READBACK_MIN;
 	}
 
-	uint64_t timeout = UINT64_MAX;
-	if(vkWaitForFences(engine->device, 1, &xi->fence, VK_TRUE,
-	                   timeout) != VK_SUCCESS)
+	size_t p = VKK_XFER_READBACK_MIN;
+	while(2*p <= size)
 	{
-		LOGW("vkWaitForFences failed");
-		vkk_engine_queueWaitIdle(engine, VKK_QUEUE_BACKGROUND);
+		p *= 2;
 	}
 
-	vkk_xferManager_lock(self);
-	if(cc_list_append(self->instance_list, NULL,
-	                  (const void*) xi) == NULL)
+	size_t step = p/4;
+	return step*((size + step - 1)/step);
+}
+
+// debug functions only used by ASSERT
+#ifdef ASSERT_DEBUG
+
+static int vkk_xferManager_checkSizeClass(void)
+{
+	// known values
+	size_t table[][2] =
+	{
+		{ 0,             65536   },
+		{ 1,             65536   },
+		{ 65536,         65536   },
+		{ 65537,         81920   },
+		{ 131072,        131072  },
+		{ 131073,        163840  },
+		{ 200000,        229376  },
+		{ 1048576,       1048576 },
+		{ 1048577,       1310720 },
+		{ 3*1048576,     3145728 },
+		{ 4*1048576 - 1, 4194304 },
+	};
+
+	int i;
+	int n = (int) (sizeof(table)/sizeof(table[0]));
+	for(i = 0; i < n; ++i)
 	{
-		vkk_xferInstance_delete(&xi);
+		size_t size_class = vkk_xferManager_sizeClass(table[i][0]);
+		if(size_class != table[i][1])
+		{
+			LOGW("invalid size=%u, size_class=%u, expected=%u",
+			     (unsigned int) table[i][0],
+			     (unsigned int) size_class,
+			     (unsigned int) table[i][1]);
+			return 0;
+		}
 	}
-	vkk_xferManager_unlock(self);
 
-	vkk_image_delete(&tmp);
+	// classes must hold the size, waste at most 25%, be
+	// stable and be monotonic
+	size_t last = 0;
+	size_t size;
+	for(size = 1; size <= 64*1024*1024; size += size/7 + 1)
+	{
+		size_t size_class = vkk_xferManager_sizeClass(size);
+		if((size_class < size)                            ||
+		   (size_class < VKK_XFER_READBACK_MIN)           ||
+		   ((size > VKK_XFER_READBACK_MIN) &&
+		    (4*(size_class - size) > size))               ||
+		   (vkk_xferManager_sizeClass(size_class) != size_class) ||
+		   (size_class < last))
+		{
+			LOGW("invalid size=%u, size_class=%u",
+			     (unsigned int) size, (unsigned int) size_class);
+			return 0;
+		}
+		last = size_class;
+	}
 
-	// success
 	return 1;
-
-	// failure
-	fail_submit:
-	fail_begin_cb:
-	fail_cb:
-		vkk_xferInstance_delete(&xi);
-	fail_xi:
-		vkk_image_delete(&tmp);
-	return 0;
 }
 
-/***********************************************************
-* public                                                   *
-***********************************************************/
+#endif
 
-vkk_xferManager_t*
-vkk_xferManager_new(vkk_engine_t* engine)
+static void
+vkk_xferManager_readbackTrim(vkk_xferManager_t* self,
+                             size_t cap)
 {
-	ASSERT(engine);
+	ASSERT(self);
 
-	vkk_xferManager_t* self;
-	self = (vkk_xferManager_t*)
-	       CALLOC(1, sizeof(vkk_xferManager_t));
-	if(self == NULL)
+	// xfer manager must be locked
+
+	// evict the least recently used buffers from the head
+	cc_listIter_t* iter = cc_list_head(self->readback_list);
+	while(iter && (self->readback_size > cap))
 	{
-		LOGE("CALLOC failed");
-		return NULL;
+		vkk_xferBuffer_t* xb;
+		xb = (vkk_xferBuffer_t*)
+		     cc_list_remove(self->readback_list, &iter);
+		self->readback_size -= xb->size;
+		vkk_xferBuffer_delete(&xb);
 	}
+}
 
-	self->engine = engine;
+static vkk_xferBuffer_t*
+vkk_xferManager_readbackGet(vkk_xferManager_t* self,
+                            size_t size)
+{
+	ASSERT(self);
 
-	self->instance_list = cc_list_new();
-	if(self->instance_list == NULL)
-	{
-		goto fail_instance_list;
-	}
+	// xfer manager must be locked
 
-	self->buffer_map = cc_multimap_new(NULL);
-	if(self->buffer_map == NULL)
-	{
-		goto fail_buffer_map;
-	}
+	vkk_engine_t* engine = self->engine;
 
-	if(pthread_mutex_init(&self->mutex, NULL) != 0)
+	// reuse the most recently used buffer of the size class
+	size_t size_class = vkk_xferManager_sizeClass(size);
+	cc_listIter_t* iter = cc_list_tail(self->readback_list);
+	while(iter)
 	{
-		LOGE("pthread_mutex_init failed");
-		goto fail_mutex;
-	}
+		vkk_xferBuffer_t* xb;
+		xb = (vkk_xferBuffer_t*) cc_list_peekIter(iter);
+		if(xb->size == size_class)
+		{
+			cc_list_remove(self->readback_list, &iter);
+			self->readback_size -= xb->size;
+			return xb;
+		}
 
-	// success
-	return self;
+		iter = cc_list_prev(iter);
+	}
 
-	// failure
-	fail_mutex:
-		cc_multimap_delete(&self->buffer_map);
-	fail_buffer_map:
-		cc_list_delete(&self->instance_list);
-	fail_instance_list:
-		FREE(self);
-	return NULL;
+	return vkk_xferBuffer_new(engine,
+	                          VKK_MEMORY_CLASS_READBACK,
+	                          size_class, NULL);
 }
 
-void vkk_xferManager_delete(vkk_xferManager_t** _self)
+static void
+vkk_xferManager_readbackPut(vkk_xferManager_t* self,
+                            vkk_xferBuffer_t* xb)
 {
-	ASSERT(_self);
+	ASSERT(self);
+	ASSERT(xb);
 
-	vkk_xferManager_t* self = *_self;
-	if(self)
+	// xfer manager must be locked
+
+	// the most recently used buffers are appended to the
+	// tail of the cache
+	if((xb->size > self->readback_cap) ||
+	   (cc_list_append(self->readback_list, NULL,
+	                   (const void*) xb) == NULL))
 	{
-		cc_listIter_t* iter = cc_list_head(self->instance_list);
-		while(iter)
+		vkk_xferBuffer_delete(&xb);
+		return;
+	}
+
+	self->readback_size += xb->size;
+	vkk_xferManager_readbackTrim(self, self->readback_cap);
+}
+
+static void
+vkk_xferManager_recycle(vkk_xferManager_t* self,
+                        vkk_xferInstance_t* xi)
+{
+	ASSERT(self);
+	ASSERT(xi);
+
+	// xfer manager must be locked
+
+	vkk_xferBuffer_t* xb = xi->xb;
+	if(xb)
+	{
+		if(xi->readback)
+		{
+			vkk_xferManager_readbackPut(self, xb);
+		}
+		else
+		{
+			vkk_xferBuffer_delete(&xb);
+		}
+		xi->xb       = NULL;
+		xi->readback = 0;
+	}
+
+	xi->ring_offset = 0;
+	xi->transfer    = 0;
+	xi->ticket      = 0;
+	if((cc_list_size(self->instance_list) >=
+	    VKK_XFER_INSTANCE_IDLE) ||
+	   (cc_list_append(self->instance_list, NULL,
+	                   (const void*) xi) == NULL))
+	{
+		vkk_xferInstance_delete(&xi);
+	}
+}
+
+static void
+vkk_xferManager_reclaim(vkk_xferManager_t* self)
+{
+	ASSERT(self);
+
+	// xfer manager must be locked
+
+	vkk_engine_t* engine = self->engine;
+
+	// recycle the completed async xfer instances
+	cc_listIter_t* iter = cc_list_head(self->pending_list);
+	while(iter)
+	{
+		vkk_xferInstance_t* xi;
+		xi = (vkk_xferInstance_t*) cc_list_peekIter(iter);
+		if((xi->waiters == 0) &&
+		   (vkGetFenceStatus(engine->device,
+		                     xi->fence) == VK_SUCCESS))
+		{
+			cc_list_remove(self->pending_list, &iter);
+			vkk_xferManager_recycle(self, xi);
+		}
+		else
+		{
+			iter = cc_list_next(iter);
+		}
+	}
+}
+
+static vkk_xferInstance_t*
+vkk_xferManager_pending(vkk_xferManager_t* self,
+                        uint64_t ticket)
+{
+	ASSERT(self);
+
+	// xfer manager must be locked
+
+	cc_listIter_t* iter = cc_list_head(self->pending_list);
+	while(iter)
+	{
+		vkk_xferInstance_t* xi;
+		xi = (vkk_xferInstance_t*) cc_list_peekIter(iter);
+		if(xi->ticket == ticket)
+		{
+			return xi;
+		}
+
+		iter = cc_list_next(iter);
+	}
+
+	return NULL;
+}
+
+static void
+vkk_xferManager_waitFence(vkk_xferManager_t* self,
+                          vkk_xferInstance_t* xi)
+{
+	ASSERT(self);
+	ASSERT(xi);
+
+	vkk_engine_t* engine = self->engine;
+
+	uint64_t timeout = UINT64_MAX;
+	if(vkWaitForFences(engine->device, 1, &xi->fence, VK_TRUE,
+	                   timeout) != VK_SUCCESS)
+	{
+		LOGW("vkWaitForFences failed");
+		vkk_engine_queueWaitIdle(engine, VKK_QUEUE_BACKGROUND);
+	}
+}
+
+static void
+vkk_xferManager_finish(vkk_xferManager_t* self,
+                       vkk_xferInstance_t* xi,
+                       vkk_xferBuffer_t* xb,
+                       uint64_t* _ticket)
+{
+	// xb and _ticket may be NULL
+	ASSERT(self);
+	ASSERT(xi);
+
+	// the readback buffer is returned to the cache when the
+	// instance is recycled while the temporary staging
+	// buffer is already owned by the instance
+	if(xb)
+	{
+		ASSERT(xi->xb == NULL);
+
+		xi->xb       = xb;
+		xi->readback = 1;
+	}
+
+	// async xfers return a ticket and the instance is
+	// recycled once the fence is signaled
+	vkk_xferManager_lock(self);
+	if(_ticket)
+	{
+		xi->ticket = self->ticket_next;
+		if(cc_list_append(self->pending_list, NULL,
+		                  (const void*) xi))
+		{
+			*_ticket = self->ticket_next++;
+			vkk_xferManager_reclaim(self);
+			vkk_xferManager_unlock(self);
+			return;
+		}
+
+		// fall back to a synchronous xfer
+		*_ticket = 0;
+	}
+	vkk_xferManager_unlock(self);
+
+	vkk_xferManager_waitFence(self, xi);
+
+	vkk_xferManager_lock(self);
+	vkk_xferManager_recycle(self, xi);
+	vkk_xferManager_unlock(self);
+}
+
+static int
+vkk_xferManager_submit(vkk_xferManager_t* self,
+                       vkk_xferInstance_t* xi)
+{
+	ASSERT(self);
+	ASSERT(xi);
+
+	vkk_engine_t* engine = self->engine;
+
+	VkCommandBuffer cb;
+	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
+
+	if(xi->transfer == 0)
+	{
+		return vkk_engine_queueSubmit(engine,
+		                              VKK_QUEUE_BACKGROUND, &cb,
+		                              0, NULL, NULL, NULL,
+		                              xi->fence);
+	}
+
+	// submit the copies to the transfer queue and the
+	// graphics queue acquires the resources once the
+	// semaphore is signaled
+	VkCommandBuffer tcb;
+	tcb = vkk_commandBuffer_get(xi->transfer_cmd_buffer, 0);
+	vkEndCommandBuffer(tcb);
+
+	if(vkk_engine_queueSubmit(engine, VKK_QUEUE_TRANSFER, &tcb,
+	                          0, NULL, &xi->semaphore, NULL,
+	                          VK_NULL_HANDLE) == 0)
+	{
+		return 0;
+	}
+
+	VkPipelineStageFlags wait_dst_stage_mask;
+	wait_dst_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if(vkk_engine_queueSubmit(engine, VKK_QUEUE_BACKGROUND, &cb,
+	                          1, &xi->semaphore, NULL,
+	                          &wait_dst_stage_mask,
+	                          xi->fence) == 0)
+	{
+		// the semaphore must not be in use when the
+		// instance is deleted
+		vkk_engine_queueWaitIdle(engine, VKK_QUEUE_TRANSFER);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void
+vkk_xferManager_waitTicket(vkk_xferManager_t* self,
+                           uint64_t* _ticket)
+{
+	ASSERT(self);
+	ASSERT(_ticket);
+
+	// wait for a pending async xfer of a resource before
+	// it is accessed by another xfer
+	if(*_ticket)
+	{
+		vkk_xferManager_wait(self, *_ticket);
+		*_ticket = 0;
+	}
+}
+
+static uint32_t
+vkk_xferManager_imageLevels(vkk_image_t* image)
+{
+	ASSERT(image);
+
+	// the mip levels of compressed images cannot be
+	// generated by blits or compute so the pixels include
+	// the pre-compressed mip levels
+	if(vkk_util_imageCompressed(image->format))
+	{
+		return image->mip_levels;
+	}
+
+	return 1;
+}
+
+static size_t
+vkk_xferManager_imageStaging(vkk_image_t* image,
+                             uint32_t w, uint32_t h,
+                             uint32_t d, uint32_t levels,
+                             size_t* _align, int* _f16)
+{
+	ASSERT(image);
+	ASSERT(_align);
+	ASSERT(_f16);
+
+	// the buffer offset of an image copy must be a multiple
+	// of the texel (or block) size and 4 so the 3, 6 and 12
+	// byte texels of the RGB formats require a larger
+	// alignment
+	uint32_t bw;
+	uint32_t bh;
+	size_t   bytes;
+	bytes   = vkk_util_imageBlock(image->format, &bw, &bh);
+	*_align = VKK_XFER_RING_ALIGN;
+	if((bytes%3) == 0)
+	{
+		*_align = 3*VKK_XFER_RING_ALIGN;
+	}
+
+	// F16 images are a special case because the source
+	// pixels are in F32 format since there is not a native
+	// F16 type in C so the pixels are converted on the CPU
+	// while staging
+	*_f16 = (image->format == VKK_IMAGE_FORMAT_RGBAF16) ||
+	        (image->format == VKK_IMAGE_FORMAT_RGBF16)  ||
+	        (image->format == VKK_IMAGE_FORMAT_RGF16)   ||
+	        (image->format == VKK_IMAGE_FORMAT_RF16);
+
+	// the mip levels are packed in order where each level
+	// is a whole number of blocks
+	size_t   size = 0;
+	uint32_t i;
+	for(i = 0; i < levels; ++i)
+	{
+		size += vkk_util_imageSize(image->format, w, h, d);
+		w = (w > 1) ? w/2 : 1;
+		h = (h > 1) ? h/2 : 1;
+		d = (d > 1) ? d/2 : 1;
+	}
+
+	return size;
+}
+
+static void
+vkk_xferManager_copyImage(VkCommandBuffer cb,
+                          vkk_image_t* image,
+                          uint32_t levels,
+                          VkBuffer src_buffer,
+                          VkDeviceSize src_offset)
+{
+	ASSERT(image);
+
+	uint32_t w = image->width;
+	uint32_t h = image->height;
+	uint32_t d = image->depth;
+
+	uint32_t i;
+	for(i = 0; i < levels; ++i)
+	{
+		VkBufferImageCopy bic =
+		{
+			.bufferOffset      = src_offset,
+			.bufferRowLength   = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource  =
+			{
+				.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel       = i,
+				.baseArrayLayer = 0,
+				.layerCount     = 1
+			},
+			.imageOffset =
+			{
+				.x = 0,
+				.y = 0,
+				.z = 0,
+			},
+			.imageExtent =
+			{
+				.width  = w,
+				.height = h,
+				.depth  = d
+			}
+		};
+
+		vkCmdCopyBufferToImage(cb, src_buffer, image->image,
+		                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		                       1, &bic);
+
+		src_offset += vkk_util_imageSize(image->format, w, h, d);
+		w = (w > 1) ? w/2 : 1;
+		h = (h > 1) ? h/2 : 1;
+		d = (d > 1) ? d/2 : 1;
+	}
+}
+
+static void
+vkk_xferManager_recordImage(vkk_xferManager_t* self,
+                            VkCommandBuffer tcb,
+                            VkCommandBuffer cb,
+                            vkk_image_t* image,
+                            VkBuffer src_buffer,
+                            VkDeviceSize src_offset)
+{
+	// tcb may be VK_NULL_HANDLE
+	ASSERT(self);
+	ASSERT(image);
+
+	vkk_engine_t* engine = self->engine;
+
+	uint32_t levels = vkk_xferManager_imageLevels(image);
+
+	if(tcb == VK_NULL_HANDLE)
+	{
+		// transition the image to copy the transfer buffer to
+		// the image and generate mip levels if needed
+		vkk_util_imageMemoryBarrier(image, cb,
+		                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		                            0, image->mip_levels);
+
+		// copy the transfer buffer to the image
+		vkk_xferManager_copyImage(cb, image, levels,
+		                          src_buffer, src_offset);
+	}
+	else
+	{
+		// the transfer queue transitions the image from the
+		// undefined layout since the contents are replaced
+		// and therefore the previous contents do not require
+		// an ownership transfer to the transfer queue
+		VkImageMemoryBarrier imb =
+		{
+			.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.pNext               = NULL,
+			.srcAccessMask       = 0,
+			.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image               = image->image,
+			.subresourceRange    =
+			{
+				.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel   = 0,
+				.levelCount     = image->mip_levels,
+				.baseArrayLayer = 0,
+				.layerCount     = 1
+			}
+		};
+
+		vkCmdPipelineBarrier(tcb,
+		                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                     0, 0, NULL, 0, NULL, 1, &imb);
+
+		vkk_xferManager_copyImage(tcb, image, levels,
+		                          src_buffer, src_offset);
+
+		// release the image to the graphics queue family
+		imb.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imb.dstAccessMask       = 0;
+		imb.oldLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imb.srcQueueFamilyIndex = engine->transfer_family_index;
+		imb.dstQueueFamilyIndex = engine->queue_family_index;
+		vkCmdPipelineBarrier(tcb,
+		                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		                     0, 0, NULL, 0, NULL, 1, &imb);
+
+		// acquire the image on the graphics queue family
+		imb.srcAccessMask = 0;
+		imb.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT |
+		                    VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cb,
+		                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                     0, 0, NULL, 0, NULL, 1, &imb);
+
+		int i;
+		for(i = 0; i < image->mip_levels; ++i)
+		{
+			image->layout_array[i] = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		}
+	}
+
+	// at this point we may need to generate mip_levels if
+	// mipmapping was enabled
+	if(image->mip_levels > levels)
+	{
+		vkk_engine_mipmapImage(engine, image, cb);
+	}
+
+	// transition the image from transfer mode to shading mode
+	vkk_util_imageMemoryBarrier(image, cb,
+	                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	                            0, image->mip_levels);
+}
+
+static void
+vkk_xferManager_recordRegion(vkk_xferManager_t* self,
+                             VkCommandBuffer cb,
+                             vkk_image_t* image,
+                             uint32_t level,
+                             uint32_t x, uint32_t y,
+                             uint32_t w, uint32_t h,
+                             VkBuffer src_buffer,
+                             VkDeviceSize src_offset)
+{
+	ASSERT(self);
+	ASSERT(image);
+
+	vkk_engine_t* engine = self->engine;
+
+	// the region spans the depth of the mip level
+	uint32_t d = image->depth >> level;
+	d = (d == 0) ? 1 : d;
+
+	VkBufferImageCopy bic =
+	{
+		.bufferOffset      = src_offset,
+		.bufferRowLength   = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource  =
+		{
+			.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel       = level,
+			.baseArrayLayer = 0,
+			.layerCount     = 1
+		},
+		.imageOffset =
+		{
+			.x = (int32_t) x,
+			.y = (int32_t) y,
+			.z = 0,
+		},
+		.imageExtent =
+		{
+			.width  = w,
+			.height = h,
+			.depth  = d
+		}
+	};
+
+	// the region must preserve the existing contents so the
+	// image is transitioned from the current layout on the
+	// graphics queue (rather than from the undefined layout
+	// on the transfer queue)
+	vkk_util_imageMemoryBarrier(image, cb,
+	                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                            level, 1);
+
+	vkCmdCopyBufferToImage(cb, src_buffer, image->image,
+	                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                       1, &bic);
+
+	// regenerate the affected region of the sub mip levels
+	// except for compressed images whose sub mip levels are
+	// written by the app
+	uint32_t count = 1;
+	if(vkk_util_imageCompressed(image->format) == 0)
+	{
+		vkk_engine_mipmapRegion(engine, image, cb, level,
+		                        x, y, w, h);
+		count = image->mip_levels - level;
+	}
+
+	// transition the updated mip levels from transfer mode
+	// to shading mode
+	vkk_util_imageMemoryBarrier(image, cb,
+	                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	                            level, count);
+}
+
+static void
+vkk_xferManager_recordRead(VkCommandBuffer cb,
+                           vkk_image_t* image,
+                           vkk_xferBuffer_t* xb)
+{
+	ASSERT(image);
+	ASSERT(xb);
+
+	// transition the image to copy the image to the
+	// transfer buffer
+	vkk_util_imageMemoryBarrier(image, cb,
+	                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	                            0, image->mip_levels);
+
+	// copy the image to the transfer buffer
+	VkBufferImageCopy bic =
+	{
+		.bufferOffset      = 0,
+		.bufferRowLength   = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource  =
+		{
+			.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel       = 0,
+			.baseArrayLayer = 0,
+			.layerCount     = 1
+		},
+		.imageOffset =
+		{
+			.x = 0,
+			.y = 0,
+			.z = 0,
+		},
+		.imageExtent =
+		{
+			.width  = image->width,
+			.height = image->height,
+			.depth  = image->depth
+		}
+	};
+
+	vkCmdCopyImageToBuffer(cb, image->image,
+	                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	                       xb->buffer, 1, &bic);
+
+	// make the copy visible to the host
+	VkMemoryBarrier mb =
+	{
+		.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext         = NULL,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT
+	};
+
+	vkCmdPipelineBarrier(cb,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     VK_PIPELINE_STAGE_HOST_BIT,
+	                     0, 1, &mb, 0, NULL, 0, NULL);
+
+	// transition the image from transfer mode to shading mode
+	vkk_util_imageMemoryBarrier(image, cb,
+	                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	                            0, image->mip_levels);
+}
+
+static void
+vkk_xferManager_barrier(VkCommandBuffer cb)
+{
+	// order the transfers which access the same resource
+	// within a batch or from a prior submission
+	VkMemoryBarrier mb =
+	{
+		.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext         = NULL,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT |
+		                 VK_ACCESS_TRANSFER_WRITE_BIT
+	};
+
+	vkCmdPipelineBarrier(cb,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     0, 1, &mb, 0, NULL, 0, NULL);
+}
+
+static vkk_xferInstance_t*
+vkk_xferManager_batchBegin(vkk_xferManager_t* self)
+{
+	ASSERT(self);
+
+	// xfer manager must be locked
+
+	vkk_engine_t* engine = self->engine;
+
+	if(self->batch_xi)
+	{
+		return self->batch_xi;
+	}
+
+	vkk_xferInstance_t* xi;
+	cc_listIter_t* iter = cc_list_head(self->instance_list);
+	if(iter)
+	{
+		xi = (vkk_xferInstance_t*)
+		     cc_list_remove(self->instance_list, &iter);
+	}
+	else
+	{
+		xi = vkk_xferInstance_new(engine);
+		if(xi == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	VkCommandBuffer cb;
+	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
+
+	vkResetFences(engine->device, 1, &xi->fence);
+	if(vkResetCommandBuffer(cb, 0) != VK_SUCCESS)
+	{
+		LOGE("vkResetCommandBuffer failed");
+		goto fail_cb;
+	}
+
+	// begin the transfer commands
+	VkCommandBufferInheritanceInfo cbi_info =
+	{
+		.sType                = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext                = NULL,
+		.renderPass           = VK_NULL_HANDLE,
+		.subpass              = 0,
+		.framebuffer          = VK_NULL_HANDLE,
+		.occlusionQueryEnable = VK_FALSE,
+		.queryFlags           = 0,
+		.pipelineStatistics   = 0
+	};
+
+	VkCommandBufferBeginInfo cb_info =
+	{
+		.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext            = NULL,
+		.flags            = 0,
+		.pInheritanceInfo = &cbi_info
+	};
+
+	if(vkBeginCommandBuffer(cb, &cb_info) != VK_SUCCESS)
+	{
+		LOGE("vkBeginCommandBuffer failed");
+		goto fail_begin_cb;
+	}
+
+	// the batch ticket is reserved when the first upload is
+	// recorded and the resources are tagged with the ticket
+	self->batch_xi     = xi;
+	self->batch_ticket = self->ticket_next++;
+
+	// success
+	return xi;
+
+	// failure
+	fail_begin_cb:
+	fail_cb:
+		vkk_xferInstance_delete(&xi);
+	return NULL;
+}
+
+static void
+vkk_xferManager_batchSubmit(vkk_xferManager_t* self)
+{
+	ASSERT(self);
+
+	// xfer manager must be locked
+	// the batch is submitted while locked such that waiters
+	// never observe a batch ticket which is neither recorded
+	// nor pending
+
+	vkk_xferInstance_t* xi = self->batch_xi;
+	if(xi == NULL)
+	{
+		return;
+	}
+	self->batch_xi = NULL;
+
+	VkCommandBuffer cb;
+	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
+
+	// end the transfer commands
+	vkEndCommandBuffer(cb);
+
+	// submit the commands
+	if(vkk_xferManager_submit(self, xi) == 0)
+	{
+		// the batch ticket is treated as complete
+		vkk_xferInstance_delete(&xi);
+		return;
+	}
+
+	xi->ticket = self->batch_ticket;
+	if(cc_list_append(self->pending_list, NULL,
+	                  (const void*) xi) == NULL)
+	{
+		vkk_xferManager_waitFence(self, xi);
+		vkk_xferManager_recycle(self, xi);
+	}
+}
+
+static vkk_xferInstance_t*
+vkk_xferManager_batchStage(vkk_xferManager_t* self,
+                           size_t size, size_t align,
+                           int f16, const void* data,
+                           VkBuffer* _buffer,
+                           VkDeviceSize* _offset)
+{
+	ASSERT(self);
+	ASSERT(data);
+	ASSERT(_buffer);
+	ASSERT(_offset);
+
+	// xfer manager must be locked
+
+	vkk_engine_t* engine = self->engine;
+
+	// submit the batch when the staging ring is full
+	vkk_xferInstance_t* xi = self->batch_xi;
+	if(xi && (vkk_xferInstance_fits(xi, size, align) == 0))
+	{
+		vkk_xferManager_batchSubmit(self);
+	}
+
+	xi = vkk_xferManager_batchBegin(self);
+	if(xi == NULL)
+	{
+		return NULL;
+	}
+
+	if(vkk_xferInstance_stage(xi, engine, size, align, f16,
+	                          data, _buffer, _offset) == 0)
+	{
+		return NULL;
+	}
+
+	return xi;
+}
+
+static int
+vkk_xferManager_batchFill(vkk_xferManager_t* self,
+                          vkk_buffer_t* buffer,
+                          size_t offset,
+                          size_t size,
+                          uint32_t data,
+                          uint64_t* _ticket)
+{
+	// _ticket may be NULL
+	ASSERT(self);
+	ASSERT(buffer);
+
+	// xfer manager must be locked
+
+	vkk_xferInstance_t* xi;
+	xi = vkk_xferManager_batchBegin(self);
+	if(xi == NULL)
+	{
+		return 0;
+	}
+
+	VkCommandBuffer cb;
+	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
+
+	if(buffer->xfer_ticket)
+	{
+		vkk_xferManager_barrier(cb);
+	}
+
+	vkCmdFillBuffer(cb, buffer->buffer[0],
+	                offset, size, data);
+
+	buffer->xfer_ticket = self->batch_ticket;
+	if(_ticket)
+	{
+		*_ticket = self->batch_ticket;
+	}
+
+	return 1;
+}
+
+static int
+vkk_xferManager_batchBlit(vkk_xferManager_t* self,
+                          vkk_buffer_t* buffer,
+                          size_t offset,
+                          size_t size,
+                          const void* data,
+                          uint64_t* _ticket)
+{
+	// _ticket may be NULL
+	ASSERT(self);
+	ASSERT(buffer);
+	ASSERT(data);
+
+	// xfer manager must be locked
+
+	VkBuffer     src_buffer;
+	VkDeviceSize src_offset;
+	vkk_xferInstance_t* xi;
+	xi = vkk_xferManager_batchStage(self, size,
+	                                VKK_XFER_RING_ALIGN, 0, data,
+	                                &src_buffer, &src_offset);
+	if(xi == NULL)
+	{
+		return 0;
+	}
+
+	VkCommandBuffer cb;
+	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
+
+	if(buffer->xfer_ticket)
+	{
+		vkk_xferManager_barrier(cb);
+	}
+
+	VkBufferCopy bc =
+	{
+		.srcOffset = src_offset,
+		.dstOffset = offset,
+		.size      = size,
+	};
+
+	vkCmdCopyBuffer(cb, src_buffer,
+	                buffer->buffer[0], 1, &bc);
+
+	buffer->xfer_ticket = self->batch_ticket;
+	if(_ticket)
+	{
+		*_ticket = self->batch_ticket;
+	}
+
+	return 1;
+}
+
+static int
+vkk_xferManager_batchImage(vkk_xferManager_t* self,
+                           vkk_image_t* image,
+                           const void* pixels,
+                           uint64_t* _ticket)
+{
+	// _ticket may be NULL
+	ASSERT(self);
+	ASSERT(image);
+	ASSERT(pixels);
+
+	// xfer manager must be locked
+
+	uint32_t levels = vkk_xferManager_imageLevels(image);
+
+	size_t size;
+	size_t align;
+	int    f16;
+	size = vkk_xferManager_imageStaging(image, image->width,
+	                                    image->height,
+	                                    image->depth, levels,
+	                                    &align, &f16);
+
+	VkBuffer     src_buffer;
+	VkDeviceSize src_offset;
+	vkk_xferInstance_t* xi;
+	xi = vkk_xferManager_batchStage(self, size, align, f16,
+	                                pixels, &src_buffer,
+	                                &src_offset);
+	if(xi == NULL)
+	{
+		return 0;
+	}
+
+	// the image layout barriers also order the transfers
+	// but an image which is written more than once in the
+	// batch is copied on the graphics queue since it was
+	// already released by the transfer queue
+	VkCommandBuffer tcb = VK_NULL_HANDLE;
+	VkCommandBuffer cb;
+	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
+	if(image->xfer_ticket != self->batch_ticket)
+	{
+		tcb = vkk_xferInstance_beginTransfer(xi);
+	}
+	vkk_xferManager_recordImage(self, tcb, cb, image,
+	                            src_buffer, src_offset);
+
+	image->xfer_ticket = self->batch_ticket;
+	if(_ticket)
+	{
+		*_ticket = self->batch_ticket;
+	}
+
+	return 1;
+}
+
+static int
+vkk_xferManager_batchRegion(vkk_xferManager_t* self,
+                            vkk_image_t* image,
+                            uint32_t level,
+                            uint32_t x, uint32_t y,
+                            uint32_t w, uint32_t h,
+                            const void* pixels)
+{
+	ASSERT(self);
+	ASSERT(image);
+	ASSERT(pixels);
+
+	// xfer manager must be locked
+
+	uint32_t d = image->depth >> level;
+	d = (d == 0) ? 1 : d;
+
+	size_t size;
+	size_t align;
+	int    f16;
+	size = vkk_xferManager_imageStaging(image, w, h, d, 1,
+	                                    &align, &f16);
+
+	VkBuffer     src_buffer;
+	VkDeviceSize src_offset;
+	vkk_xferInstance_t* xi;
+	xi = vkk_xferManager_batchStage(self, size, align, f16,
+	                                pixels, &src_buffer,
+	                                &src_offset);
+	if(xi == NULL)
+	{
+		return 0;
+	}
+
+	// the region is always copied on the graphics queue and
+	// the batch ticket ensures that a subsequent write of
+	// the image in the batch is also ordered after it
+	VkCommandBuffer cb;
+	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
+	vkk_xferManager_recordRegion(self, cb, image, level,
+	                             x, y, w, h,
+	                             src_buffer, src_offset);
+
+	image->xfer_ticket = self->batch_ticket;
+
+	return 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+vkk_xferManager_t*
+vkk_xferManager_new(vkk_engine_t* engine)
+{
+	ASSERT(engine);
+
+	ASSERT(vkk_xferManager_checkSizeClass());
+
+	vkk_xferManager_t* self;
+	self = (vkk_xferManager_t*)
+	       CALLOC(1, sizeof(vkk_xferManager_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	self->engine = engine;
+
+	self->instance_list = cc_list_new();
+	if(self->instance_list == NULL)
+	{
+		goto fail_instance_list;
+	}
+
+	self->pending_list = cc_list_new();
+	if(self->pending_list == NULL)
+	{
+		goto fail_pending_list;
+	}
+
+	// ticket 0 is reserved for completed xfers
+	self->ticket_next = 1;
+
+	self->readback_list = cc_list_new();
+	if(self->readback_list == NULL)
+	{
+		goto fail_readback_list;
+	}
+	self->readback_cap = VKK_XFER_READBACK_CAP;
+
+	self->frame_list = cc_list_new();
+	if(self->frame_list == NULL)
+	{
+		goto fail_frame_list;
+	}
+
+	if(pthread_mutex_init(&self->mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_mutex;
+	}
+
+	// success
+	return self;
+
+	// failure
+	fail_mutex:
+		cc_list_delete(&self->frame_list);
+	fail_frame_list:
+		cc_list_delete(&self->readback_list);
+	fail_readback_list:
+		cc_list_delete(&self->pending_list);
+	fail_pending_list:
+		cc_list_delete(&self->instance_list);
+	fail_instance_list:
+		FREE(self);
+	return NULL;
+}
+
+void vkk_xferManager_delete(vkk_xferManager_t** _self)
+{
+	ASSERT(_self);
+
+	vkk_xferManager_t* self = *_self;
+	if(self)
+	{
+		// discard the unsubmitted batch
+		vkk_xferInstance_delete(&self->batch_xi);
+
+		// discard the unrecorded readbacks
+		cc_listIter_t* iter = cc_list_head(self->frame_list);
+		while(iter)
+		{
+			vkk_readback_t* readback;
+			readback = (vkk_readback_t*)
+			           cc_list_remove(self->frame_list, &iter);
+			readback->image = NULL;
+			readback->iter  = NULL;
+		}
+
+		// wait for the pending async xfers
+		iter = cc_list_head(self->pending_list);
+		while(iter)
+		{
+			vkk_xferInstance_t* xi;
+			xi = (vkk_xferInstance_t*)
+			     cc_list_remove(self->pending_list, &iter);
+			vkk_xferManager_waitFence(self, xi);
+			vkk_xferManager_recycle(self, xi);
+		}
+
+		iter = cc_list_head(self->instance_list);
+		while(iter)
 		{
 			vkk_xferInstance_t* xi;
 			xi = (vkk_xferInstance_t*)
@@ -500,45 +1693,270 @@ void vkk_xferManager_delete(vkk_xferManager_t** _self)
 			vkk_xferInstance_delete(&xi);
 		}
 
-		cc_multimapIter_t  miterator;
-		cc_multimapIter_t* miter;
-		miter = cc_multimap_head(self->buffer_map, &miterator);
-		while(miter)
-		{
-			vkk_xferBuffer_t* xb;
-			xb = (vkk_xferBuffer_t*)
-			     cc_multimap_remove(self->buffer_map, &miter);
-			vkk_xferBuffer_delete(&xb);
-		}
+		vkk_xferManager_readbackTrim(self, 0);
+
+		pthread_mutex_destroy(&self->mutex);
+		cc_list_delete(&self->frame_list);
+		cc_list_delete(&self->readback_list);
+		cc_list_delete(&self->pending_list);
+		cc_list_delete(&self->instance_list);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+void vkk_xferManager_shutdown(vkk_xferManager_t* self)
+{
+	ASSERT(self);
+
+	vkk_xferManager_lock(self);
+	self->shutdown = 1;
+	vkk_xferManager_unlock(self);
+}
+
+void vkk_xferManager_readbackCap(vkk_xferManager_t* self,
+                                 size_t cap)
+{
+	ASSERT(self);
+
+	vkk_xferManager_lock(self);
+	self->readback_cap = cap;
+	vkk_xferManager_readbackTrim(self, cap);
+	vkk_xferManager_unlock(self);
+}
+
+void vkk_xferManager_trim(vkk_xferManager_t* self)
+{
+	ASSERT(self);
+
+	vkk_xferManager_lock(self);
+	vkk_xferManager_readbackTrim(self, 0);
+
+	// release the rings of the idle instances which are
+	// recreated on demand
+	cc_listIter_t* iter = cc_list_head(self->instance_list);
+	while(iter)
+	{
+		vkk_xferInstance_t* xi;
+		xi = (vkk_xferInstance_t*) cc_list_peekIter(iter);
+		vkk_xferBuffer_delete(&xi->ring);
+		iter = cc_list_next(iter);
+	}
+	vkk_xferManager_unlock(self);
+}
+
+void vkk_xferManager_memoryInfo(vkk_xferManager_t* self,
+                                vkk_memoryType_e type,
+                                vkk_memoryInfo_t* info)
+{
+	ASSERT(self);
+	ASSERT(info);
+
+	info->count_xfer = 0;
+	info->size_xfer  = 0;
+
+	vkk_xferManager_lock(self);
+	cc_listIter_t* iter = cc_list_head(self->readback_list);
+	while(iter)
+	{
+		vkk_xferBuffer_t* xb;
+		xb = (vkk_xferBuffer_t*) cc_list_peekIter(iter);
+		if((type == VKK_MEMORY_TYPE_ANY) ||
+		   (type == xb->memory->chunk->type))
+		{
+			++info->count_xfer;
+			info->size_xfer += xb->size;
+		}
+
+		iter = cc_list_next(iter);
+	}
+
+	// the staging rings of the idle and pending instances
+	cc_list_t* lists[] =
+	{
+		self->instance_list,
+		self->pending_list,
+	};
+
+	int i;
+	for(i = 0; i < 2; ++i)
+	{
+		iter = cc_list_head(lists[i]);
+		while(iter)
+		{
+			vkk_xferInstance_t* xi;
+			xi = (vkk_xferInstance_t*) cc_list_peekIter(iter);
+			if(xi->ring &&
+			   ((type == VKK_MEMORY_TYPE_ANY) ||
+			    (type == xi->ring->memory->chunk->type)))
+			{
+				++info->count_xfer;
+				info->size_xfer += xi->ring->size;
+			}
+
+			iter = cc_list_next(iter);
+		}
+	}
+	vkk_xferManager_unlock(self);
+}
+
+int vkk_xferManager_fillStorage(vkk_xferManager_t* self,
+                                vkk_buffer_t* buffer,
+                                size_t offset,
+                                size_t size,
+                                uint32_t data,
+                                uint64_t* _ticket)
+{
+	// _ticket may be NULL
+	ASSERT(self);
+	ASSERT(buffer);
+
+	vkk_engine_t* engine = self->engine;
+
+	// uploads are recorded into the batch when enabled
+	vkk_xferManager_lock(self);
+	if(self->batch_depth && (self->shutdown == 0))
+	{
+		int ret;
+		ret = vkk_xferManager_batchFill(self, buffer, offset,
+		                                size, data, _ticket);
+		vkk_xferManager_unlock(self);
+		return ret;
+	}
+	vkk_xferManager_unlock(self);
+
+	vkk_xferManager_waitTicket(self, &buffer->xfer_ticket);
+
+	vkk_xferManager_lock(self);
+	if(self->shutdown)
+	{
+		vkk_xferManager_unlock(self);
+		return 0;
+	}
+
+	vkk_xferInstance_t* xi;
+	cc_listIter_t* iter = cc_list_head(self->instance_list);
+	if(iter)
+	{
+		xi = (vkk_xferInstance_t*)
+		     cc_list_remove(self->instance_list, &iter);
+	}
+	else
+	{
+		xi = vkk_xferInstance_new(engine);
+		if(xi == NULL)
+		{
+			vkk_xferManager_unlock(self);
+			return 0;
+		}
+	}
+	vkk_xferManager_unlock(self);
+
+	VkCommandBuffer cb;
+	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
+
+	vkResetFences(engine->device, 1, &xi->fence);
+	if(vkResetCommandBuffer(cb, 0) != VK_SUCCESS)
+	{
+		LOGE("vkResetCommandBuffer failed");
+		goto fail_cb;
+	}
+
+	// begin the transfer commands
+	VkCommandBufferInheritanceInfo cbi_info =
+	{
+		.sType                = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext                = NULL,
+		.renderPass           = VK_NULL_HANDLE,
+		.subpass              = 0,
+		.framebuffer          = VK_NULL_HANDLE,
+		.occlusionQueryEnable = VK_FALSE,
+		.queryFlags           = 0,
+		.pipelineStatistics   = 0
+	};
+
+	VkCommandBufferBeginInfo cb_info =
+	{
+		.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext            = NULL,
+		.flags            = 0,
+		.pInheritanceInfo = &cbi_info
+	};
+
+	if(vkBeginCommandBuffer(cb, &cb_info) != VK_SUCCESS)
+	{
+		LOGE("vkBeginCommandBuffer failed");
+		goto fail_begin_cb;
+	}
 
-		pthread_mutex_destroy(&self->mutex);
-		cc_multimap_delete(&self->buffer_map);
-		cc_list_delete(&self->instance_list);
-		FREE(self);
-		*_self = NULL;
+	int idx = 0;
+
+	vkCmdFillBuffer(cb, buffer->buffer[idx],
+	                offset, size, data);
+
+	// end the transfer commands
+	vkEndCommandBuffer(cb);
+
+	// submit the commands
+	if(vkk_engine_queueSubmit(engine, VKK_QUEUE_BACKGROUND, &cb,
+	                          0, NULL, NULL, NULL,
+	                          xi->fence) == 0)
+	{
+		goto fail_submit;
 	}
-}
 
-void vkk_xferManager_shutdown(vkk_xferManager_t* self)
-{
-	ASSERT(self);
+	vkk_xferManager_finish(self, xi, NULL, _ticket);
+	if(_ticket)
+	{
+		buffer->xfer_ticket = *_ticket;
+	}
 
-	vkk_xferManager_lock(self);
-	self->shutdown = 1;
-	vkk_xferManager_unlock(self);
+	// success
+	return 1;
+
+	// failure
+	fail_submit:
+	fail_begin_cb:
+	fail_cb:
+		vkk_xferInstance_delete(&xi);
+	return 0;
 }
 
-int vkk_xferManager_fillStorage(vkk_xferManager_t* self,
+int vkk_xferManager_blitStorage(vkk_xferManager_t* self,
+                                vkk_xferMode_e mode,
                                 vkk_buffer_t* buffer,
                                 size_t offset,
                                 size_t size,
-                                uint32_t data)
+                                void* data,
+                                uint64_t* _ticket)
 {
+	// _ticket may be NULL
 	ASSERT(self);
 	ASSERT(buffer);
+	ASSERT((size + offset) <= vkk_buffer_size(buffer));
+	ASSERT(data);
+
+	// async reads are not supported since the data must be
+	// copied from the xfer buffer once the fence signals
+	ASSERT((mode == VKK_XFER_MODE_WRITE) || (_ticket == NULL));
 
 	vkk_engine_t* engine = self->engine;
 
+	// uploads are recorded into the batch when enabled
+	vkk_xferManager_lock(self);
+	if(self->batch_depth && (self->shutdown == 0) &&
+	   (mode == VKK_XFER_MODE_WRITE))
+	{
+		int ret;
+		ret = vkk_xferManager_batchBlit(self, buffer, offset,
+		                                size, data, _ticket);
+		vkk_xferManager_unlock(self);
+		return ret;
+	}
+	vkk_xferManager_unlock(self);
+
+	vkk_xferManager_waitTicket(self, &buffer->xfer_ticket);
+
 	vkk_xferManager_lock(self);
 	if(self->shutdown)
 	{
@@ -546,6 +1964,20 @@ int vkk_xferManager_fillStorage(vkk_xferManager_t* self,
 		return 0;
 	}
 
+	// readback buffers are cached by size class since they
+	// prefer host cached memory while uploads are staged
+	// in the xfer instance ring
+	vkk_xferBuffer_t* xb = NULL;
+	if(mode == VKK_XFER_MODE_READ)
+	{
+		xb = vkk_xferManager_readbackGet(self, size);
+		if(xb == NULL)
+		{
+			vkk_xferManager_unlock(self);
+			return 0;
+		}
+	}
+
 	vkk_xferInstance_t* xi;
 	cc_listIter_t* iter = cc_list_head(self->instance_list);
 	if(iter)
@@ -559,7 +1991,7 @@ int vkk_xferManager_fillStorage(vkk_xferManager_t* self,
 		if(xi == NULL)
 		{
 			vkk_xferManager_unlock(self);
-			return 0;
+			goto fail_xi;
 		}
 	}
 	vkk_xferManager_unlock(self);
@@ -602,9 +2034,40 @@ int vkk_xferManager_fillStorage(vkk_xferManager_t* self,
 	}
 
 	int idx = 0;
+	if(mode == VKK_XFER_MODE_WRITE)
+	{
+		VkBuffer     src_buffer;
+		VkDeviceSize src_offset;
+		if(vkk_xferInstance_stage(xi, engine, size,
+		                          VKK_XFER_RING_ALIGN, 0, data,
+		                          &src_buffer,
+		                          &src_offset) == 0)
+		{
+			goto fail_stage;
+		}
 
-	vkCmdFillBuffer(cb, buffer->buffer[idx],
-	                offset, size, data);
+		VkBufferCopy bc =
+		{
+			.srcOffset = src_offset,
+			.dstOffset = offset,
+			.size      = size,
+		};
+
+		vkCmdCopyBuffer(cb, src_buffer,
+		                buffer->buffer[idx], 1, &bc);
+	}
+	else
+	{
+		VkBufferCopy bc =
+		{
+			.srcOffset = offset,
+			.dstOffset = 0,
+			.size      = size,
+		};
+
+		vkCmdCopyBuffer(cb, buffer->buffer[idx],
+		                xb->buffer, 1, &bc);
+	}
 
 	// end the transfer commands
 	vkEndCommandBuffer(cb);
@@ -617,47 +2080,50 @@ int vkk_xferManager_fillStorage(vkk_xferManager_t* self,
 		goto fail_submit;
 	}
 
-	uint64_t timeout = UINT64_MAX;
-	if(vkWaitForFences(engine->device, 1, &xi->fence, VK_TRUE,
-	                   timeout) != VK_SUCCESS)
+	if(mode == VKK_XFER_MODE_READ)
 	{
-		LOGW("vkWaitForFences failed");
-		vkk_engine_queueWaitIdle(engine, VKK_QUEUE_BACKGROUND);
+		vkk_xferManager_waitFence(self, xi);
+		vkk_memoryManager_invalidate(engine->mm, xb->memory);
+		vkk_memoryManager_read(engine->mm, xb->memory,
+		                       0, size, data);
 	}
 
-	vkk_xferManager_lock(self);
-	if(cc_list_append(self->instance_list, NULL,
-	                  (const void*) xi) == NULL)
+	vkk_xferManager_finish(self, xi, xb, _ticket);
+	if(_ticket)
 	{
-		vkk_xferInstance_delete(&xi);
+		buffer->xfer_ticket = *_ticket;
 	}
-	vkk_xferManager_unlock(self);
 
 	// success
 	return 1;
 
 	// failure
 	fail_submit:
+	fail_stage:
 	fail_begin_cb:
 	fail_cb:
 		vkk_xferInstance_delete(&xi);
+	fail_xi:
+		vkk_xferBuffer_delete(&xb);
 	return 0;
 }
 
-int vkk_xferManager_blitStorage(vkk_xferManager_t* self,
-                                vkk_xferMode_e mode,
-                                vkk_buffer_t* buffer,
-                                size_t offset,
-                                size_t size,
-                                void* data)
+int vkk_xferManager_blitStorage2(vkk_xferManager_t* self,
+                                 vkk_buffer_t* src_buffer,
+                                 vkk_buffer_t* dst_buffer,
+                                 size_t src_offset,
+                                 size_t dst_offset,
+                                 size_t size)
 {
 	ASSERT(self);
-	ASSERT(buffer);
-	ASSERT((size + offset) <= vkk_buffer_size(buffer));
-	ASSERT(data);
+	ASSERT(src_buffer);
+	ASSERT(dst_buffer);
 
 	vkk_engine_t* engine = self->engine;
 
+	vkk_xferManager_waitTicket(self, &src_buffer->xfer_ticket);
+	vkk_xferManager_waitTicket(self, &dst_buffer->xfer_ticket);
+
 	vkk_xferManager_lock(self);
 	if(self->shutdown)
 	{
@@ -665,38 +2131,6 @@ int vkk_xferManager_blitStorage(vkk_xferManager_t* self,
 		return 0;
 	}
 
-	vkk_xferBuffer_t*  xb;
-	cc_multimapIter_t  miterator;
-	cc_multimapIter_t* miter = &miterator;
-	if(cc_multimap_findp(self->buffer_map, miter,
-	                     sizeof(size_t), &size))
-	{
-		xb = (vkk_xferBuffer_t*)
-		     cc_multimap_remove(self->buffer_map, &miter);
-		if(mode == VKK_XFER_MODE_WRITE)
-		{
-			vkk_memoryManager_write(engine->mm, xb->memory,
-			                        0, size, data);
-		}
-	}
-	else
-	{
-		if(mode == VKK_XFER_MODE_WRITE)
-		{
-			xb = vkk_xferBuffer_new(engine, size, data);
-		}
-		else
-		{
-			xb = vkk_xferBuffer_new(engine, size, NULL);
-		}
-
-		if(xb == NULL)
-		{
-			vkk_xferManager_unlock(self);
-			return 0;
-		}
-	}
-
 	vkk_xferInstance_t* xi;
 	cc_listIter_t* iter = cc_list_head(self->instance_list);
 	if(iter)
@@ -710,7 +2144,7 @@ int vkk_xferManager_blitStorage(vkk_xferManager_t* self,
 		if(xi == NULL)
 		{
 			vkk_xferManager_unlock(self);
-			goto fail_xi;
+			return 0;
 		}
 	}
 	vkk_xferManager_unlock(self);
@@ -753,31 +2187,131 @@ int vkk_xferManager_blitStorage(vkk_xferManager_t* self,
 	}
 
 	int idx = 0;
-	if(mode == VKK_XFER_MODE_WRITE)
+
+	VkBufferCopy bc =
 	{
-		VkBufferCopy bc =
+		.srcOffset = src_offset,
+		.dstOffset = dst_offset,
+		.size      = size,
+	};
+
+	vkCmdCopyBuffer(cb, src_buffer->buffer[idx],
+	                dst_buffer->buffer[idx], 1, &bc);
+
+	// end the transfer commands
+	vkEndCommandBuffer(cb);
+
+	// submit the commands
+	if(vkk_engine_queueSubmit(engine, VKK_QUEUE_BACKGROUND, &cb,
+	                          0, NULL, NULL, NULL,
+	                          xi->fence) == 0)
+	{
+		goto fail_submit;
+	}
+
+	vkk_xferManager_finish(self, xi, NULL, NULL);
+
+	// success
+	return 1;
+
+	// failure
+	fail_submit:
+	fail_begin_cb:
+	fail_cb:
+		vkk_xferInstance_delete(&xi);
+	return 0;
+}
+
+int vkk_xferManager_readImage(vkk_xferManager_t* self,
+                              vkk_image_t* image,
+                              void* pixels)
+{
+	ASSERT(self);
+	ASSERT(image);
+	ASSERT(pixels);
+
+	vkk_engine_t* engine = self->engine;
+
+	vkk_xferManager_waitTicket(self, &image->xfer_ticket);
+
+	vkk_xferManager_lock(self);
+	if(self->shutdown)
+	{
+		vkk_xferManager_unlock(self);
+		return 0;
+	}
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;
+	size_t   size;
+	size = vkk_image_size(image, &width, &height, &depth);
+
+	vkk_xferBuffer_t* xb;
+	xb = vkk_xferManager_readbackGet(self, size);
+	if(xb == NULL)
+	{
+		vkk_xferManager_unlock(self);
+		return 0;
+	}
+
+	vkk_xferInstance_t* xi;
+	cc_listIter_t* iter = cc_list_head(self->instance_list);
+	if(iter)
+	{
+		xi = (vkk_xferInstance_t*)
+		     cc_list_remove(self->instance_list, &iter);
+	}
+	else
+	{
+		xi = vkk_xferInstance_new(engine);
+		if(xi == NULL)
 		{
-			.srcOffset = 0,
-			.dstOffset = offset,
-			.size      = size,
-		};
+			vkk_xferManager_unlock(self);
+			goto fail_xi;
+		}
+	}
+	vkk_xferManager_unlock(self);
+
+	VkCommandBuffer cb;
+	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
+
+	vkResetFences(engine->device, 1, &xi->fence);
+	if(vkResetCommandBuffer(cb, 0) != VK_SUCCESS)
+	{
+		LOGE("vkResetCommandBuffer failed");
+		goto fail_cb;
+	}
+
+	// begin the transfer commands
+	VkCommandBufferInheritanceInfo cbi_info =
+	{
+		.sType                = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext                = NULL,
+		.renderPass           = VK_NULL_HANDLE,
+		.subpass              = 0,
+		.framebuffer          = VK_NULL_HANDLE,
+		.occlusionQueryEnable = VK_FALSE,
+		.queryFlags           = 0,
+		.pipelineStatistics   = 0
+	};
 
-		vkCmdCopyBuffer(cb, xb->buffer,
-		                buffer->buffer[idx], 1, &bc);
-	}
-	else
+	VkCommandBufferBeginInfo cb_info =
 	{
-		VkBufferCopy bc =
-		{
-			.srcOffset = offset,
-			.dstOffset = 0,
-			.size      = size,
-		};
+		.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext            = NULL,
+		.flags            = 0,
+		.pInheritanceInfo = &cbi_info
+	};
 
-		vkCmdCopyBuffer(cb, buffer->buffer[idx],
-		                xb->buffer, 1, &bc);
+	if(vkBeginCommandBuffer(cb, &cb_info) != VK_SUCCESS)
+	{
+		LOGE("vkBeginCommandBuffer failed");
+		goto fail_begin_cb;
 	}
 
+	vkk_xferManager_recordRead(cb, image, xb);
+
 	// end the transfer commands
 	vkEndCommandBuffer(cb);
 
@@ -789,33 +2323,12 @@ int vkk_xferManager_blitStorage(vkk_xferManager_t* self,
 		goto fail_submit;
 	}
 
-	uint64_t timeout = UINT64_MAX;
-	if(vkWaitForFences(engine->device, 1, &xi->fence, VK_TRUE,
-	                   timeout) != VK_SUCCESS)
-	{
-		LOGW("vkWaitForFences failed");
-		vkk_engine_queueWaitIdle(engine, VKK_QUEUE_BACKGROUND);
-	}
-
-	if(mode == VKK_XFER_MODE_READ)
-	{
-		vkk_memoryManager_read(engine->mm, xb->memory,
-		                       0, size, data);
-	}
-
-	vkk_xferManager_lock(self);
-	if(cc_list_append(self->instance_list, NULL,
-	                  (const void*) xi) == NULL)
-	{
-		vkk_xferInstance_delete(&xi);
-	}
+	vkk_xferManager_waitFence(self, xi);
+	vkk_memoryManager_invalidate(engine->mm, xb->memory);
+	vkk_memoryManager_read(engine->mm, xb->memory,
+	                       0, size, pixels);
 
-	if(cc_multimap_addp(self->buffer_map, (const void*) xb,
-	                    sizeof(size_t), &size) == 0)
-	{
-		vkk_xferBuffer_delete(&xb);
-	}
-	vkk_xferManager_unlock(self);
+	vkk_xferManager_finish(self, xi, xb, NULL);
 
 	// success
 	return 1;
@@ -830,18 +2343,20 @@ int vkk_xferManager_blitStorage(vkk_xferManager_t* self,
 	return 0;
 }
 
-int vkk_xferManager_blitStorage2(vkk_xferManager_t* self,
-                                 vkk_buffer_t* src_buffer,
-                                 vkk_buffer_t* dst_buffer,
-                                 size_t src_offset,
-                                 size_t dst_offset,
-                                 size_t size)
+static int
+vkk_xferManager_submitReadback(vkk_xferManager_t* self,
+                               vkk_readback_t* readback)
 {
 	ASSERT(self);
-	ASSERT(src_buffer);
-	ASSERT(dst_buffer);
+	ASSERT(readback);
 
 	vkk_engine_t* engine = self->engine;
+	vkk_image_t*  image  = readback->image;
+
+	// the image may still be in use by the default renderer
+	// or by a pending async xfer
+	vkk_engine_rendererWaitForTimestamp(engine, image->ts);
+	vkk_xferManager_waitTicket(self, &image->xfer_ticket);
 
 	vkk_xferManager_lock(self);
 	if(self->shutdown)
@@ -905,17 +2420,7 @@ int vkk_xferManager_blitStorage2(vkk_xferManager_t* self,
 		goto fail_begin_cb;
 	}
 
-	int idx = 0;
-
-	VkBufferCopy bc =
-	{
-		.srcOffset = src_offset,
-		.dstOffset = dst_offset,
-		.size      = size,
-	};
-
-	vkCmdCopyBuffer(cb, src_buffer->buffer[idx],
-	                dst_buffer->buffer[idx], 1, &bc);
+	vkk_xferManager_recordRead(cb, image, readback->xb);
 
 	// end the transfer commands
 	vkEndCommandBuffer(cb);
@@ -928,75 +2433,453 @@ int vkk_xferManager_blitStorage2(vkk_xferManager_t* self,
 		goto fail_submit;
 	}
 
-	uint64_t timeout = UINT64_MAX;
-	if(vkWaitForFences(engine->device, 1, &xi->fence, VK_TRUE,
-	                   timeout) != VK_SUCCESS)
+	// the readback buffer is held by the readback
+	vkk_xferManager_finish(self, xi, NULL, &readback->ticket);
+
+	// success
+	return 1;
+
+	// failure
+	fail_submit:
+	fail_begin_cb:
+	fail_cb:
+		vkk_xferInstance_delete(&xi);
+	return 0;
+}
+
+static int
+vkk_xferManager_frameReadback(vkk_xferManager_t* self,
+                              vkk_image_t* image)
+{
+	ASSERT(self);
+	ASSERT(image);
+
+	// renderer must be locked
+
+	cc_listIter_t* iter = cc_list_head(self->frame_list);
+	while(iter)
 	{
-		LOGW("vkWaitForFences failed");
-		vkk_engine_queueWaitIdle(engine, VKK_QUEUE_BACKGROUND);
+		vkk_readback_t* readback;
+		readback = (vkk_readback_t*) cc_list_peekIter(iter);
+		if(readback->image == image)
+		{
+			return 1;
+		}
+
+		iter = cc_list_next(iter);
+	}
+
+	return 0;
+}
+
+static void
+vkk_xferManager_discardReadbacks(vkk_xferManager_t* self,
+                                 vkk_image_t* image)
+{
+	ASSERT(self);
+	ASSERT(image);
+
+	// renderer must be locked
+
+	cc_listIter_t* iter = cc_list_head(self->frame_list);
+	while(iter)
+	{
+		vkk_readback_t* readback;
+		readback = (vkk_readback_t*) cc_list_peekIter(iter);
+		if((readback->image == image) &&
+		   (readback->claimed == 0))
+		{
+			cc_list_remove(self->frame_list, &iter);
+			readback->image = NULL;
+			readback->iter  = NULL;
+		}
+		else
+		{
+			iter = cc_list_next(iter);
+		}
+	}
+}
+
+vkk_readback_t*
+vkk_xferManager_readImageAsync(vkk_xferManager_t* self,
+                               vkk_image_t* image)
+{
+	ASSERT(self);
+	ASSERT(image);
+
+	vkk_engine_t* engine = self->engine;
+
+	vkk_readback_t* readback;
+	readback = (vkk_readback_t*)
+	           CALLOC(1, sizeof(vkk_readback_t));
+	if(readback == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
 	}
 
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;
+	readback->size  = vkk_image_size(image, &width, &height,
+	                                 &depth);
+	readback->image = image;
+
 	vkk_xferManager_lock(self);
-	if(cc_list_append(self->instance_list, NULL,
-	                  (const void*) xi) == NULL)
+	if(self->shutdown)
 	{
-		vkk_xferInstance_delete(&xi);
+		vkk_xferManager_unlock(self);
+		goto fail_shutdown;
 	}
+
+	readback->xb = vkk_xferManager_readbackGet(self,
+	                                           readback->size);
 	vkk_xferManager_unlock(self);
+	if(readback->xb == NULL)
+	{
+		goto fail_xb;
+	}
+
+	if(engine->renderer)
+	{
+		// the copy is recorded into the command buffer of
+		// the next frame after the frame has rendered the
+		// image so the readback completes with the frame
+		// rather than stalling the uploads or binds
+		vkk_engine_rendererLock(engine);
+		readback->iter = cc_list_append(self->frame_list, NULL,
+		                                (const void*) readback);
+		vkk_engine_rendererUnlock(engine);
+		if(readback->iter == NULL)
+		{
+			goto fail_append;
+		}
+	}
+	else
+	{
+		// the copy is submitted with its own ticket which
+		// is waited on before the image is written or
+		// destroyed
+		if(vkk_xferManager_submitReadback(self,
+		                                  readback) == 0)
+		{
+			goto fail_submit;
+		}
+
+		readback->image = NULL;
+		if(readback->ticket > image->readback_ticket)
+		{
+			image->readback_ticket = readback->ticket;
+		}
+	}
 
 	// success
-	return 1;
+	return readback;
 
 	// failure
 	fail_submit:
-	fail_begin_cb:
-	fail_cb:
-		vkk_xferInstance_delete(&xi);
-	return 0;
+	fail_append:
+		vkk_xferManager_lock(self);
+		vkk_xferManager_readbackPut(self, readback->xb);
+		vkk_xferManager_unlock(self);
+	fail_xb:
+	fail_shutdown:
+		FREE(readback);
+	return NULL;
+}
+
+int vkk_xferManager_pollReadback(vkk_xferManager_t* self,
+                                 vkk_readback_t* readback)
+{
+	ASSERT(self);
+	ASSERT(readback);
+
+	vkk_engine_t* engine = self->engine;
+
+	if(engine->renderer)
+	{
+		vkk_engine_rendererLock(engine);
+		int pending = (readback->iter != NULL);
+		vkk_engine_rendererUnlock(engine);
+		if(pending)
+		{
+			return 0;
+		}
+	}
+
+	if(readback->ts != 0.0)
+	{
+		return vkk_engine_rendererCheckTimestamp(engine,
+		                                         readback->ts);
+	}
+
+	return vkk_xferManager_poll(self, readback->ticket);
+}
+
+const void*
+vkk_xferManager_mapReadback(vkk_xferManager_t* self,
+                            vkk_readback_t* readback)
+{
+	ASSERT(self);
+	ASSERT(readback);
+
+	vkk_engine_t* engine = self->engine;
+
+	// a readback which is mapped before it was recorded into
+	// a frame is submitted immediately (it remains in the
+	// frame_list while claimed so the image is not destroyed
+	// during the submit) unless the current frame renders
+	// the image since the frame must be submitted first
+	if(engine->renderer)
+	{
+		double ts_current;
+		ts_current = vkk_defaultRenderer_tsCurrent(engine->renderer);
+
+		vkk_engine_rendererLock(engine);
+		vkk_image_t* image = readback->image;
+		if(readback->iter && (image->ts != 0.0) &&
+		   (image->ts >= ts_current))
+		{
+			vkk_engine_rendererUnlock(engine);
+			LOGE("invalid readback of image in current frame");
+			return NULL;
+		}
+
+		int pending = (readback->iter != NULL);
+		if(pending)
+		{
+			readback->claimed = 1;
+		}
+		vkk_engine_rendererUnlock(engine);
+
+		if(pending)
+		{
+			int ret;
+			ret = vkk_xferManager_submitReadback(self, readback);
+			vkk_xferManager_wait(self, readback->ticket);
+
+			vkk_engine_rendererLock(engine);
+			cc_list_remove(self->frame_list, &readback->iter);
+			readback->image   = NULL;
+			readback->iter    = NULL;
+			readback->claimed = 0;
+			vkk_engine_rendererSignal(engine);
+			vkk_engine_rendererUnlock(engine);
+
+			if(ret == 0)
+			{
+				return NULL;
+			}
+		}
+	}
+
+	// the waits only block when the readback was mapped
+	// before the copy completed
+	vkk_engine_rendererWaitForTimestamp(engine, readback->ts);
+	vkk_xferManager_wait(self, readback->ticket);
+
+	vkk_xferBuffer_t* xb = readback->xb;
+	if(readback->invalidated == 0)
+	{
+		vkk_memoryManager_invalidate(engine->mm, xb->memory);
+		readback->invalidated = 1;
+	}
+
+	return vkk_memoryManager_map(engine->mm, xb->memory);
+}
+
+void vkk_xferManager_deleteReadback(vkk_xferManager_t* self,
+                                    vkk_readback_t** _readback)
+{
+	ASSERT(self);
+	ASSERT(_readback);
+
+	vkk_engine_t* engine = self->engine;
+
+	vkk_readback_t* readback = *_readback;
+	if(readback)
+	{
+		// discard an unrecorded readback
+		if(engine->renderer)
+		{
+			vkk_engine_rendererLock(engine);
+			if(readback->iter)
+			{
+				ASSERT(readback->claimed == 0);
+				cc_list_remove(self->frame_list,
+				               &readback->iter);
+				readback->image = NULL;
+				readback->iter  = NULL;
+				vkk_engine_rendererSignal(engine);
+			}
+			vkk_engine_rendererUnlock(engine);
+		}
+
+		// the copy must complete before the readback buffer
+		// is reused
+		vkk_engine_rendererWaitForTimestamp(engine, readback->ts);
+		vkk_xferManager_wait(self, readback->ticket);
+
+		vkk_xferManager_lock(self);
+		vkk_xferManager_readbackPut(self, readback->xb);
+		vkk_xferManager_unlock(self);
+
+		FREE(readback);
+		*_readback = NULL;
+	}
+}
+
+void vkk_xferManager_recordReadbacks(vkk_xferManager_t* self,
+                                     VkCommandBuffer cb,
+                                     double ts)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	// wait for the pending async xfers of the images (the
+	// binds of the frame have typically waited already)
+	while(1)
+	{
+		vkk_image_t* image = NULL;
+
+		vkk_engine_rendererLock(engine);
+		cc_listIter_t* iter = cc_list_head(self->frame_list);
+		while(iter)
+		{
+			vkk_readback_t* readback;
+			readback = (vkk_readback_t*) cc_list_peekIter(iter);
+			if((readback->claimed == 0) &&
+			   readback->image->xfer_ticket)
+			{
+				image = readback->image;
+				break;
+			}
+
+			iter = cc_list_next(iter);
+		}
+		vkk_engine_rendererUnlock(engine);
+
+		if(image == NULL)
+		{
+			break;
+		}
+
+		vkk_xferManager_waitTicket(self, &image->xfer_ticket);
+	}
+
+	// record the copies after the frame has rendered the
+	// images and the copies complete with the frame
+	vkk_engine_rendererLock(engine);
+	int signal = 0;
+	cc_listIter_t* iter = cc_list_head(self->frame_list);
+	while(iter)
+	{
+		vkk_readback_t* readback;
+		readback = (vkk_readback_t*) cc_list_peekIter(iter);
+		if(readback->claimed)
+		{
+			iter = cc_list_next(iter);
+			continue;
+		}
+
+		vkk_image_t* image = readback->image;
+		vkk_xferManager_recordRead(cb, image, readback->xb);
+		image->ts    = ts;
+		readback->ts = ts;
+
+		cc_list_remove(self->frame_list, &iter);
+		readback->image = NULL;
+		readback->iter  = NULL;
+		signal          = 1;
+	}
+
+	if(signal)
+	{
+		vkk_engine_rendererSignal(engine);
+	}
+	vkk_engine_rendererUnlock(engine);
+}
+
+void vkk_xferManager_waitReadbacks(vkk_xferManager_t* self,
+                                   vkk_image_t* image)
+{
+	ASSERT(self);
+	ASSERT(image);
+
+	vkk_engine_t* engine = self->engine;
+
+	// block until the unrecorded readbacks of the image are
+	// recorded (or discarded) since the frame_list holds a
+	// reference to the image
+	if(engine->renderer)
+	{
+		vkk_engine_rendererLock(engine);
+		while(vkk_xferManager_frameReadback(self, image))
+		{
+			// discard the readbacks since frames are no
+			// longer recorded after the shutdown
+			if(engine->shutdown)
+			{
+				vkk_xferManager_discardReadbacks(self, image);
+				break;
+			}
+
+			vkk_engine_rendererWait(engine);
+		}
+		vkk_engine_rendererUnlock(engine);
+	}
+
+	vkk_xferManager_waitTicket(self, &image->readback_ticket);
 }
 
-int vkk_xferManager_readImage(vkk_xferManager_t* self,
-                              vkk_image_t* image,
-                              void* pixels)
+int vkk_xferManager_writeImage(vkk_xferManager_t* self,
+                               vkk_image_t* image,
+                               const void* pixels,
+                               uint64_t* _ticket)
 {
+	// _ticket may be NULL
 	ASSERT(self);
 	ASSERT(image);
 	ASSERT(pixels);
 
 	vkk_engine_t* engine = self->engine;
 
+	// a pending async readback must complete before the
+	// image is written (by the transfer queue)
+	vkk_xferManager_waitTicket(self, &image->readback_ticket);
+
+	// uploads are recorded into the batch when enabled
 	vkk_xferManager_lock(self);
-	if(self->shutdown)
+	if(self->batch_depth && (self->shutdown == 0))
 	{
+		int ret;
+		ret = vkk_xferManager_batchImage(self, image, pixels,
+		                                 _ticket);
 		vkk_xferManager_unlock(self);
-		return 0;
+		return ret;
 	}
+	vkk_xferManager_unlock(self);
 
-	uint32_t width;
-	uint32_t height;
-	uint32_t depth;
-	size_t   size;
-	size = vkk_image_size(image, &width, &height, &depth);
+	vkk_xferManager_waitTicket(self, &image->xfer_ticket);
 
-	vkk_xferBuffer_t*  xb;
-	cc_multimapIter_t  miterator;
-	cc_multimapIter_t* miter = &miterator;
-	if(cc_multimap_findp(self->buffer_map, miter,
-	                     sizeof(size_t), &size))
-	{
-		xb = (vkk_xferBuffer_t*)
-		     cc_multimap_remove(self->buffer_map, &miter);
-	}
-	else
+	vkk_xferManager_lock(self);
+	if(self->shutdown)
 	{
-		xb = vkk_xferBuffer_new(engine, size, NULL);
-		if(xb == NULL)
-		{
-			vkk_xferManager_unlock(self);
-			return 0;
-		}
+		vkk_xferManager_unlock(self);
+		return 0;
 	}
 
+	uint32_t levels = vkk_xferManager_imageLevels(image);
+
+	size_t size;
+	size_t align;
+	int    f16;
+	size = vkk_xferManager_imageStaging(image, image->width,
+	                                    image->height,
+	                                    image->depth, levels,
+	                                    &align, &f16);
+
 	vkk_xferInstance_t* xi;
 	cc_listIter_t* iter = cc_list_head(self->instance_list);
 	if(iter)
@@ -1010,11 +2893,20 @@ int vkk_xferManager_readImage(vkk_xferManager_t* self,
 		if(xi == NULL)
 		{
 			vkk_xferManager_unlock(self);
-			goto fail_xi;
+			return 0;
 		}
 	}
 	vkk_xferManager_unlock(self);
 
+	VkBuffer     src_buffer;
+	VkDeviceSize src_offset;
+	if(vkk_xferInstance_stage(xi, engine, size, align, f16,
+	                          pixels, &src_buffer,
+	                          &src_offset) == 0)
+	{
+		goto fail_stage;
+	}
+
 	VkCommandBuffer cb;
 	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
 
@@ -1052,83 +2944,25 @@ int vkk_xferManager_readImage(vkk_xferManager_t* self,
 		goto fail_begin_cb;
 	}
 
-	// transition the image to copy the image to the
-	// transfer buffer
-	vkk_util_imageMemoryBarrier(image, cb,
-	                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-	                            0, image->mip_levels);
-
-	// copy the image to the transfer buffer
-	VkBufferImageCopy bic =
-	{
-		.bufferOffset      = 0,
-		.bufferRowLength   = 0,
-		.bufferImageHeight = 0,
-		.imageSubresource  =
-		{
-			.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-			.mipLevel       = 0,
-			.baseArrayLayer = 0,
-			.layerCount     = 1
-		},
-		.imageOffset =
-		{
-			.x = 0,
-			.y = 0,
-			.z = 0,
-		},
-		.imageExtent =
-		{
-			.width  = image->width,
-			.height = image->height,
-			.depth  = image->depth
-		}
-	};
-
-	vkCmdCopyImageToBuffer(cb, image->image,
-	                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-	                       xb->buffer, 1, &bic);
-
-	// transition the image from transfer mode to shading mode
-	vkk_util_imageMemoryBarrier(image, cb,
-	                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-	                            0, image->mip_levels);
+	VkCommandBuffer tcb;
+	tcb = vkk_xferInstance_beginTransfer(xi);
+	vkk_xferManager_recordImage(self, tcb, cb, image,
+	                            src_buffer, src_offset);
 
 	// end the transfer commands
 	vkEndCommandBuffer(cb);
 
 	// submit the commands
-	if(vkk_engine_queueSubmit(engine, VKK_QUEUE_BACKGROUND, &cb,
-	                          0, NULL, NULL, NULL,
-	                          xi->fence) == 0)
+	if(vkk_xferManager_submit(self, xi) == 0)
 	{
 		goto fail_submit;
 	}
 
-	uint64_t timeout = UINT64_MAX;
-	if(vkWaitForFences(engine->device, 1, &xi->fence, VK_TRUE,
-	                   timeout) != VK_SUCCESS)
-	{
-		LOGW("vkWaitForFences failed");
-		vkk_engine_queueWaitIdle(engine, VKK_QUEUE_BACKGROUND);
-	}
-
-	vkk_memoryManager_read(engine->mm, xb->memory,
-	                       0, size, pixels);
-
-	vkk_xferManager_lock(self);
-	if(cc_list_append(self->instance_list, NULL,
-	                  (const void*) xi) == NULL)
-	{
-		vkk_xferInstance_delete(&xi);
-	}
-
-	if(cc_multimap_addp(self->buffer_map, (const void*) xb,
-	                    sizeof(size_t), &size) == 0)
+	vkk_xferManager_finish(self, xi, NULL, _ticket);
+	if(_ticket)
 	{
-		vkk_xferBuffer_delete(&xb);
+		image->xfer_ticket = *_ticket;
 	}
-	vkk_xferManager_unlock(self);
 
 	// success
 	return 1;
@@ -1137,15 +2971,17 @@ int vkk_xferManager_readImage(vkk_xferManager_t* self,
 	fail_submit:
 	fail_begin_cb:
 	fail_cb:
+	fail_stage:
 		vkk_xferInstance_delete(&xi);
-	fail_xi:
-		vkk_xferBuffer_delete(&xb);
 	return 0;
 }
 
-int vkk_xferManager_writeImage(vkk_xferManager_t* self,
-                               vkk_image_t* image,
-                               const void* pixels)
+int vkk_xferManager_writeRegion(vkk_xferManager_t* self,
+                                vkk_image_t* image,
+                                uint32_t level,
+                                uint32_t x, uint32_t y,
+                                uint32_t w, uint32_t h,
+                                const void* pixels)
 {
 	ASSERT(self);
 	ASSERT(image);
@@ -1153,53 +2989,39 @@ int vkk_xferManager_writeImage(vkk_xferManager_t* self,
 
 	vkk_engine_t* engine = self->engine;
 
+	// a pending async readback must complete before the
+	// image is written (by the transfer queue)
+	vkk_xferManager_waitTicket(self, &image->readback_ticket);
+
+	// uploads are recorded into the batch when enabled
 	vkk_xferManager_lock(self);
-	if(self->shutdown)
+	if(self->batch_depth && (self->shutdown == 0))
 	{
+		int ret;
+		ret = vkk_xferManager_batchRegion(self, image, level,
+		                                  x, y, w, h, pixels);
 		vkk_xferManager_unlock(self);
-		return 0;
+		return ret;
 	}
+	vkk_xferManager_unlock(self);
 
-	// F16 images are a special case because the source
-	// pixels are in F32 format and must be converted by
-	// performing vkCmdBlitImage since there is not a native
-	// F16 type in C
-	if((image->format == VKK_IMAGE_FORMAT_RGBAF16) ||
-	   (image->format == VKK_IMAGE_FORMAT_RGBF16)  ||
-	   (image->format == VKK_IMAGE_FORMAT_RGF16)   ||
-	   (image->format == VKK_IMAGE_FORMAT_RF16))
+	vkk_xferManager_waitTicket(self, &image->xfer_ticket);
+
+	vkk_xferManager_lock(self);
+	if(self->shutdown)
 	{
 		vkk_xferManager_unlock(self);
-		return vkk_xferManager_writeImageF16(self, image,
-		                                     pixels);
+		return 0;
 	}
 
-	uint32_t width;
-	uint32_t height;
-	uint32_t depth;
-	size_t   size;
-	size = vkk_image_size(image, &width, &height, &depth);
+	uint32_t d = image->depth >> level;
+	d = (d == 0) ? 1 : d;
 
-	vkk_xferBuffer_t*  xb;
-	cc_multimapIter_t  miterator;
-	cc_multimapIter_t* miter = &miterator;
-	if(cc_multimap_findp(self->buffer_map, miter,
-	                     sizeof(size_t), &size))
-	{
-		xb = (vkk_xferBuffer_t*)
-		     cc_multimap_remove(self->buffer_map, &miter);
-		vkk_memoryManager_write(engine->mm, xb->memory,
-		                        0, size, pixels);
-	}
-	else
-	{
-		xb = vkk_xferBuffer_new(engine, size, pixels);
-		if(xb == NULL)
-		{
-			vkk_xferManager_unlock(self);
-			return 0;
-		}
-	}
+	size_t size;
+	size_t align;
+	int    f16;
+	size = vkk_xferManager_imageStaging(image, w, h, d, 1,
+	                                    &align, &f16);
 
 	vkk_xferInstance_t* xi;
 	cc_listIter_t* iter = cc_list_head(self->instance_list);
@@ -1214,11 +3036,20 @@ int vkk_xferManager_writeImage(vkk_xferManager_t* self,
 		if(xi == NULL)
 		{
 			vkk_xferManager_unlock(self);
-			goto fail_xi;
+			return 0;
 		}
 	}
 	vkk_xferManager_unlock(self);
 
+	VkBuffer     src_buffer;
+	VkDeviceSize src_offset;
+	if(vkk_xferInstance_stage(xi, engine, size, align, f16,
+	                          pixels, &src_buffer,
+	                          &src_offset) == 0)
+	{
+		goto fail_stage;
+	}
+
 	VkCommandBuffer cb;
 	cb = vkk_commandBuffer_get(xi->cmd_buffer, 0);
 
@@ -1256,54 +3087,9 @@ int vkk_xferManager_writeImage(vkk_xferManager_t* self,
 		goto fail_begin_cb;
 	}
 
-	// transition the image to copy the transfer buffer to
-	// the image and generate mip levels if needed
-	vkk_util_imageMemoryBarrier(image, cb,
-	                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-	                            0, image->mip_levels);
-
-	// copy the transfer buffer to the image
-	VkBufferImageCopy bic =
-	{
-		.bufferOffset      = 0,
-		.bufferRowLength   = 0,
-		.bufferImageHeight = 0,
-		.imageSubresource  =
-		{
-			.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-			.mipLevel       = 0,
-			.baseArrayLayer = 0,
-			.layerCount     = 1
-		},
-		.imageOffset =
-		{
-			.x = 0,
-			.y = 0,
-			.z = 0,
-		},
-		.imageExtent =
-		{
-			.width  = image->width,
-			.height = image->height,
-			.depth  = image->depth
-		}
-	};
-
-	vkCmdCopyBufferToImage(cb, xb->buffer, image->image,
-	                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-	                       1, &bic);
-
-	// at this point we may need to generate mip_levels if
-	// mipmapping was enabled
-	if(image->mip_levels > 1)
-	{
-		vkk_engine_mipmapImage(engine, image, cb);
-	}
-
-	// transition the image from transfer mode to shading mode
-	vkk_util_imageMemoryBarrier(image, cb,
-	                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-	                            0, image->mip_levels);
+	vkk_xferManager_recordRegion(self, cb, image, level,
+	                             x, y, w, h,
+	                             src_buffer, src_offset);
 
 	// end the transfer commands
 	vkEndCommandBuffer(cb);
@@ -1316,37 +3102,129 @@ int vkk_xferManager_writeImage(vkk_xferManager_t* self,
 		goto fail_submit;
 	}
 
-	uint64_t timeout = UINT64_MAX;
-	if(vkWaitForFences(engine->device, 1, &xi->fence, VK_TRUE,
-	                   timeout) != VK_SUCCESS)
+	vkk_xferManager_finish(self, xi, NULL, NULL);
+
+	// success
+	return 1;
+
+	// failure
+	fail_submit:
+	fail_begin_cb:
+	fail_cb:
+	fail_stage:
+		vkk_xferInstance_delete(&xi);
+	return 0;
+}
+
+int vkk_xferManager_poll(vkk_xferManager_t* self,
+                         uint64_t ticket)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	// submit the batch to ensure that the ticket completes
+	// and note that completed tickets are no longer pending
+	vkk_xferManager_lock(self);
+	if(self->batch_xi && (ticket == self->batch_ticket))
 	{
-		LOGW("vkWaitForFences failed");
-		vkk_engine_queueWaitIdle(engine, VKK_QUEUE_BACKGROUND);
+		vkk_xferManager_batchSubmit(self);
+	}
+	vkk_xferManager_reclaim(self);
+
+	int done = 1;
+	vkk_xferInstance_t* xi;
+	xi = vkk_xferManager_pending(self, ticket);
+	if(xi && (vkGetFenceStatus(engine->device,
+	                           xi->fence) != VK_SUCCESS))
+	{
+		done = 0;
 	}
+	vkk_xferManager_unlock(self);
+
+	return done;
+}
+
+void vkk_xferManager_wait(vkk_xferManager_t* self,
+                          uint64_t ticket)
+{
+	ASSERT(self);
 
+	// submit the batch before waiting on the ticket
 	vkk_xferManager_lock(self);
-	if(cc_list_append(self->instance_list, NULL,
-	                  (const void*) xi) == NULL)
+	if(self->batch_xi && (ticket == self->batch_ticket))
 	{
-		vkk_xferInstance_delete(&xi);
+		vkk_xferManager_batchSubmit(self);
 	}
+	vkk_xferManager_reclaim(self);
 
-	if(cc_multimap_addp(self->buffer_map, (const void*) xb,
-	                    sizeof(size_t), &size) == 0)
+	vkk_xferInstance_t* xi;
+	xi = vkk_xferManager_pending(self, ticket);
+	if(xi == NULL)
 	{
-		vkk_xferBuffer_delete(&xb);
+		vkk_xferManager_unlock(self);
+		return;
 	}
+
+	// the fence is waited on while unlocked and the
+	// waiters count prevents the instance from being
+	// recycled (and the fence reset) by another thread
+	++xi->waiters;
 	vkk_xferManager_unlock(self);
 
-	// success
-	return 1;
+	vkk_xferManager_waitFence(self, xi);
 
-	// failure
-	fail_submit:
-	fail_begin_cb:
-	fail_cb:
-		vkk_xferInstance_delete(&xi);
-	fail_xi:
-		vkk_xferBuffer_delete(&xb);
-	return 0;
+	vkk_xferManager_lock(self);
+	--xi->waiters;
+	vkk_xferManager_reclaim(self);
+	vkk_xferManager_unlock(self);
+}
+
+void vkk_xferManager_beginBatch(vkk_xferManager_t* self)
+{
+	ASSERT(self);
+
+	// batches may be nested and the uploads are recorded
+	// on demand when the first upload occurs
+	vkk_xferManager_lock(self);
+	++self->batch_depth;
+	vkk_xferManager_unlock(self);
+}
+
+uint64_t vkk_xferManager_endBatch(vkk_xferManager_t* self)
+{
+	ASSERT(self);
+
+	vkk_xferManager_lock(self);
+	ASSERT(self->batch_depth > 0);
+
+	// the ticket for an empty batch is complete
+	uint64_t ticket = 0;
+	if(self->batch_xi)
+	{
+		ticket = self->batch_ticket;
+	}
+
+	if(self->batch_depth > 0)
+	{
+		--self->batch_depth;
+		if(self->batch_depth == 0)
+		{
+			vkk_xferManager_batchSubmit(self);
+		}
+	}
+	vkk_xferManager_unlock(self);
+
+	return ticket;
+}
+
+void vkk_xferManager_flush(vkk_xferManager_t* self)
+{
+	ASSERT(self);
+
+	// submit the uploads recorded so far but keep the batch
+	// enabled for subsequent uploads
+	vkk_xferManager_lock(self);
+	vkk_xferManager_batchSubmit(self);
+	vkk_xferManager_unlock(self);
 }
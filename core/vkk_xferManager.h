@@ -28,9 +28,25 @@
 #include <vulkan/vulkan.h>
 
 #include "../../libcc/cc_list.h"
-#include "../../libcc/cc_multimap.h"
 #include "../vkk.h"
 
+// each xfer instance stages uploads in a persistently
+// mapped ring and larger uploads fall back to a temporary
+// buffer (offsets are aligned for buffer/image copies)
+#define VKK_XFER_RING_SIZE  (4*1024*1024)
+#define VKK_XFER_RING_ALIGN 256
+
+// at most VKK_XFER_INSTANCE_IDLE idle xfer instances (and
+// their rings) are kept and the excess instances are deleted
+// when recycled after a burst of concurrent xfers
+#define VKK_XFER_INSTANCE_IDLE 4
+
+// readback buffers are rounded up to size classes (the
+// minimum size class is VKK_XFER_READBACK_MIN) and cached
+// up to VKK_XFER_READBACK_CAP bytes by default
+#define VKK_XFER_READBACK_MIN (64*1024)
+#define VKK_XFER_READBACK_CAP (16*1024*1024)
+
 typedef enum
 {
 	VKK_XFER_MODE_READ  = 0,
@@ -46,8 +62,33 @@ typedef struct vkk_xferManager_s
 	// xfer instance
 	cc_list_t* instance_list;
 
-	// multimap from size to xfer buffer
-	cc_multimap_t* buffer_map;
+	// async xfer instances which are pending completion
+	// tickets are assigned in submission order and ticket 0
+	// is reserved for completed xfers
+	cc_list_t* pending_list;
+	uint64_t   ticket_next;
+
+	// uploads are recorded into a single command buffer
+	// while a batch is enabled (batch_depth > 0) and all
+	// resources in the batch share the batch ticket
+	int                        batch_depth;
+	struct vkk_xferInstance_s* batch_xi;
+	uint64_t                   batch_ticket;
+
+	// LRU cache of readback buffers where the least
+	// recently used buffers at the head are evicted when
+	// the readback_size exceeds the readback_cap
+	// readback buffers prefer host cached memory
+	cc_list_t* readback_list;
+	size_t     readback_size;
+	size_t     readback_cap;
+
+	// async readbacks which are recorded into the command
+	// buffer of the next default renderer frame (after the
+	// frame has rendered the image) and which are protected
+	// by the engine renderer mutex rather than the xfer mutex
+	// so the renderer may be signaled when they are recorded
+	cc_list_t* frame_list;
 
 	pthread_mutex_t mutex;
 } vkk_xferManager_t;
@@ -55,17 +96,25 @@ typedef struct vkk_xferManager_s
 vkk_xferManager_t* vkk_xferManager_new(vkk_engine_t* engine);
 void               vkk_xferManager_delete(vkk_xferManager_t** _self);
 void               vkk_xferManager_shutdown(vkk_xferManager_t* self);
+void               vkk_xferManager_readbackCap(vkk_xferManager_t* self,
+                                               size_t cap);
+void               vkk_xferManager_trim(vkk_xferManager_t* self);
+void               vkk_xferManager_memoryInfo(vkk_xferManager_t* self,
+                                              vkk_memoryType_e type,
+                                              vkk_memoryInfo_t* info);
 int                vkk_xferManager_fillStorage(vkk_xferManager_t* self,
                                                vkk_buffer_t* buffer,
                                                size_t offset,
                                                size_t size,
-                                               uint32_t data);
+                                               uint32_t data,
+                                               uint64_t* _ticket);
 int                vkk_xferManager_blitStorage(vkk_xferManager_t* self,
                                                vkk_xferMode_e mode,
                                                vkk_buffer_t* buffer,
                                                size_t offset,
                                                size_t size,
-                                               void* data);
+                                               void* data,
+                                               uint64_t* _ticket);
 int                vkk_xferManager_blitStorage2(vkk_xferManager_t* self,
                                                 vkk_buffer_t* src_buffer,
                                                 vkk_buffer_t* dst_buffer,
@@ -75,8 +124,35 @@ int                vkk_xferManager_blitStorage2(vkk_xferManager_t* self,
 int                vkk_xferManager_readImage(vkk_xferManager_t* self,
                                              vkk_image_t* image,
                                              void* pixels);
+vkk_readback_t*    vkk_xferManager_readImageAsync(vkk_xferManager_t* self,
+                                                  vkk_image_t* image);
+int                vkk_xferManager_pollReadback(vkk_xferManager_t* self,
+                                                vkk_readback_t* readback);
+const void*        vkk_xferManager_mapReadback(vkk_xferManager_t* self,
+                                               vkk_readback_t* readback);
+void               vkk_xferManager_deleteReadback(vkk_xferManager_t* self,
+                                                  vkk_readback_t** _readback);
+void               vkk_xferManager_recordReadbacks(vkk_xferManager_t* self,
+                                                   VkCommandBuffer cb,
+                                                   double ts);
+void               vkk_xferManager_waitReadbacks(vkk_xferManager_t* self,
+                                                 vkk_image_t* image);
 int                vkk_xferManager_writeImage(vkk_xferManager_t* self,
                                               vkk_image_t* image,
-                                              const void* pixels);
+                                              const void* pixels,
+                                              uint64_t* _ticket);
+int                vkk_xferManager_writeRegion(vkk_xferManager_t* self,
+                                               vkk_image_t* image,
+                                               uint32_t level,
+                                               uint32_t x, uint32_t y,
+                                               uint32_t w, uint32_t h,
+                                               const void* pixels);
+int                vkk_xferManager_poll(vkk_xferManager_t* self,
+                                        uint64_t ticket);
+void               vkk_xferManager_wait(vkk_xferManager_t* self,
+                                        uint64_t ticket);
+void               vkk_xferManager_beginBatch(vkk_xferManager_t* self);
+uint64_t           vkk_xferManager_endBatch(vkk_xferManager_t* self);
+void               vkk_xferManager_flush(vkk_xferManager_t* self);
 
 #endif
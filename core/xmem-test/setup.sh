@@ -0,0 +1,4 @@
+ln -s ../../../libbfs
+ln -s ../../../libcc
+ln -s ../../../libsqlite3
+ln -s ../../../libvkk
@@ -0,0 +1,1833 @@
+/*
+ * Copyright (c) 2023 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_TAG "xmem-test"
+#include "libcc/cc_log.h"
+#include "libcc/cc_memory.h"
+#include "libcc/cc_timestamp.h"
+#include "libvkk/vkk.h"
+#include "libvkk/core/vkk_util.h"
+#include "xmem_test.h"
+
+#define XMEM_TEST_WIDTH   64
+#define XMEM_TEST_HEIGHT  64
+#define XMEM_TEST_FRAMES  100
+#define XMEM_TEST_WARMUP  10
+#define XMEM_TEST_UPDATES 16
+
+// see xmem_test_trace
+#define XMEM_TEST_TRACE_IDS 4096
+#define XMEM_TEST_TRACE_OPS 65536
+
+// see xmem_test_coalesce
+#define XMEM_TEST_COALESCE_IDS  64
+#define XMEM_TEST_COALESCE_OPS  4096
+#define XMEM_TEST_COALESCE_LIVE (8*1024*1024)
+#define XMEM_TEST_COALESCE_SIZE (4*1024*1024 - 64*1024)
+
+// COUNT*SIZE fits in the default TLSF chunk size
+// see VKK_MEMORY_TLSF_CHUNK_SIZE
+#define XMEM_TEST_COALESCE_COUNT 4
+
+// see xmem_test_convertF16
+#define XMEM_TEST_F16_COUNT 21
+
+// see xmem_test_shared
+#define XMEM_TEST_SHARED_COUNT 4096
+
+// see xmem_test_mixed
+#define XMEM_TEST_MIXED_COUNT 256
+#define XMEM_TEST_MIXED_SIZE  32
+
+// see xmem_test_upload
+#define XMEM_TEST_UPLOAD_COUNT 64
+#define XMEM_TEST_UPLOAD_LOG2  16
+
+// see xmem_test_heightmap
+#define XMEM_TEST_HEIGHTMAP_MIN   1024
+#define XMEM_TEST_HEIGHTMAP_MAX   4096
+#define XMEM_TEST_HEIGHTMAP_COUNT 4
+
+// see xmem_test_readPixels
+#define XMEM_TEST_READPIXELS_SIZE  1024
+#define XMEM_TEST_READPIXELS_COUNT 16
+
+// see xmem_test_mipmap
+#define XMEM_TEST_MIPMAP_MIN   1024
+#define XMEM_TEST_MIPMAP_MAX   4096
+#define XMEM_TEST_MIPMAP_COUNT 4
+
+// see xmem_test_compressed
+#define XMEM_TEST_COMPRESSED_SIZE  2048
+#define XMEM_TEST_COMPRESSED_COUNT 4
+
+// see xmem_test_finishFree
+// timeout is the seconds to wait for the deferred frees
+#define XMEM_TEST_FREE_TIMEOUT 10.0
+
+// see xmem_test_evacuate
+#define XMEM_TEST_EVACUATE_SIZE 1024
+#define XMEM_TEST_EVACUATE_MAX  16384
+
+// see xmem_test_threads
+#define XMEM_TEST_THREADS_MAX   8
+#define XMEM_TEST_THREADS_OPS   16384
+#define XMEM_TEST_THREADS_BATCH 64
+
+typedef struct
+{
+	vkk_engine_t* engine;
+	int           ret;
+	double        dt_alloc;
+	double        dt_free;
+	double        max_alloc;
+} xmem_test_thread_t;
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static int xmem_test_updateBuffer(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	// emulate the UI/VG updates which write a small uniform
+	// buffer (e.g. mat4) thousands of times per frame
+	// build with make VKK_MEMORY_PERSISTENT_MAP=0 to measure
+	// the legacy vkMapMemory per write path for comparison
+	float data[16] = { 0 };
+	float clear_color[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	// the warmup frames are excluded from the timing since
+	// they include the first touch of the mapped pages and
+	// the min/max frame times show the variance between runs
+	int    i;
+	int    j;
+	int    k;
+	double dt     = 0.0;
+	double dt_min = 0.0;
+	double dt_max = 0.0;
+	for(i = 0; i < XMEM_TEST_WARMUP + XMEM_TEST_FRAMES; ++i)
+	{
+		if(vkk_renderer_beginImage(self->renderer,
+		                           VKK_RENDERER_MODE_DRAW,
+		                           self->image,
+		                           clear_color) == 0)
+		{
+			return 0;
+		}
+
+		double t0 = cc_timestamp();
+		for(j = 0; j < XMEM_TEST_UPDATES; ++j)
+		{
+			for(k = 0; k < XMEM_TEST_UB_COUNT; ++k)
+			{
+				data[0] = (float) (i + j + k);
+				vkk_renderer_updateBuffer(self->renderer,
+				                          self->ub[k],
+				                          sizeof(data), data);
+			}
+		}
+		double t1 = cc_timestamp() - t0;
+
+		vkk_renderer_end(self->renderer);
+
+		if(i < XMEM_TEST_WARMUP)
+		{
+			continue;
+		}
+
+		dt += t1;
+		if((i == XMEM_TEST_WARMUP) || (t1 < dt_min))
+		{
+			dt_min = t1;
+		}
+		if(t1 > dt_max)
+		{
+			dt_max = t1;
+		}
+	}
+
+	// ns is the average cost per update and min_ns/max_ns
+	// are the per update cost of the fastest/slowest frame
+	double per_frame = (double) (XMEM_TEST_UPDATES*
+	                             XMEM_TEST_UB_COUNT);
+	double count     = per_frame*((double) XMEM_TEST_FRAMES);
+	LOGI("updateBuffer: count=%i, size=%i, dt=%lf, ns=%lf",
+	     (int) count, (int) sizeof(data), dt,
+	     1000000000.0*dt/count);
+	LOGI("updateBuffer: min_ns=%lf, max_ns=%lf",
+	     1000000000.0*dt_min/per_frame,
+	     1000000000.0*dt_max/per_frame);
+
+	return 1;
+}
+
+static int
+xmem_test_traceOp(FILE* f, uint32_t* _seed,
+                  char* _op, uint32_t* _id, size_t* _size)
+{
+	ASSERT(_seed);
+	ASSERT(_op);
+	ASSERT(_id);
+	ASSERT(_size);
+
+	// read the next op from the recorded trace
+	// e.g. "a 12 33792" or "f 12"
+	if(f)
+	{
+		char         op;
+		unsigned int id;
+		unsigned int size = 0;
+		char         line[256];
+		while(fgets(line, 256, f))
+		{
+			int n = sscanf(line, "%c %u %u", &op, &id, &size);
+			if((n >= 2) && (id < XMEM_TEST_TRACE_IDS))
+			{
+				*_op   = op;
+				*_id   = id;
+				*_size = size;
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	// otherwise generate a synthetic trace with a mix of
+	// small and large buffers (16B to 1MB)
+	uint32_t seed = *_seed;
+	seed   = 1664525*seed + 1013904223;
+	*_id   = (seed >> 8)%XMEM_TEST_TRACE_IDS;
+	seed   = 1664525*seed + 1013904223;
+	*_size = 16 + (seed >> 8)%(16 << ((seed >> 4)%17));
+	*_op   = 'x';
+	*_seed = seed;
+	return 1;
+}
+
+static int
+xmem_test_trace(xmem_test_t* self, const char* fname)
+{
+	// fname may be NULL
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	FILE* f = NULL;
+	if(fname)
+	{
+		f = fopen(fname, "r");
+		if(f == NULL)
+		{
+			LOGE("invalid %s", fname);
+			return 0;
+		}
+	}
+
+	vkk_buffer_t** buffers;
+	buffers = (vkk_buffer_t**)
+	          CALLOC(XMEM_TEST_TRACE_IDS, sizeof(vkk_buffer_t*));
+	if(buffers == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_buffers;
+	}
+
+	vkk_memoryInfo_t info0;
+	vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_ANY,
+	                      &info0);
+
+	// replay the trace
+	// note that vkk_buffer_delete is deferred to the
+	// destruct thread so only the alloc latency is measured
+	char     op;
+	uint32_t id;
+	uint32_t seed      = 1;
+	size_t   size      = 0;
+	size_t   size_live = 0;
+	size_t   size_peak = 0;
+	int      count     = 0;
+	int      ops       = 0;
+	double   dt        = 0.0;
+	vkk_memoryInfo_t info_peak = { 0 };
+	while(xmem_test_traceOp(f, &seed, &op, &id, &size) &&
+	      (f || (ops < XMEM_TEST_TRACE_OPS)))
+	{
+		++ops;
+
+		if(buffers[id] && ((op == 'f') || (op == 'x')))
+		{
+			size_live -= vkk_buffer_size(buffers[id]);
+			vkk_buffer_delete(&buffers[id]);
+			continue;
+		}
+		else if((buffers[id] == NULL) &&
+		        ((op == 'a') || (op == 'x')) && size)
+		{
+			double t0 = cc_timestamp();
+			buffers[id] = vkk_buffer_new(engine,
+			                             VKK_UPDATE_MODE_STATIC,
+			                             VKK_BUFFER_USAGE_VERTEX,
+			                             size, NULL);
+			dt += cc_timestamp() - t0;
+			if(buffers[id] == NULL)
+			{
+				goto fail_alloc;
+			}
+			++count;
+
+			size_live += size;
+			if(size_live > size_peak)
+			{
+				size_peak = size_live;
+				vkk_engine_memoryInfo(engine, 0,
+				                      VKK_MEMORY_TYPE_ANY,
+				                      &info_peak);
+			}
+		}
+	}
+
+	// wasted bytes are measured at the peak live size
+	LOGI("trace: ops=%i, count=%i, alloc_us=%lf",
+	     ops, count, 1000000.0*dt/((double) count));
+	LOGI("trace: size_peak=%" PRIu64 ", size_slots=%" PRIu64
+	     ", size_chunks=%" PRIu64,
+	     (uint64_t) size_peak,
+	     (uint64_t) (info_peak.size_slots - info0.size_slots),
+	     (uint64_t) (info_peak.size_chunks - info0.size_chunks));
+
+	int i;
+	for(i = 0; i < XMEM_TEST_TRACE_IDS; ++i)
+	{
+		vkk_buffer_delete(&buffers[i]);
+	}
+	FREE(buffers);
+
+	if(f)
+	{
+		fclose(f);
+	}
+
+	// success
+	return 1;
+
+	// failure
+	fail_alloc:
+	{
+		int j;
+		for(j = 0; j < XMEM_TEST_TRACE_IDS; ++j)
+		{
+			vkk_buffer_delete(&buffers[j]);
+		}
+		FREE(buffers);
+	}
+	fail_buffers:
+	{
+		if(f)
+		{
+			fclose(f);
+		}
+	}
+	return 0;
+}
+
+static int xmem_test_shared(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	// emulate the UI/VG widgets which create thousands of
+	// small uniform/vertex/index buffers and count the
+	// VkBuffers created for the shared chunks rather than
+	// one VkBuffer per buffer
+	vkk_bufferUsage_e usage[3] =
+	{
+		VKK_BUFFER_USAGE_UNIFORM,
+		VKK_BUFFER_USAGE_VERTEX,
+		VKK_BUFFER_USAGE_INDEX,
+	};
+
+	vkk_buffer_t** buffers;
+	buffers = (vkk_buffer_t**)
+	          CALLOC(XMEM_TEST_SHARED_COUNT, sizeof(vkk_buffer_t*));
+	if(buffers == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	vkk_memoryInfo_t info0;
+	vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_ANY,
+	                      &info0);
+
+	int    i;
+	double t0 = cc_timestamp();
+	for(i = 0; i < XMEM_TEST_SHARED_COUNT; ++i)
+	{
+		buffers[i] = vkk_buffer_new(engine,
+		                            VKK_UPDATE_MODE_STATIC,
+		                            usage[i%3],
+		                            64 + 64*(i%4), NULL);
+		if(buffers[i] == NULL)
+		{
+			goto fail_buffer;
+		}
+	}
+	double dt = cc_timestamp() - t0;
+
+	vkk_memoryInfo_t info;
+	vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_ANY,
+	                      &info);
+
+	LOGI("shared: count=%i, count_shared=%i, us=%lf",
+	     XMEM_TEST_SHARED_COUNT,
+	     (int) (info.count_shared - info0.count_shared),
+	     1000000.0*dt/((double) XMEM_TEST_SHARED_COUNT));
+
+	for(i = 0; i < XMEM_TEST_SHARED_COUNT; ++i)
+	{
+		vkk_buffer_delete(&buffers[i]);
+	}
+	FREE(buffers);
+
+	// success
+	return 1;
+
+	// failure
+	fail_buffer:
+	{
+		int j;
+		for(j = 0; j < i; ++j)
+		{
+			vkk_buffer_delete(&buffers[j]);
+		}
+		FREE(buffers);
+	}
+	return 0;
+}
+
+static int xmem_test_mixed(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	// interleave small images (optimal tiling) and storage
+	// buffers (linear) in device memory to measure the
+	// chunks required when the pools are shared or
+	// separated due to the bufferImageGranularity
+	vkk_image_t**  images;
+	vkk_buffer_t** buffers;
+	images = (vkk_image_t**)
+	         CALLOC(XMEM_TEST_MIXED_COUNT, sizeof(vkk_image_t*));
+	if(images == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	buffers = (vkk_buffer_t**)
+	          CALLOC(XMEM_TEST_MIXED_COUNT, sizeof(vkk_buffer_t*));
+	if(buffers == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_buffers;
+	}
+
+	vkk_memoryInfo_t info0;
+	vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_DEVICE,
+	                      &info0);
+
+	int    i;
+	size_t size = 4*XMEM_TEST_MIXED_SIZE*XMEM_TEST_MIXED_SIZE;
+	for(i = 0; i < XMEM_TEST_MIXED_COUNT; ++i)
+	{
+		images[i] = vkk_image_new(engine,
+		                          XMEM_TEST_MIXED_SIZE,
+		                          XMEM_TEST_MIXED_SIZE, 1,
+		                          VKK_IMAGE_FORMAT_RGBA8888,
+		                          0, VKK_STAGE_FS, NULL);
+		if(images[i] == NULL)
+		{
+			goto fail_alloc;
+		}
+
+		buffers[i] = vkk_buffer_new(engine,
+		                            VKK_UPDATE_MODE_SYNCHRONOUS,
+		                            VKK_BUFFER_USAGE_STORAGE,
+		                            size, NULL);
+		if(buffers[i] == NULL)
+		{
+			goto fail_alloc;
+		}
+	}
+
+	vkk_memoryInfo_t info;
+	vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_DEVICE,
+	                      &info);
+
+	LOGI("mixed: count=%i, count_chunks=%i, size_chunks=%" PRIu64
+	     ", size_slots=%" PRIu64,
+	     XMEM_TEST_MIXED_COUNT,
+	     (int) (info.count_chunks - info0.count_chunks),
+	     (uint64_t) (info.size_chunks - info0.size_chunks),
+	     (uint64_t) (info.size_slots - info0.size_slots));
+
+	for(i = 0; i < XMEM_TEST_MIXED_COUNT; ++i)
+	{
+		vkk_buffer_delete(&buffers[i]);
+		vkk_image_delete(&images[i]);
+	}
+	FREE(buffers);
+	FREE(images);
+
+	// success
+	return 1;
+
+	// failure
+	fail_alloc:
+	{
+		int j;
+		for(j = 0; j <= i; ++j)
+		{
+			vkk_buffer_delete(&buffers[j]);
+			vkk_image_delete(&images[j]);
+		}
+		FREE(buffers);
+	}
+	fail_buffers:
+		FREE(images);
+	return 0;
+}
+
+static int xmem_test_upload(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	// emulate streaming content of varying sizes (256B to
+	// 8MB) to measure the upload throughput and the staging
+	// memory held by the xfer manager afterwards
+	size_t size_max = 256 << (XMEM_TEST_UPLOAD_LOG2 - 1);
+
+	char* data = (char*) CALLOC(1, size_max);
+	if(data == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	vkk_buffer_t* buffer;
+	buffer = vkk_buffer_new(engine,
+	                        VKK_UPDATE_MODE_SYNCHRONOUS,
+	                        VKK_BUFFER_USAGE_STORAGE,
+	                        size_max, NULL);
+	if(buffer == NULL)
+	{
+		goto fail_buffer;
+	}
+
+	vkk_memoryInfo_t info0;
+	vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_SYSTEM,
+	                      &info0);
+
+	int    i;
+	size_t size;
+	size_t total = 0;
+	double t0    = cc_timestamp();
+	for(i = 0; i < XMEM_TEST_UPLOAD_COUNT; ++i)
+	{
+		size = 256 << (i%XMEM_TEST_UPLOAD_LOG2);
+		if(vkk_buffer_writeStorage(buffer, 0, size,
+		                           data) == 0)
+		{
+			goto fail_write;
+		}
+		total += size;
+	}
+	double dt = cc_timestamp() - t0;
+
+	vkk_memoryInfo_t info;
+	vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_SYSTEM,
+	                      &info);
+
+	LOGI("upload: count=%i, size=%" PRIu64 ", MB/s=%lf"
+	     ", size_staging=%" PRIu64,
+	     XMEM_TEST_UPLOAD_COUNT, (uint64_t) total,
+	     ((double) total)/(1024.0*1024.0*dt),
+	     (uint64_t) (info.size_slots - info0.size_slots));
+
+	vkk_buffer_delete(&buffer);
+	FREE(data);
+
+	// success
+	return 1;
+
+	// failure
+	fail_write:
+		vkk_buffer_delete(&buffer);
+	fail_buffer:
+		FREE(data);
+	return 0;
+}
+
+static int xmem_test_readback(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	// emulate readbacks of many distinct sizes (e.g. tiles
+	// and sprites) to verify that the xfer buffers cached
+	// by the xfer manager remain bounded
+	size_t size_max = 256 << (XMEM_TEST_UPLOAD_LOG2 - 1);
+
+	char* data = (char*) CALLOC(1, size_max);
+	if(data == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	vkk_buffer_t* buffer;
+	buffer = vkk_buffer_new(engine,
+	                        VKK_UPDATE_MODE_SYNCHRONOUS,
+	                        VKK_BUFFER_USAGE_STORAGE,
+	                        size_max, NULL);
+	if(buffer == NULL)
+	{
+		goto fail_buffer;
+	}
+
+	int    i;
+	size_t size;
+	size_t total = 0;
+	double t0    = cc_timestamp();
+	for(i = 0; i < XMEM_TEST_UPLOAD_COUNT; ++i)
+	{
+		// vary the size within each power-of-two
+		size = (256 << (i%XMEM_TEST_UPLOAD_LOG2)) +
+		       4*(size_t) i;
+		if(size > size_max)
+		{
+			size = size_max;
+		}
+
+		if(vkk_buffer_readStorage(buffer, 0, size,
+		                          data) == 0)
+		{
+			goto fail_read;
+		}
+		total += size;
+	}
+	double dt = cc_timestamp() - t0;
+
+	vkk_memoryInfo_t info;
+	vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_ANY,
+	                      &info);
+
+	LOGI("readback: count=%i, size=%" PRIu64 ", MB/s=%lf"
+	     ", count_xfer=%i, size_xfer=%" PRIu64,
+	     XMEM_TEST_UPLOAD_COUNT, (uint64_t) total,
+	     ((double) total)/(1024.0*1024.0*dt),
+	     (int) info.count_xfer, (uint64_t) info.size_xfer);
+
+	vkk_buffer_delete(&buffer);
+	FREE(data);
+
+	// success
+	return 1;
+
+	// failure
+	fail_read:
+		vkk_buffer_delete(&buffer);
+	fail_buffer:
+		FREE(data);
+	return 0;
+}
+
+static int xmem_test_heightmap(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	// emulate the elevation tiles of a terrain renderer to
+	// compare the F32 upload with the F16 upload which
+	// converts the F32 pixels on the CPU while staging
+	size_t count = XMEM_TEST_HEIGHTMAP_MAX*
+	               XMEM_TEST_HEIGHTMAP_MAX;
+
+	float* pixels = (float*) CALLOC(count, sizeof(float));
+	if(pixels == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	size_t i;
+	for(i = 0; i < count; ++i)
+	{
+		pixels[i] = -430.0f + (float) (i%9279);
+	}
+
+	vkk_imageFormat_e format[2] =
+	{
+		VKK_IMAGE_FORMAT_RF32,
+		VKK_IMAGE_FORMAT_RF16,
+	};
+
+	const char* name[2] =
+	{
+		"RF32",
+		"RF16",
+	};
+
+	int f;
+	int j;
+	for(f = 0; f < 2; ++f)
+	{
+		uint32_t size;
+		for(size = XMEM_TEST_HEIGHTMAP_MIN;
+		    size <= XMEM_TEST_HEIGHTMAP_MAX; size *= 2)
+		{
+			double t0 = cc_timestamp();
+			for(j = 0; j < XMEM_TEST_HEIGHTMAP_COUNT; ++j)
+			{
+				vkk_image_t* image;
+				image = vkk_image_new(engine, size, size, 1,
+				                      format[f], 0,
+				                      VKK_STAGE_VS, pixels);
+				if(image == NULL)
+				{
+					goto fail_image;
+				}
+				vkk_image_delete(&image);
+			}
+			double dt = cc_timestamp() - t0;
+
+			// throughput of the F32 source pixels
+			double mb = (double) (XMEM_TEST_HEIGHTMAP_COUNT*
+			                      sizeof(float)*size*size)/
+			            (1024.0*1024.0);
+			LOGI("heightmap: format=%s, size=%u, count=%i"
+			     ", dt=%lf, MB/s=%lf",
+			     name[f], size, XMEM_TEST_HEIGHTMAP_COUNT,
+			     dt, mb/dt);
+		}
+	}
+
+	FREE(pixels);
+
+	// success
+	return 1;
+
+	// failure
+	fail_image:
+		FREE(pixels);
+	return 0;
+}
+
+static int xmem_test_readPixels(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	// emulate screenshot/picking readbacks to compare the
+	// time that the calling thread is blocked by the
+	// synchronous and asynchronous readbacks
+	uint32_t size = XMEM_TEST_READPIXELS_SIZE;
+
+	uint32_t* pixels;
+	pixels = (uint32_t*) CALLOC(size*size, sizeof(uint32_t));
+	if(pixels == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	vkk_image_t* image;
+	image = vkk_image_new(engine, size, size, 1,
+	                      VKK_IMAGE_FORMAT_RGBA8888, 0,
+	                      VKK_STAGE_FS, pixels);
+	if(image == NULL)
+	{
+		goto fail_image;
+	}
+
+	int i;
+	double t0 = cc_timestamp();
+	for(i = 0; i < XMEM_TEST_READPIXELS_COUNT; ++i)
+	{
+		if(vkk_image_readPixels(image, pixels) == 0)
+		{
+			goto fail_read;
+		}
+	}
+	double dt_sync = cc_timestamp() - t0;
+
+	// the readbacks are issued without waiting and the
+	// results are mapped after all readbacks were issued
+	vkk_readback_t* readback[XMEM_TEST_READPIXELS_COUNT];
+	memset(readback, 0, sizeof(readback));
+
+	t0 = cc_timestamp();
+	for(i = 0; i < XMEM_TEST_READPIXELS_COUNT; ++i)
+	{
+		readback[i] = vkk_image_readPixelsAsync(image);
+		if(readback[i] == NULL)
+		{
+			goto fail_read_async;
+		}
+	}
+	double dt_async = cc_timestamp() - t0;
+
+	t0 = cc_timestamp();
+	for(i = 0; i < XMEM_TEST_READPIXELS_COUNT; ++i)
+	{
+		if(vkk_engine_mapReadback(engine, readback[i]) == NULL)
+		{
+			goto fail_map;
+		}
+		vkk_engine_deleteReadback(engine, &readback[i]);
+	}
+	double dt_map = cc_timestamp() - t0;
+
+	LOGI("readPixels: size=%u, count=%i, dt_sync=%lf"
+	     ", dt_async=%lf, dt_map=%lf",
+	     size, XMEM_TEST_READPIXELS_COUNT,
+	     dt_sync, dt_async, dt_map);
+
+	vkk_image_delete(&image);
+	FREE(pixels);
+
+	// success
+	return 1;
+
+	// failure
+	fail_map:
+	fail_read_async:
+		for(i = 0; i < XMEM_TEST_READPIXELS_COUNT; ++i)
+		{
+			vkk_engine_deleteReadback(engine, &readback[i]);
+		}
+	fail_read:
+		vkk_image_delete(&image);
+	fail_image:
+		FREE(pixels);
+	return 0;
+}
+
+static int xmem_test_mipmap(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	// compare the blit mip chain with the compute mip chain
+	// where the GPU time of the mip chains is measured by
+	// timestamps and the upload without mipmaps is the
+	// baseline which is subtracted from the wall time
+	vkk_imageCaps_t caps;
+	vkk_engine_imageCaps(engine, VKK_IMAGE_FORMAT_RGBA8888,
+	                     &caps);
+	if(caps.mipmap == 0)
+	{
+		LOGW("mipmap: unsupported");
+		return 1;
+	}
+
+	size_t count = XMEM_TEST_MIPMAP_MAX*
+	               XMEM_TEST_MIPMAP_MAX;
+
+	uint32_t* pixels;
+	pixels = (uint32_t*) CALLOC(count, sizeof(uint32_t));
+	if(pixels == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	size_t i;
+	for(i = 0; i < count; ++i)
+	{
+		pixels[i] = (uint32_t) (i*2654435761u);
+	}
+
+	const char* name[3] =
+	{
+		"none",
+		"blit",
+		"compute",
+	};
+
+	int m;
+	int j;
+	uint32_t size;
+	for(size = XMEM_TEST_MIPMAP_MIN;
+	    size <= XMEM_TEST_MIPMAP_MAX; size *= 2)
+	{
+		double dt[3];
+		for(m = 0; m < 3; ++m)
+		{
+			vkk_engine_mipmapCompute(engine, m == 2);
+			vkk_engine_mipmapTimer(engine, 1);
+
+			double t0 = cc_timestamp();
+			for(j = 0; j < XMEM_TEST_MIPMAP_COUNT; ++j)
+			{
+				vkk_image_t* image;
+				image = vkk_image_new(engine, size, size, 1,
+				                      VKK_IMAGE_FORMAT_RGBA8888,
+				                      m != 0, VKK_STAGE_FS,
+				                      pixels);
+				if(image == NULL)
+				{
+					goto fail_image;
+				}
+				vkk_image_delete(&image);
+			}
+			dt[m] = cc_timestamp() - t0;
+
+			uint32_t count_gpu;
+			double   dt_gpu;
+			dt_gpu = vkk_engine_mipmapElapsed(engine, &count_gpu);
+
+			LOGI("mipmap: mode=%s, size=%u, count=%i, dt=%lf"
+			     ", dt_mipmap=%lf, dt_gpu=%lf, count_gpu=%u",
+			     name[m], size, XMEM_TEST_MIPMAP_COUNT,
+			     dt[m], dt[m] - dt[0], dt_gpu, count_gpu);
+		}
+	}
+
+	vkk_engine_mipmapTimer(engine, 0);
+	vkk_engine_mipmapCompute(engine, 0);
+	FREE(pixels);
+
+	// success
+	return 1;
+
+	// failure
+	fail_image:
+		vkk_engine_mipmapTimer(engine, 0);
+		vkk_engine_mipmapCompute(engine, 0);
+		FREE(pixels);
+	return 0;
+}
+
+static int xmem_test_compressed(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	// compare the image memory and upload time of the
+	// compressed formats with RGBA8888 for map tiles and
+	// UI sprites where the compressed pixels are zero
+	// blocks since only the size of the data matters
+	typedef struct
+	{
+		vkk_imageFormat_e format;
+		const char*       name;
+		uint32_t          bw;
+		size_t            bytes;
+	} xmem_test_format_t;
+
+	xmem_test_format_t format[] =
+	{
+		{ VKK_IMAGE_FORMAT_RGBA8888, "RGBA8888", 1, 4  },
+		{ VKK_IMAGE_FORMAT_BC1RGBA,  "BC1RGBA",  4, 8  },
+		{ VKK_IMAGE_FORMAT_BC3RGBA,  "BC3RGBA",  4, 16 },
+		{ VKK_IMAGE_FORMAT_BC7RGBA,  "BC7RGBA",  4, 16 },
+		{ VKK_IMAGE_FORMAT_ETC2RGB,  "ETC2RGB",  4, 8  },
+		{ VKK_IMAGE_FORMAT_ETC2RGBA, "ETC2RGBA", 4, 16 },
+		{ VKK_IMAGE_FORMAT_ASTC4X4,  "ASTC4X4",  4, 16 },
+		{ VKK_IMAGE_FORMAT_ASTC8X8,  "ASTC8X8",  8, 16 },
+	};
+
+	uint32_t size = XMEM_TEST_COMPRESSED_SIZE;
+
+	void* pixels = CALLOC(size*size, sizeof(uint32_t));
+	if(pixels == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	vkk_image_t* image[XMEM_TEST_COMPRESSED_COUNT];
+
+	int f;
+	int j;
+	int count = (int) (sizeof(format)/sizeof(format[0]));
+	for(f = 0; f < count; ++f)
+	{
+		vkk_imageCaps_t caps;
+		vkk_engine_imageCaps(engine, format[f].format, &caps);
+		if(caps.texture == 0)
+		{
+			LOGI("compressed: format=%s, unsupported",
+			     format[f].name);
+			continue;
+		}
+
+		vkk_memoryInfo_t info0;
+		vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_ANY,
+		                      &info0);
+
+		double t0 = cc_timestamp();
+		for(j = 0; j < XMEM_TEST_COMPRESSED_COUNT; ++j)
+		{
+			image[j] = vkk_image_new(engine, size, size, 1,
+			                         format[f].format, 0,
+			                         VKK_STAGE_FS, pixels);
+			if(image[j] == NULL)
+			{
+				goto fail_image;
+			}
+		}
+		double dt = cc_timestamp() - t0;
+
+		vkk_memoryInfo_t info;
+		vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_ANY,
+		                      &info);
+
+		for(j = 0; j < XMEM_TEST_COMPRESSED_COUNT; ++j)
+		{
+			vkk_image_delete(&image[j]);
+		}
+
+		size_t blocks = size/format[f].bw;
+		LOGI("compressed: format=%s, size=%u, count=%i"
+		     ", dt=%lf, size_pixels=%" PRIu64
+		     ", size_slots=%" PRIu64,
+		     format[f].name, size, XMEM_TEST_COMPRESSED_COUNT,
+		     dt, (uint64_t) (blocks*blocks*format[f].bytes),
+		     (uint64_t) (info.size_slots - info0.size_slots)/
+		     XMEM_TEST_COMPRESSED_COUNT);
+	}
+
+	FREE(pixels);
+
+	// success
+	return 1;
+
+	// failure
+	fail_image:
+		while(j > 0)
+		{
+			--j;
+			vkk_image_delete(&image[j]);
+		}
+		FREE(pixels);
+	return 0;
+}
+
+static int
+xmem_test_finishFree(vkk_engine_t* engine, size_t count_free)
+{
+	ASSERT(engine);
+
+	// wait for the destruct thread to perform the frees
+	// which were deferred by vkk_buffer_delete
+	vkk_memoryStats_t stats;
+	vkk_engine_memoryStats(engine, VKK_MEMORY_TYPE_ANY, &stats);
+
+	double t0 = cc_timestamp();
+	while(stats.count_free < count_free)
+	{
+		if(cc_timestamp() - t0 > XMEM_TEST_FREE_TIMEOUT)
+		{
+			LOGE("timeout: count_free=%" PRIu64
+			     ", expected=%" PRIu64,
+			     (uint64_t) stats.count_free,
+			     (uint64_t) count_free);
+			return 0;
+		}
+
+		usleep(1000);
+		vkk_engine_memoryStats(engine, VKK_MEMORY_TYPE_ANY,
+		                       &stats);
+	}
+
+	return 1;
+}
+
+static int xmem_test_convertF16(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	// known values for the float to half conversion
+	// including denormals, overflow, NaN and round to
+	// nearest even ties
+	uint32_t table[XMEM_TEST_F16_COUNT][2] =
+	{
+		{ 0x00000000, 0x0000 }, // 0.0
+		{ 0x80000000, 0x8000 }, // -0.0
+		{ 0x3F800000, 0x3C00 }, // 1.0
+		{ 0xC0000000, 0xC000 }, // -2.0
+		{ 0x477FE000, 0x7BFF }, // 65504 (max)
+		{ 0x477FEFFF, 0x7BFF }, // below overflow tie
+		{ 0x477FF000, 0x7C00 }, // 65520 (overflow tie)
+		{ 0x49742400, 0x7C00 }, // 1000000 (overflow)
+		{ 0x7F800000, 0x7C00 }, // inf
+		{ 0xFF800000, 0xFC00 }, // -inf
+		{ 0x7FC00000, 0x7E00 }, // NaN
+		{ 0x38800000, 0x0400 }, // 2^-14 (min normal)
+		{ 0x387FC000, 0x03FF }, // max denormal
+		{ 0x33800000, 0x0001 }, // 2^-24 (min denormal)
+		{ 0xB3800000, 0x8001 }, // -2^-24
+		{ 0x33000000, 0x0000 }, // 2^-25 (tie to even)
+		{ 0x33C00000, 0x0002 }, // 3*2^-25 (tie to even)
+		{ 0x32800000, 0x0000 }, // 2^-26 (underflow)
+		{ 0x3F801000, 0x3C00 }, // 1 + 2^-11 (tie to even)
+		{ 0x3F803000, 0x3C02 }, // 1 + 3*2^-11 (tie to even)
+		{ 0x3F801001, 0x3C01 }, // 1 + 2^-11 + 2^-23
+	};
+
+	union
+	{
+		uint32_t u;
+		float    f;
+	} src[XMEM_TEST_F16_COUNT];
+
+	uint16_t dst[XMEM_TEST_F16_COUNT];
+
+	int i;
+	int n = XMEM_TEST_F16_COUNT;
+	for(i = 0; i < n; ++i)
+	{
+		src[i].u = table[i][0];
+	}
+
+	// convert the table at once to select the vector path
+	// (when supported) and per value for the scalar path
+	int pass;
+	for(pass = 0; pass < 2; ++pass)
+	{
+		memset(dst, 0xFF, sizeof(dst));
+		if(pass == 0)
+		{
+			vkk_util_convertF16(dst, &src[0].f, n);
+		}
+		else
+		{
+			for(i = 0; i < n; ++i)
+			{
+				vkk_util_convertF16(&dst[i], &src[i].f, 1);
+			}
+		}
+
+		for(i = 0; i < n; ++i)
+		{
+			if(dst[i] != table[i][1])
+			{
+				LOGE("invalid pass=%i, src=0x%08X, dst=0x%04X"
+				     ", expected=0x%04X",
+				     pass, (unsigned int) table[i][0],
+				     (unsigned int) dst[i],
+				     (unsigned int) table[i][1]);
+				return 0;
+			}
+		}
+	}
+
+	LOGI("convertF16: count=%i", n);
+
+	return 1;
+}
+
+static int xmem_test_coalesce(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	vkk_buffer_t* buffers[XMEM_TEST_COALESCE_IDS] = { 0 };
+
+	vkk_memoryStats_t stats;
+	vkk_engine_memoryStats(engine, VKK_MEMORY_TYPE_ANY, &stats);
+
+	// randomly alloc/free variable size buffers (16KB to
+	// 1MB) to split and merge the TLSF blocks
+	// note that vkk_buffer_delete is deferred to the
+	// destruct thread
+	size_t   count_free = stats.count_free;
+	size_t   size_live  = 0;
+	uint32_t seed       = 1;
+	int      i;
+	for(i = 0; i < XMEM_TEST_COALESCE_OPS; ++i)
+	{
+		seed = 1664525*seed + 1013904223;
+		uint32_t id = (seed >> 8)%XMEM_TEST_COALESCE_IDS;
+		seed = 1664525*seed + 1013904223;
+		size_t size = 16*1024 + 1 + (seed >> 8)%(1024*1024);
+
+		if(buffers[id])
+		{
+			size_live -= vkk_buffer_size(buffers[id]);
+			vkk_buffer_delete(&buffers[id]);
+			++count_free;
+		}
+		else if(size_live + size <= XMEM_TEST_COALESCE_LIVE)
+		{
+			buffers[id] = vkk_buffer_new(engine,
+			                             VKK_UPDATE_MODE_STATIC,
+			                             VKK_BUFFER_USAGE_VERTEX,
+			                             size, NULL);
+			if(buffers[id] == NULL)
+			{
+				goto fail_alloc;
+			}
+			size_live += size;
+		}
+	}
+
+	for(i = 0; i < XMEM_TEST_COALESCE_IDS; ++i)
+	{
+		if(buffers[i])
+		{
+			vkk_buffer_delete(&buffers[i]);
+			++count_free;
+		}
+	}
+
+	if(xmem_test_finishFree(engine, count_free) == 0)
+	{
+		return 0;
+	}
+
+	// the empty chunks must be fully coalesced so that a
+	// retained chunk holds the large buffers without
+	// allocating a new chunk
+	vkk_memoryInfo_t info;
+	vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_ANY, &info);
+	if(info.count_retained == 0)
+	{
+		LOGW("skipped: count_retained=0");
+		return 1;
+	}
+
+	vkk_engine_memoryStats(engine, VKK_MEMORY_TYPE_ANY, &stats);
+	size_t count_chunk_alloc = stats.count_chunk_alloc;
+	count_free = stats.count_free;
+
+	int ret = 1;
+	int n   = XMEM_TEST_COALESCE_COUNT;
+	for(i = 0; i < n; ++i)
+	{
+		buffers[i] = vkk_buffer_new(engine,
+		                            VKK_UPDATE_MODE_STATIC,
+		                            VKK_BUFFER_USAGE_VERTEX,
+		                            XMEM_TEST_COALESCE_SIZE, NULL);
+		if(buffers[i] == NULL)
+		{
+			goto fail_alloc;
+		}
+	}
+
+	vkk_engine_memoryStats(engine, VKK_MEMORY_TYPE_ANY, &stats);
+	if(stats.count_chunk_alloc != count_chunk_alloc)
+	{
+		LOGE("invalid count_chunk_alloc=%" PRIu64
+		     ", expected=%" PRIu64,
+		     (uint64_t) stats.count_chunk_alloc,
+		     (uint64_t) count_chunk_alloc);
+		ret = 0;
+	}
+
+	for(i = 0; i < n; ++i)
+	{
+		vkk_buffer_delete(&buffers[i]);
+		++count_free;
+	}
+
+	if(xmem_test_finishFree(engine, count_free) == 0)
+	{
+		return 0;
+	}
+
+	LOGI("coalesce: ops=%i, count=%i, ret=%i",
+	     XMEM_TEST_COALESCE_OPS, n, ret);
+
+	return ret;
+
+	// failure
+	fail_alloc:
+	{
+		int j;
+		for(j = 0; j < XMEM_TEST_COALESCE_IDS; ++j)
+		{
+			vkk_buffer_delete(&buffers[j]);
+		}
+	}
+	return 0;
+}
+
+static int
+xmem_test_evacuateRange(xmem_test_t* self,
+                        vkk_buffer_t** buffers,
+                        int i0, int i1, int step)
+{
+	ASSERT(self);
+	ASSERT(buffers);
+
+	vkk_engine_t* engine = self->engine;
+
+	vkk_memoryStats_t stats;
+	vkk_engine_memoryStats(engine, VKK_MEMORY_TYPE_ANY, &stats);
+
+	// delete the buffers in the range except every step
+	// buffer (when step is non-zero)
+	size_t count_free = stats.count_free;
+	int    i;
+	for(i = i0; i < i1; ++i)
+	{
+		if(buffers[i] && ((step == 0) || ((i - i0)%step)))
+		{
+			vkk_buffer_delete(&buffers[i]);
+			++count_free;
+		}
+	}
+
+	if(xmem_test_finishFree(engine, count_free) == 0)
+	{
+		return 0;
+	}
+
+	// return the cached slots to the pools
+	vkk_engine_trimMemory(engine);
+
+	return 1;
+}
+
+static int xmem_test_evacuate(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	vkk_engine_t* engine = self->engine;
+
+	// emulate the churn of a long running app which leaves
+	// a sparse chunk behind and check that the chunk is
+	// evacuated and released once its last buffer is deleted
+	vkk_buffer_t** buffers;
+	buffers = (vkk_buffer_t**)
+	          CALLOC(XMEM_TEST_EVACUATE_MAX, sizeof(vkk_buffer_t*));
+	if(buffers == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	// release the retained chunks and cached slots so the
+	// chunk boundaries may be found from the chunk count
+	vkk_engine_trimMemory(engine);
+
+	vkk_memoryInfo_t info0;
+	vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_ANY,
+	                      &info0);
+
+	// allocate until three chunks are created where the
+	// buffers [s[0], s[1]) fill chunk A and [s[1], s[2])
+	// fill chunk B
+	vkk_memoryInfo_t info;
+	int              s[3];
+	int              n = 0;
+	int              i = 0;
+	while(n < 3)
+	{
+		if(i == XMEM_TEST_EVACUATE_MAX)
+		{
+			LOGE("invalid max=%i", XMEM_TEST_EVACUATE_MAX);
+			goto fail_max;
+		}
+
+		buffers[i] = vkk_buffer_new(engine,
+		                            VKK_UPDATE_MODE_STATIC,
+		                            VKK_BUFFER_USAGE_UNIFORM,
+		                            XMEM_TEST_EVACUATE_SIZE,
+		                            NULL);
+		if(buffers[i] == NULL)
+		{
+			goto fail_buffer;
+		}
+
+		vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_ANY,
+		                      &info);
+		if(info.count_chunks > info0.count_chunks + n)
+		{
+			s[n] = i;
+			++n;
+		}
+		++i;
+	}
+	int count = i;
+
+	// free a quarter of chunk B so it may absorb chunk A
+	int b = s[1] + 3*(s[2] - s[1])/4;
+	if(xmem_test_evacuateRange(self, buffers, b, s[2],
+	                           0) == 0)
+	{
+		goto fail_evacuate;
+	}
+
+	// free all but every eighth buffer of chunk A so the
+	// chunk becomes sparse and is evacuated
+	if(xmem_test_evacuateRange(self, buffers, s[0], s[1],
+	                           8) == 0)
+	{
+		goto fail_evacuate;
+	}
+
+	// free the remaining buffers of chunk A which should
+	// release the evacuated chunk
+	if(xmem_test_evacuateRange(self, buffers, s[0], s[1],
+	                           0) == 0)
+	{
+		goto fail_evacuate;
+	}
+
+	vkk_engine_memoryInfo(engine, 0, VKK_MEMORY_TYPE_ANY,
+	                      &info);
+	LOGI("evacuate: count=%i, slots=%i, count_reclaimed=%i",
+	     count, s[1] - s[0],
+	     (int) (info.count_reclaimed - info0.count_reclaimed));
+	if(info.count_reclaimed == info0.count_reclaimed)
+	{
+		LOGE("sparse chunk was not released");
+		goto fail_reclaimed;
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		vkk_buffer_delete(&buffers[i]);
+	}
+	FREE(buffers);
+
+	// success
+	return 1;
+
+	// failure
+	fail_reclaimed:
+	fail_evacuate:
+	fail_buffer:
+	fail_max:
+	{
+		int j;
+		for(j = 0; j < i; ++j)
+		{
+			vkk_buffer_delete(&buffers[j]);
+		}
+		FREE(buffers);
+	}
+	return 0;
+}
+
+static void* xmem_test_threadFn(void* arg)
+{
+	ASSERT(arg);
+
+	xmem_test_thread_t* thread = (xmem_test_thread_t*) arg;
+	vkk_engine_t*       engine = thread->engine;
+
+	// emulate the VG tile and UI widget workers which
+	// create and delete many small buffers
+	vkk_buffer_t* buffers[XMEM_TEST_THREADS_BATCH];
+
+	// time each batch to measure the alloc/free latency
+	// without the overhead of a timestamp per operation
+	double t0;
+	double t1;
+	double dt;
+	int    i;
+	int    j;
+	for(i = 0; i < XMEM_TEST_THREADS_OPS;
+	    i += XMEM_TEST_THREADS_BATCH)
+	{
+		t0 = cc_timestamp();
+		for(j = 0; j < XMEM_TEST_THREADS_BATCH; ++j)
+		{
+			buffers[j] = vkk_buffer_new(engine,
+			                            VKK_UPDATE_MODE_STATIC,
+			                            VKK_BUFFER_USAGE_UNIFORM,
+			                            64 + 64*(j%4), NULL);
+			if(buffers[j] == NULL)
+			{
+				goto fail_buffer;
+			}
+		}
+
+		t1 = cc_timestamp();
+		for(j = 0; j < XMEM_TEST_THREADS_BATCH; ++j)
+		{
+			vkk_buffer_delete(&buffers[j]);
+		}
+
+		dt = t1 - t0;
+		thread->dt_alloc += dt;
+		thread->dt_free  += cc_timestamp() - t1;
+		if(dt > thread->max_alloc)
+		{
+			thread->max_alloc = dt;
+		}
+	}
+
+	thread->ret = 1;
+
+	// success
+	return NULL;
+
+	// failure
+	fail_buffer:
+	{
+		int k;
+		for(k = 0; k < j; ++k)
+		{
+			vkk_buffer_delete(&buffers[k]);
+		}
+	}
+	return NULL;
+}
+
+static int xmem_test_threadsN(xmem_test_t* self, int n)
+{
+	ASSERT(self);
+	ASSERT(n <= XMEM_TEST_THREADS_MAX);
+
+	pthread_t          tid[XMEM_TEST_THREADS_MAX];
+	xmem_test_thread_t thread[XMEM_TEST_THREADS_MAX];
+
+	// the free count is used to wait for the destruct
+	// thread which performs the deferred frees
+	vkk_memoryStats_t stats;
+	vkk_engine_memoryStats(self->engine, VKK_MEMORY_TYPE_ANY,
+	                       &stats);
+	size_t count_free = stats.count_free +
+	                    (size_t) (n*XMEM_TEST_THREADS_OPS);
+
+	double t0 = cc_timestamp();
+
+	int i;
+	for(i = 0; i < n; ++i)
+	{
+		thread[i].engine    = self->engine;
+		thread[i].ret       = 0;
+		thread[i].dt_alloc  = 0.0;
+		thread[i].dt_free   = 0.0;
+		thread[i].max_alloc = 0.0;
+		if(pthread_create(&tid[i], NULL, xmem_test_threadFn,
+		                  (void*) &thread[i]) != 0)
+		{
+			LOGE("pthread_create failed");
+			goto fail_create;
+		}
+	}
+
+	int    ret       = 1;
+	double dt_alloc  = 0.0;
+	double dt_free   = 0.0;
+	double max_alloc = 0.0;
+	for(i = 0; i < n; ++i)
+	{
+		pthread_join(tid[i], NULL);
+		ret      &= thread[i].ret;
+		dt_alloc += thread[i].dt_alloc;
+		dt_free  += thread[i].dt_free;
+		if(thread[i].max_alloc > max_alloc)
+		{
+			max_alloc = thread[i].max_alloc;
+		}
+	}
+
+	// wait for the destruct thread to free the buffers so
+	// the free cost is included in the total
+	double t1 = cc_timestamp();
+	if(xmem_test_finishFree(self->engine, count_free) == 0)
+	{
+		ret = 0;
+	}
+	double t2 = cc_timestamp();
+
+	double dt    = t1 - t0;
+	double count = (double) (n*XMEM_TEST_THREADS_OPS);
+	double batch = (double) XMEM_TEST_THREADS_BATCH;
+	LOGI("threads: n=%i, count=%i, dt=%lf, ns=%lf",
+	     n, (int) count, dt, 1000000000.0*dt/count);
+	LOGI("threads: alloc_ns=%lf, free_ns=%lf, max_alloc_ns=%lf",
+	     1000000000.0*dt_alloc/count,
+	     1000000000.0*dt_free/count,
+	     1000000000.0*max_alloc/batch);
+	LOGI("threads: drain_ns=%lf, total_ns=%lf",
+	     1000000000.0*(t2 - t1)/count,
+	     1000000000.0*(t2 - t0)/count);
+
+	return ret;
+
+	// failure
+	fail_create:
+	{
+		int j;
+		for(j = 0; j < i; ++j)
+		{
+			pthread_join(tid[j], NULL);
+		}
+	}
+	return 0;
+}
+
+static int xmem_test_threads(xmem_test_t* self)
+{
+	ASSERT(self);
+
+	// measure the alloc/free throughput as the number of
+	// threads increases (1, 2, 4, 8)
+	// note that vkk_buffer_delete is deferred to the
+	// destruct thread which performs the actual free so
+	// drain_ns measures the time to complete the frees
+	// after the threads exit
+	int n;
+	for(n = 1; n <= XMEM_TEST_THREADS_MAX; n *= 2)
+	{
+		if(xmem_test_threadsN(self, n) == 0)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+xmem_test_t* xmem_test_new(vkk_engine_t* engine)
+{
+	ASSERT(engine);
+
+	xmem_test_t* self;
+	self = (xmem_test_t*)
+	       CALLOC(1, sizeof(xmem_test_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	self->engine = engine;
+
+	self->renderer = vkk_renderer_newImage(engine,
+	                                       XMEM_TEST_WIDTH,
+	                                       XMEM_TEST_HEIGHT,
+	                                       VKK_IMAGE_FORMAT_RGBA8888,
+	                                       VKK_RENDERER_MSAA_DISABLE);
+	if(self->renderer == NULL)
+	{
+		goto fail_renderer;
+	}
+
+	self->image = vkk_image_new(engine,
+	                            XMEM_TEST_WIDTH,
+	                            XMEM_TEST_HEIGHT, 1,
+	                            VKK_IMAGE_FORMAT_RGBA8888,
+	                            0, VKK_STAGE_FS, NULL);
+	if(self->image == NULL)
+	{
+		goto fail_image;
+	}
+
+	int i;
+	for(i = 0; i < XMEM_TEST_UB_COUNT; ++i)
+	{
+		self->ub[i] = vkk_buffer_new(engine,
+		                             VKK_UPDATE_MODE_SYNCHRONOUS,
+		                             VKK_BUFFER_USAGE_UNIFORM,
+		                             16*sizeof(float), NULL);
+		if(self->ub[i] == NULL)
+		{
+			goto fail_ub;
+		}
+	}
+
+	// success
+	return self;
+
+	// failure
+	fail_ub:
+	{
+		int j;
+		for(j = 0; j < i; ++j)
+		{
+			vkk_buffer_delete(&self->ub[j]);
+		}
+		vkk_image_delete(&self->image);
+	}
+	fail_image:
+		vkk_renderer_delete(&self->renderer);
+	fail_renderer:
+		FREE(self);
+	return NULL;
+}
+
+void xmem_test_delete(xmem_test_t** _self)
+{
+	ASSERT(_self);
+
+	xmem_test_t* self = *_self;
+	if(self)
+	{
+		int i;
+		for(i = 0; i < XMEM_TEST_UB_COUNT; ++i)
+		{
+			vkk_buffer_delete(&self->ub[i]);
+		}
+		vkk_image_delete(&self->image);
+		vkk_renderer_delete(&self->renderer);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+int xmem_test_main(xmem_test_t* self,
+                   int argc, char** argv)
+{
+	ASSERT(self);
+	ASSERT(argv);
+
+	if(xmem_test_updateBuffer(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	// optionally replay a recorded allocation trace
+	const char* fname = NULL;
+	if(argc >= 2)
+	{
+		fname = argv[1];
+	}
+
+	if(xmem_test_trace(self, fname) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_convertF16(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_coalesce(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_shared(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_mixed(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_upload(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_readback(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_heightmap(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_readPixels(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_mipmap(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_compressed(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_evacuate(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(xmem_test_threads(self) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	vkk_memoryInfo_t info;
+	vkk_engine_memoryInfo(self->engine, 1,
+	                      VKK_MEMORY_TYPE_ANY, &info);
+
+	// optionally dump the memory stats for CI
+	if(argc >= 3)
+	{
+		if(vkk_engine_memoryStatsDump(self->engine,
+		                              argv[2]) == 0)
+		{
+			return EXIT_FAILURE;
+		}
+	}
+
+	vkk_memoryStats_t stats;
+	vkk_engine_memoryStats(self->engine, VKK_MEMORY_TYPE_ANY,
+	                       &stats);
+	LOGI("stats: count_alloc=%" PRIu64
+	     ", count_chunk_alloc=%" PRIu64
+	     ", size_peak=%" PRIu64
+	     ", waste=%" PRIu64
+	     ", time_allocate=%lf",
+	     (uint64_t) stats.count_alloc,
+	     (uint64_t) stats.count_chunk_alloc,
+	     (uint64_t) stats.size_peak,
+	     (uint64_t) (stats.size_allocated - stats.size_requested),
+	     stats.time_allocate);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2023 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef xmem_test_H
+#define xmem_test_H
+
+#include "libvkk/vkk.h"
+
+// see xmem_test_updateBuffer
+#define XMEM_TEST_UB_COUNT 256
+
+typedef struct xmem_test_s
+{
+	vkk_engine_t*   engine;
+	vkk_renderer_t* renderer;
+	vkk_image_t*    image;
+	vkk_buffer_t*   ub[XMEM_TEST_UB_COUNT];
+} xmem_test_t;
+
+xmem_test_t* xmem_test_new(vkk_engine_t* engine);
+void         xmem_test_delete(xmem_test_t** _self);
+int          xmem_test_main(xmem_test_t* self,
+                            int argc, char** argv);
+
+#endif
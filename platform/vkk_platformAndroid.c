@@ -337,6 +337,11 @@ onAppCmd(struct android_app* app, int32_t cmd)
 	{
 		LOGD("APP_CMD_LOW_MEMORY");
 
+		if(platform->engine)
+		{
+			vkk_engine_trimMemory(platform->engine);
+		}
+
 		if(platform->priv)
 		{
 			vkk_platformEvent_t ve =
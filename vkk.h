@@ -40,6 +40,24 @@ typedef enum
 
 #define VKK_MEMORY_TYPE_COUNT 3
 
+// memory priority hints (VK_EXT_memory_priority)
+// high priority memory (e.g. render targets and atlases) is
+// the last to be demoted from device local memory under
+// memory pressure while low priority memory (e.g. cache-like
+// data) is the first
+typedef enum
+{
+	VKK_MEMORY_PRIORITY_LOW     = 0,
+	VKK_MEMORY_PRIORITY_DEFAULT = 1,
+	VKK_MEMORY_PRIORITY_HIGH    = 2,
+} vkk_memoryPriority_e;
+
+#define VKK_MEMORY_PRIORITY_COUNT 3
+
+// memory stats histograms count allocations by the log2 of
+// their size
+#define VKK_MEMORY_HISTOGRAM_COUNT 32
+
 typedef enum
 {
 	VKK_BLEND_MODE_DISABLED     = 0,
@@ -74,9 +92,16 @@ typedef enum
 	VKK_IMAGE_FORMAT_R8       = 11,
 	VKK_IMAGE_FORMAT_RF32     = 12,
 	VKK_IMAGE_FORMAT_RF16     = 13,
+	VKK_IMAGE_FORMAT_BC1RGBA  = 14,
+	VKK_IMAGE_FORMAT_BC3RGBA  = 15,
+	VKK_IMAGE_FORMAT_BC7RGBA  = 16,
+	VKK_IMAGE_FORMAT_ETC2RGB  = 17,
+	VKK_IMAGE_FORMAT_ETC2RGBA = 18,
+	VKK_IMAGE_FORMAT_ASTC4X4  = 19,
+	VKK_IMAGE_FORMAT_ASTC8X8  = 20,
 } vkk_imageFormat_e;
 
-#define VKK_IMAGE_FORMAT_COUNT 14
+#define VKK_IMAGE_FORMAT_COUNT 21
 
 typedef enum
 {
@@ -193,6 +218,7 @@ typedef struct vkk_engine_s            vkk_engine_t;
 typedef struct vkk_graphicsPipeline_s  vkk_graphicsPipeline_t;
 typedef struct vkk_image_s             vkk_image_t;
 typedef struct vkk_pipelineLayout_s    vkk_pipelineLayout_t;
+typedef struct vkk_readback_s          vkk_readback_t;
 typedef struct vkk_renderer_s          vkk_renderer_t;
 typedef struct vkk_uniformSet_s        vkk_uniformSet_t;
 typedef struct vkk_uniformSetFactory_s vkk_uniformSetFactory_t;
@@ -201,6 +227,9 @@ typedef enum   vkk_platformCmd_s       vkk_platformCmd_e;
 typedef void (*vkk_platformCmd_documentFn)
              (void* priv, const char* uri, int* _fd);
 
+typedef int (*vkk_engine_evictFn)
+            (void* priv, vkk_memoryType_e type, size_t size);
+
 /*
  * parameter structures
  */
@@ -216,10 +245,41 @@ typedef struct
 {
 	size_t count_chunks;
 	size_t count_slots;
+	size_t count_dedicated;
+	size_t count_retained;
+	size_t count_reclaimed;
+	size_t count_shared;
+	size_t count_xfer;
 	size_t size_chunks;
 	size_t size_slots;
+	size_t size_dedicated;
+	size_t size_retained;
+	size_t size_reclaimed;
+	size_t size_xfer;
 } vkk_memoryInfo_t;
 
+typedef struct
+{
+	size_t budget;
+	size_t usage;
+	size_t soft_cap;
+} vkk_memoryBudget_t;
+
+typedef struct
+{
+	size_t count_alloc;
+	size_t count_free;
+	size_t count_chunk_alloc;
+	size_t count_chunk_free;
+	size_t size_requested;
+	size_t size_allocated;
+	size_t size_peak;
+	double time_allocate;
+	double time_allocate_max;
+	size_t histogram_requested[VKK_MEMORY_HISTOGRAM_COUNT];
+	size_t histogram_allocated[VKK_MEMORY_HISTOGRAM_COUNT];
+} vkk_memoryStats_t;
+
 typedef struct
 {
 	unsigned int texture:1;
@@ -304,6 +364,41 @@ void            vkk_engine_memoryInfo(vkk_engine_t* self,
                                       int verbose,
                                       vkk_memoryType_e type,
                                       vkk_memoryInfo_t* info);
+void            vkk_engine_trimMemory(vkk_engine_t* self);
+void            vkk_engine_memoryBudget(vkk_engine_t* self,
+                                        vkk_memoryType_e type,
+                                        vkk_memoryBudget_t* budget);
+void            vkk_engine_memorySoftCap(vkk_engine_t* self,
+                                         vkk_memoryType_e type,
+                                         size_t soft_cap);
+void            vkk_engine_memoryXferCap(vkk_engine_t* self,
+                                         size_t cap);
+void            vkk_engine_memoryEvictFn(vkk_engine_t* self,
+                                         void* priv,
+                                         vkk_engine_evictFn evict_fn);
+void            vkk_engine_memoryStats(vkk_engine_t* self,
+                                       vkk_memoryType_e type,
+                                       vkk_memoryStats_t* stats);
+int             vkk_engine_memoryStatsDump(vkk_engine_t* self,
+                                           const char* fname);
+int             vkk_engine_pollTicket(vkk_engine_t* self,
+                                      uint64_t ticket);
+void            vkk_engine_waitTicket(vkk_engine_t* self,
+                                      uint64_t ticket);
+int             vkk_engine_pollReadback(vkk_engine_t* self,
+                                        vkk_readback_t* readback);
+const void*     vkk_engine_mapReadback(vkk_engine_t* self,
+                                       vkk_readback_t* readback);
+void            vkk_engine_deleteReadback(vkk_engine_t* self,
+                                          vkk_readback_t** _readback);
+void            vkk_engine_beginUploads(vkk_engine_t* self);
+uint64_t        vkk_engine_endUploads(vkk_engine_t* self);
+void            vkk_engine_mipmapCompute(vkk_engine_t* self,
+                                         int enable);
+void            vkk_engine_mipmapTimer(vkk_engine_t* self,
+                                       int enable);
+double          vkk_engine_mipmapElapsed(vkk_engine_t* self,
+                                         uint32_t* _count);
 void            vkk_engine_imageCaps(vkk_engine_t* self,
                                      vkk_imageFormat_e format,
                                      vkk_imageCaps_t* caps);
@@ -351,6 +446,12 @@ vkk_buffer_t*    vkk_buffer_new(vkk_engine_t* engine,
                                 vkk_bufferUsage_e usage,
                                 size_t size,
                                 const void* buf);
+vkk_buffer_t*    vkk_buffer_newPriority(vkk_engine_t* engine,
+                                        vkk_updateMode_e update,
+                                        vkk_bufferUsage_e usage,
+                                        vkk_memoryPriority_e priority,
+                                        size_t size,
+                                        const void* buf);
 void             vkk_buffer_delete(vkk_buffer_t** _self);
 vkk_memoryType_e vkk_buffer_memoryType(vkk_buffer_t* self);
 size_t           vkk_buffer_size(vkk_buffer_t* self);
@@ -371,6 +472,16 @@ int              vkk_buffer_writeStorage(vkk_buffer_t* self,
                                          size_t offset,
                                          size_t size,
                                          const void* data);
+int              vkk_buffer_fillStorageAsync(vkk_buffer_t* self,
+                                             size_t offset,
+                                             size_t size,
+                                             uint32_t data,
+                                             uint64_t* _ticket);
+int              vkk_buffer_writeStorageAsync(vkk_buffer_t* self,
+                                              size_t offset,
+                                              size_t size,
+                                              const void* data,
+                                              uint64_t* _ticket);
 
 /*
  * image API
@@ -384,6 +495,15 @@ vkk_image_t*      vkk_image_new(vkk_engine_t* engine,
                                 int mipmap,
                                 vkk_stage_e stage,
                                 const void* pixels);
+vkk_image_t*      vkk_image_newPriority(vkk_engine_t* engine,
+                                        uint32_t width,
+                                        uint32_t height,
+                                        uint32_t depth,
+                                        vkk_imageFormat_e format,
+                                        int mipmap,
+                                        vkk_stage_e stage,
+                                        vkk_memoryPriority_e priority,
+                                        const void* pixels);
 void              vkk_image_delete(vkk_image_t** _self);
 vkk_imageFormat_e vkk_image_format(vkk_image_t* self);
 vkk_memoryType_e  vkk_image_memoryType(vkk_image_t* self);
@@ -393,6 +513,17 @@ size_t            vkk_image_size(vkk_image_t* self,
                                  uint32_t* _depth);
 int               vkk_image_readPixels(vkk_image_t* self,
                                        void* pixels);
+vkk_readback_t*   vkk_image_readPixelsAsync(vkk_image_t* self);
+int               vkk_image_writePixelsAsync(vkk_image_t* self,
+                                             const void* pixels,
+                                             uint64_t* _ticket);
+int               vkk_image_writeRegion(vkk_image_t* self,
+                                        uint32_t x,
+                                        uint32_t y,
+                                        uint32_t w,
+                                        uint32_t h,
+                                        uint32_t level,
+                                        const void* pixels);
 
 
 /*